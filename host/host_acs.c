@@ -0,0 +1,87 @@
+/**
+ * @file host_acs.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief ACS runtime stub for the native host build.
+ * @version added in 0.1
+ * @date 2021-03-14
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * Implements m_acs.h without a ZDoom VM underneath. Time only advances
+ * when the host driver says so, by calling acs_delay.
+ */
+
+#include <stdio.h>
+
+#include "m_acs.h"
+
+
+/**
+ * @brief The simulated level time, in tics.
+ */
+static int host_tic = 0;
+
+const char *host_store_path = "infindus.snap";
+
+/**
+ * @brief The open store file, if the store was used yet.
+ */
+static FILE *host_store = NULL;
+
+
+int acs_timer(void) {
+    return host_tic;
+}
+
+void acs_delay(int tics) {
+    host_tic += tics;
+}
+
+int acs_spawn(const char *type, float x, float y) {
+    // there is no world to spawn anything in
+    return 1;
+}
+
+void acs_log(const char *text) {
+    puts(text);
+}
+
+static FILE *_host_store_open(void) {
+    if (host_store == NULL) {
+        host_store = fopen(host_store_path, "a+b");
+    }
+
+    return host_store;
+}
+
+void acs_store_clear(void) {
+    if (host_store != NULL) {
+        fclose(host_store);
+    }
+
+    host_store = fopen(host_store_path, "w+b");
+}
+
+size_t acs_store_length(void) {
+    if (_host_store_open() == NULL || fseek(host_store, 0, SEEK_END) != 0) {
+        return 0;
+    }
+
+    return ftell(host_store) / sizeof(unsigned int);
+}
+
+int acs_store_append(const unsigned int *words, size_t num_words) {
+    if (_host_store_open() == NULL || fseek(host_store, 0, SEEK_END) != 0) {
+        return 0;
+    }
+
+    return fwrite(words, sizeof(unsigned int), num_words, host_store) == num_words;
+}
+
+size_t acs_store_read(size_t offset, unsigned int *words, size_t num_words) {
+    if (_host_store_open() == NULL || fseek(host_store, offset * sizeof(unsigned int), SEEK_SET) != 0) {
+        return 0;
+    }
+
+    return fread(words, sizeof(unsigned int), num_words, host_store);
+}
@@ -0,0 +1,826 @@
+/**
+ * @file host_bench.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Tick-throughput benchmark for the native host build.
+ * @version added in 0.1
+ * @date 2021-03-14
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * Builds scripted worlds of industries, stations and companies, then
+ * drives them through many economy periods, reporting how fast the
+ * simulation code runs natively. This serves as a regression baseline;
+ * what actually matters in-game is the ACS VM's per-tic instruction
+ * budget, but relative changes show up here just as well.
+ *
+ * Each scenario runs in its own child process, since all world state
+ * lives in static arrays that cannot be reset.
+ *
+ * Autosaves are off, unless a scenario asks for snapshots, which are
+ * then written into a temporary file, and timed on their own.
+ *
+ * A run may also dump its event log at the end (see m_replay.h), for
+ * host_replay.c to replay; autosaves are then on, as in a game, and
+ * the events after the last one are replayed. The bench leaves the
+ * world alone while an autosave is being written, as a game should. The host build's log is
+ * large enough to hold several periods' worth of events.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "m_acs.h"
+#include "m_replay.h"
+#include "m_workers.h"
+#include "h_economy.h"
+#include "h_cargo.h"
+#include "h_industry.h"
+#include "h_station.h"
+#include "h_company.h"
+#include "h_vehicle.h"
+#include "h_route.h"
+#include "i_mapgen.h"
+#include "i_place.h"
+
+
+/**
+ * @brief A scripted benchmark world.
+ */
+struct bench_scenario_t {
+    const char *name;
+    int num_industries;
+    int num_stations;
+    int num_companies;
+    int num_vehicles;
+
+    /**
+     * @brief Number of economy periods to simulate.
+     */
+    int periods;
+
+    /**
+     * @brief Number of cargo deliveries into industries, per tic.
+     */
+    int deliveries;
+
+    /**
+     * @brief How industries distribute their cargo among stations.
+     */
+    enum industry_distribution_t distribution;
+
+    /**
+     * @brief Number of map places to lay out.
+     *
+     * If not 0, industries are placed on them by the map generator,
+     * instead of on a grid; num_industries is then only the most that
+     * may be placed.
+     */
+    int places;
+
+    /**
+     * @brief Whether to snapshot the world at the end of every period.
+     *
+     * Deltas, with a full snapshot every ECONOMY_AUTOSAVE_DELTAS
+     * deltas, as autosaves would be.
+     */
+    int snapshots;
+
+    /**
+     * @brief Number of threads to run end-of-period passes on; 0 for just one.
+     */
+    int threads;
+
+    /**
+     * @brief Number of industries updated per tic in a pass; 0 for ECONOMY_SLICE_INDUSTRIES.
+     */
+    int slice;
+
+    /**
+     * @brief Whether to dump the event log at the end, to stdout.
+     */
+    int replay;
+
+    /**
+     * @brief Whether to check the spatial queries against a linear scan, once the world is built.
+     */
+    int check_queries;
+};
+
+/**
+ * @brief Accumulated wall time spent in a function, over many calls.
+ */
+struct bench_timer_t {
+    const char *label;
+    double ns;
+    long calls;
+};
+
+/**
+ * @brief Clamps a scenario size to what the capacity profile can hold.
+ *
+ * The scenarios are written for the default profile; a smaller one
+ * runs them scaled down, instead of failing to build their worlds.
+ */
+#define BENCH_CLAMP(n, max) ((n) < (max) ? (n) : (max))
+
+static const struct bench_scenario_t bench_scenarios[] = {
+    { "small",    BENCH_CLAMP(16, MAX_INDUSTRIES), BENCH_CLAMP(16, MAX_STATIONS), BENCH_CLAMP(2, MAX_COMPANIES), BENCH_CLAMP(16, MAX_VEHICLES),    100, 4,  INDUSTRY_DISTRIBUTE_EVEN   },
+    { "medium",   BENCH_CLAMP(64, MAX_INDUSTRIES), BENCH_CLAMP(64, MAX_STATIONS), BENCH_CLAMP(8, MAX_COMPANIES), BENCH_CLAMP(64, MAX_VEHICLES),    100, 16, INDUSTRY_DISTRIBUTE_EVEN   },
+    { "large",    MAX_INDUSTRIES,                  MAX_STATIONS,                  MAX_COMPANIES,                 BENCH_CLAMP(512, MAX_VEHICLES),   100, 64, INDUSTRY_DISTRIBUTE_EVEN   },
+    { "fleet",    MAX_INDUSTRIES,                  MAX_STATIONS,                  MAX_COMPANIES,                 BENCH_CLAMP(20000, MAX_VEHICLES), 20,  64, INDUSTRY_DISTRIBUTE_DEMAND },
+    { "mapgen",   MAX_INDUSTRIES,                  BENCH_CLAMP(64, MAX_STATIONS), BENCH_CLAMP(8, MAX_COMPANIES), BENCH_CLAMP(64, MAX_VEHICLES),    100, 16, INDUSTRY_DISTRIBUTE_EVEN,
+      // places share the spotmap with the industries and stations
+      BENCH_CLAMP(512, MAX_SPOTS - MAX_INDUSTRIES - MAX_STATIONS) },
+    { "snapshot", MAX_INDUSTRIES,                  MAX_STATIONS,                  MAX_COMPANIES,                 BENCH_CLAMP(512, MAX_VEHICLES),   100, 64, INDUSTRY_DISTRIBUTE_EVEN,   0,   1 },
+    { "threaded", MAX_INDUSTRIES,                  MAX_STATIONS,                  MAX_COMPANIES,                 BENCH_CLAMP(512, MAX_VEHICLES),   100, 64, INDUSTRY_DISTRIBUTE_DEMAND, 0,   0, 4, MAX_INDUSTRIES },
+    { "queries",  MAX_INDUSTRIES,                  MAX_STATIONS,                  0,                             0,                                1,   16, INDUSTRY_DISTRIBUTE_EVEN,
+      BENCH_CLAMP(512, MAX_SPOTS - MAX_INDUSTRIES - MAX_STATIONS), 0, 0, 0, 0, 1 }
+};
+
+#define NUM_BENCH_SCENARIOS (sizeof(bench_scenarios) / sizeof(*bench_scenarios))
+
+/**
+ * @brief The number of cargo types, and of hub stations, that cargo is routed to.
+ *
+ * Scenarios with fewer stations than hubs just route to fewer of them.
+ */
+#define BENCH_ROUTE_CARGO_TYPES 8
+#define BENCH_ROUTE_HUBS 4
+
+/**
+ * @brief The width of the world, in spotmap tiles; industries and stations are laid out a row of it at a time.
+ */
+#define BENCH_GRID_WIDTH 16
+
+/**
+ * @brief The number of random positions each round of the query check tries.
+ */
+#define BENCH_CHECK_QUERIES 10000
+
+/**
+ * @brief The most handles a spatial query can report; spots outnumber industries.
+ */
+#define BENCH_CHECK_MAX (MAX_SPOTS > MAX_INDUSTRIES ? MAX_SPOTS : MAX_INDUSTRIES)
+
+static unsigned int bench_seed = 0x1DF3A0u;
+
+/**
+ * @brief The industry type of each industry created in the world.
+ */
+static size_t bench_industry_types[MAX_INDUSTRIES];
+
+/**
+ * @brief How many slices map generation took, and the wall time spent in them.
+ */
+static struct {
+    int slices;
+    double ns;
+} bench_mapgen;
+
+/**
+ * @brief The words written by full and delta snapshots, and the wall time spent in them.
+ */
+static struct {
+    int fulls, deltas;
+    long full_words, delta_words;
+    double full_ns, delta_ns;
+} bench_snapshots;
+
+/**
+ * @brief How many spatial queries were checked against a linear scan.
+ */
+static long bench_queries_checked;
+
+
+static unsigned int bench_random(void) {
+    // xorshift32
+    bench_seed ^= bench_seed << 13;
+    bench_seed ^= bench_seed >> 17;
+    bench_seed ^= bench_seed << 5;
+
+    return bench_seed;
+}
+
+static float bench_random_float(float max) {
+    return (bench_random() & 0xFFFF) * max / 65536.0f;
+}
+
+static double bench_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static size_t bench_num_industry_types(void) {
+    size_t i;
+
+    for (i = 0; i < MAX_INDUS_TYPES; i++) {
+        if (industry_types[i].supply_type == ISUPTYPE_UNKNOWN) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/**
+ * @brief Places a scenario's industries with the map generator.
+ *
+ * Places are scattered over a square as wide as the industry grid
+ * would be, and generation runs slice by slice until it is done.
+ */
+static int bench_generate_map(const struct bench_scenario_t *scenario, int grid_width) {
+    const float width = grid_width * SPOT_TILE_WIDTH;
+
+    double lap;
+    int i;
+
+    for (i = 0; i < scenario->places; i++) {
+        if (make_spot(bench_random_float(width), bench_random_float(width)) == (spot_handle_t) -1) {
+            return -1;
+        }
+    }
+
+    mapgen_begin(bench_seed, scenario->num_industries);
+
+    do {
+        lap = bench_now_ns();
+        mapgen_step();
+        bench_mapgen.ns += bench_now_ns() - lap;
+        bench_mapgen.slices++;
+    } while (mapgen_is_running());
+
+    for (i = 0; i < num_industries; i++) {
+        bench_industry_types[i] = industry_get_type(i);
+    }
+
+    return num_industries > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Populates the world with a scenario's industries, stations, companies and vehicles.
+ *
+ * Industries are laid out on a grid with one industry per spotmap tile,
+ * unless the scenario has them placed by the map generator, with
+ * stations scattered around them that load every cargo type.
+ * Vehicles shuttle a random cargo type back and forth between two
+ * random stations, loading and unloading at both.
+ */
+static int bench_build_world(const struct bench_scenario_t *scenario) {
+    const size_t num_types = bench_num_industry_types();
+    const int grid_width = BENCH_GRID_WIDTH;
+
+    int i;
+    size_t cargo_type;
+    station_handle_t station;
+    vehicle_handle_t vehicle;
+    char name[32];
+
+    industry_distribution = scenario->distribution;
+
+    if (scenario->places > 0 && bench_generate_map(scenario, grid_width) < 0) {
+        return -1;
+    }
+
+    for (i = 0; i < scenario->num_industries && scenario->places == 0; i++) {
+        const float x = (i % grid_width) * SPOT_TILE_WIDTH + bench_random_float(SPOT_TILE_WIDTH);
+        const float y = (i / grid_width) * SPOT_TILE_WIDTH + bench_random_float(SPOT_TILE_WIDTH);
+
+        bench_industry_types[i] = i % num_types;
+
+        if (industry_create(bench_industry_types[i], x, y) == (industry_handle_t) -1) {
+            return -1;
+        }
+    }
+
+    for (i = 0; i < scenario->num_stations; i++) {
+        const float x = (i % grid_width) * SPOT_TILE_WIDTH + bench_random_float(SPOT_TILE_WIDTH);
+        const float y = (i / grid_width) * SPOT_TILE_WIDTH + bench_random_float(SPOT_TILE_WIDTH);
+
+        station = station_build(STATION_NO_OWNER, x, y);
+
+        if (station == (station_handle_t) -1) {
+            return -1;
+        }
+
+        // load everything, so every industry in reach distributes here
+        for (cargo_type = 0; cargo_type < num_cargo_types; cargo_type++) {
+            station_set_loading(station, cargo_type, 1);
+        }
+    }
+
+    for (i = 0; i < scenario->num_companies; i++) {
+        snprintf(name, sizeof(name), "Bench Company %d", i);
+        company_found_company(name, ECON_C(1000.0));
+    }
+
+    // vehicles need a company to own them
+    for (i = 0; i < scenario->num_vehicles && scenario->num_stations > 0 && scenario->num_companies > 0; i++) {
+        const station_handle_t from = bench_random() % scenario->num_stations;
+        const station_handle_t to = bench_random() % scenario->num_stations;
+        float x, y;
+
+        station_get_position(from, &x, &y);
+        vehicle = vehicle_build(i % scenario->num_companies, x, y, 4.0f + bench_random_float(12.0f));
+
+        if (vehicle == (vehicle_handle_t) -1
+         || vehicle_add_compartment(vehicle, bench_random() % num_cargo_types, ECON_C(40.0)) < 0
+         || vehicle_add_order(vehicle, from, ORDER_LOAD | ORDER_UNLOAD) < 0
+         || vehicle_add_order(vehicle, to, ORDER_LOAD | ORDER_UNLOAD) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Checks what a spatial query found against what a linear scan did.
+ *
+ * The query must find every handle the scan did, or, if they do not
+ * all fit in max, max of them; never any other, nor any twice.
+ */
+static int bench_check_found(const size_t *expected, size_t num_expected, const size_t *found, size_t num_found, size_t max) {
+    static unsigned int marks[BENCH_CHECK_MAX];
+    static unsigned int stamp = 0;
+
+    size_t i;
+
+    stamp++;
+
+    for (i = 0; i < num_expected; i++) {
+        marks[expected[i]] = stamp;
+    }
+
+    for (i = 0; i < num_found; i++) {
+        if (found[i] >= BENCH_CHECK_MAX || marks[found[i]] != stamp) {
+            return -1;
+        }
+
+        // found once; a second time is a duplicate
+        marks[found[i]] = 0;
+    }
+
+    return num_found == (num_expected < max ? num_expected : max) ? 0 : -1;
+}
+
+/**
+ * @brief Checks spot_query_radius and industry_query_reach against a linear scan over all spots, at random positions.
+ *
+ * Query limits are random too, and often small, so that results cut
+ * off at max are checked as well as whole ones.
+ */
+static int bench_check_queries(void) {
+    static size_t expected[BENCH_CHECK_MAX], found[BENCH_CHECK_MAX];
+
+    const float width = BENCH_GRID_WIDTH * SPOT_TILE_WIDTH;
+
+    size_t num_expected, num_found, max;
+    spot_handle_t ind_spot;
+    int i;
+
+    for (i = 0; i < BENCH_CHECK_QUERIES; i++) {
+        // a tile's width past the edges too, where there are no tiles
+        const float x = bench_random_float(width + 2 * SPOT_TILE_WIDTH) - SPOT_TILE_WIDTH;
+        const float y = bench_random_float(width + 2 * SPOT_TILE_WIDTH) - SPOT_TILE_WIDTH;
+        const float radius = bench_random_float(3 * SPOT_TILE_WIDTH);
+        const unsigned int kinds = bench_random() & SPOT_KIND_MASK_ALL;
+
+        max = bench_random() % 2 ? BENCH_CHECK_MAX : 1 + bench_random() % 16;
+        num_expected = 0;
+
+        for (ind_spot = 0; ind_spot < place_num_spots; ind_spot++) {
+            const struct spot_t *const spot = spot_get(ind_spot);
+
+            // map places are never linked into the spotmap, so no query finds them
+            if (spot == NULL || spot->kind == SPOT_KIND_PLACE || !(kinds & SPOT_KIND_MASK(spot->kind))) {
+                continue;
+            }
+
+            // the bounding box too, as the query does, so that rounding at its edges agrees
+            if (spot->x < x - radius || spot->x > x + radius || spot->y < y - radius || spot->y > y + radius) {
+                continue;
+            }
+
+            if ((spot->x - x) * (spot->x - x) + (spot->y - y) * (spot->y - y) <= radius * radius) {
+                expected[num_expected++] = ind_spot;
+            }
+        }
+
+        num_found = spot_query_radius(x, y, radius, kinds, found, max);
+
+        if (bench_check_found(expected, num_expected, found, num_found, max) < 0) {
+            fprintf(stderr, "spot_query_radius(%g, %g, %g, %#x, max %zu) found %zu spots, a linear scan %zu\n", x, y, radius, kinds, max, num_found, num_expected);
+            return -1;
+        }
+
+        max = bench_random() % 2 ? MAX_INDUSTRIES : 1 + bench_random() % 4;
+        num_expected = 0;
+
+        for (ind_spot = 0; ind_spot < place_num_spots; ind_spot++) {
+            const struct spot_t *const spot = spot_get(ind_spot);
+
+            if (spot == NULL || spot->kind != SPOT_KIND_INDUSTRY) {
+                continue;
+            }
+
+            const float reach = industry_types[industry_get_type(spot->owner)].reach;
+            const float dx = x - spot->x;
+            const float dy = y - spot->y;
+
+            if (dx * dx + dy * dy <= reach * reach) {
+                expected[num_expected++] = spot->owner;
+            }
+        }
+
+        num_found = industry_query_reach(x, y, found, max);
+
+        if (bench_check_found(expected, num_expected, found, num_found, max) < 0) {
+            fprintf(stderr, "industry_query_reach(%g, %g, max %zu) found %zu industries, a linear scan %zu\n", x, y, max, num_found, num_expected);
+            return -1;
+        }
+
+        bench_queries_checked += 2;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Rebuilds every other station somewhere else, so that spots are freed and reused.
+ */
+static int bench_move_stations(const struct bench_scenario_t *scenario) {
+    const float width = BENCH_GRID_WIDTH * SPOT_TILE_WIDTH;
+
+    int i;
+
+    for (i = 0; i < scenario->num_stations; i += 2) {
+        if (station_remove(i) < 0 || station_build(STATION_NO_OWNER, bench_random_float(width), bench_random_float(width)) == (station_handle_t) -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Snapshots the world, as an autosave would.
+ */
+static int bench_snapshot(void) {
+    const enum snapshot_kind_t kind = snapshot_sequence() > ECONOMY_AUTOSAVE_DELTAS ? SNAPSHOT_FULL : SNAPSHOT_DELTA;
+    const double lap = bench_now_ns();
+    const int written = economy_save(kind);
+
+    if (written < 0) {
+        return -1;
+    }
+
+    // a delta is written as a full snapshot if there is nothing to base it on
+    if (snapshot_sequence() == 1) {
+        bench_snapshots.fulls++;
+        bench_snapshots.full_words += written;
+        bench_snapshots.full_ns += bench_now_ns() - lap;
+    }
+
+    else {
+        bench_snapshots.deltas++;
+        bench_snapshots.delta_words += written;
+        bench_snapshots.delta_ns += bench_now_ns() - lap;
+    }
+
+    return 0;
+}
+
+static void bench_report_timer(const struct bench_timer_t *timer) {
+    printf("  ns/call   %-26s %10.1f  (%ld calls)\n", timer->label, timer->calls ? timer->ns / timer->calls : 0.0, timer->calls);
+}
+
+static void bench_report_per(const char *label, double ns, long count) {
+    printf("  ns/each   %-26s %10.1f  (%ld)\n", label, count ? ns / count : 0.0, count);
+}
+
+static int bench_run(const struct bench_scenario_t *scenario) {
+    struct bench_timer_t t_economy = { "economy_tick" };
+    struct bench_timer_t t_pass = { "economy_tick (in a pass)" };
+    struct bench_timer_t t_save = { "economy_tick (in a save)" };
+    struct bench_timer_t t_accept = { "industry_accept_cargo" };
+    struct bench_timer_t t_add = { "station_add_cargo" };
+    struct bench_timer_t t_balance = { "company_add_to_balance" };
+    struct bench_timer_t t_route = { "route_next_hop" };
+
+    struct rusage usage;
+    double start, end, lap, restore_ns = 0;
+    int i, periods_before, restored = 0;
+    long routes_found = 0;
+    station_handle_t next;
+    char store_path[64];
+
+    economy_autosave_periods = scenario->replay ? ECONOMY_AUTOSAVE_PERIODS : 0;
+
+    if (scenario->slice > 0) {
+        economy_slice_industries = scenario->slice;
+    }
+
+    if (scenario->threads > 1 && workers_start(scenario->threads) < 0) {
+        fprintf(stderr, "%s: could not start %d threads\n", scenario->name, scenario->threads);
+        return 1;
+    }
+
+    if (scenario->snapshots || scenario->replay) {
+        snprintf(store_path, sizeof(store_path), "%s/infindus-bench-%d.snap", P_tmpdir, (int) getpid());
+        host_store_path = store_path;
+    }
+
+    if (bench_build_world(scenario) < 0) {
+        fprintf(stderr, "%s: could not build world\n", scenario->name);
+        return 1;
+    }
+
+    // once as built, and again once spots were freed and reused
+    if (scenario->check_queries && (bench_check_queries() < 0 || bench_move_stations(scenario) < 0 || bench_check_queries() < 0)) {
+        fprintf(stderr, "%s: spatial queries disagree with a linear scan\n", scenario->name);
+        return 1;
+    }
+
+    start = bench_now_ns();
+
+    // an autosave begun by the last period is seen through
+    while (economy_periods < scenario->periods || economy_snapshot_running()) {
+        // the world is left alone while it is being saved, as scripts in a game should
+        if (economy_snapshot_running()) {
+            lap = bench_now_ns();
+            economy_tick();
+            lap = bench_now_ns() - lap;
+
+            t_economy.ns += lap;
+            t_economy.calls++;
+            t_save.ns += lap;
+            t_save.calls++;
+
+            acs_delay(1);
+            continue;
+        }
+
+        // deliveries into industries
+        lap = bench_now_ns();
+
+        for (i = 0; i < scenario->deliveries; i++) {
+            const industry_handle_t indus = bench_random() % num_industries;
+            const size_t num_accepts = industry_types[bench_industry_types[indus]].num_accepts;
+
+            industry_accept_cargo(indus, bench_random() % num_accepts, econ_from_float(1.0f + bench_random_float(8.0f)));
+        }
+
+        t_accept.ns += bench_now_ns() - lap;
+        t_accept.calls += scenario->deliveries;
+
+        // cargo piling up in stations
+        if (scenario->num_stations > 0) {
+            lap = bench_now_ns();
+
+            for (i = 0; i < scenario->deliveries; i++) {
+                station_add_cargo(bench_random() % scenario->num_stations, bench_random() % num_cargo_types, -1, ECON_C(4.0));
+            }
+
+            t_add.ns += bench_now_ns() - lap;
+            t_add.calls += scenario->deliveries;
+        }
+
+        // routing cargo through the link graph, to a few hubs, so that
+        // the route trees asked for all fit at once
+        if (scenario->num_stations > 0) {
+            lap = bench_now_ns();
+
+            for (i = 0; i < scenario->deliveries; i++) {
+                if (route_next_hop(bench_random() % BENCH_ROUTE_CARGO_TYPES, bench_random() % scenario->num_stations, bench_random() % (scenario->num_stations < BENCH_ROUTE_HUBS ? scenario->num_stations : BENCH_ROUTE_HUBS), &next) == 0 && next != (station_handle_t) -1) {
+                    routes_found++;
+                }
+            }
+
+            t_route.ns += bench_now_ns() - lap;
+            t_route.calls += scenario->deliveries;
+        }
+
+        // running costs and income
+        if (scenario->num_companies > 0) {
+            lap = bench_now_ns();
+
+            for (i = 0; i < scenario->num_companies; i++) {
+                company_add_to_balance(i, econ_from_float(bench_random_float(20.0f) - 10.0f));
+            }
+
+            t_balance.ns += bench_now_ns() - lap;
+            t_balance.calls += scenario->num_companies;
+        }
+
+        // the economy itself, including end-of-period passes
+        periods_before = economy_periods;
+        lap = bench_now_ns();
+        economy_tick();
+        lap = bench_now_ns() - lap;
+
+        t_economy.ns += lap;
+        t_economy.calls++;
+
+        if (economy_pass_running() || economy_periods != periods_before) {
+            t_pass.ns += lap;
+            t_pass.calls++;
+        }
+
+        if (scenario->snapshots && economy_periods != periods_before && bench_snapshot() < 0) {
+            fprintf(stderr, "%s: could not snapshot world\n", scenario->name);
+            return 1;
+        }
+
+        acs_delay(1);
+    }
+
+    end = bench_now_ns();
+
+    if (scenario->replay) {
+        replay_print();
+    }
+
+    if (scenario->snapshots) {
+        restore_ns = bench_now_ns();
+        restored = economy_restore();
+        restore_ns = bench_now_ns() - restore_ns;
+
+        if (restored < 0) {
+            fprintf(stderr, "%s: could not restore world\n", scenario->name);
+            remove(store_path);
+            return 1;
+        }
+    }
+
+    if (scenario->snapshots || scenario->replay) {
+        remove(store_path);
+    }
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("scenario %s\n", scenario->name);
+    printf("  world     %d industries, %d stations, %d companies, %d vehicles\n", num_industries, scenario->num_stations, scenario->num_companies, scenario->num_vehicles);
+
+    if (scenario->places > 0) {
+        printf("  mapgen    %zu industries on %d places, in %d slices\n", mapgen_num_placed(), scenario->places, bench_mapgen.slices);
+        bench_report_per("mapgen_step", bench_mapgen.ns, bench_mapgen.slices);
+    }
+
+    if (scenario->check_queries) {
+        printf("  queries   %ld checked against a linear scan, all agree\n", bench_queries_checked);
+    }
+
+    printf("  cargo     distributed %s\n", scenario->distribution == INDUSTRY_DISTRIBUTE_DEMAND ? "by pickup rate" : "evenly");
+#ifdef ECONOMY_fixed
+    printf("  amounts   fixed-point, %d fractional bits\n", ECON_FRAC_BITS);
+#else
+    printf("  amounts   float\n");
+#endif
+    printf("  workers   %d threads, %d industries per slice\n", workers_count(), economy_slice_industries);
+    printf("  simulated %d periods, %d tics\n", scenario->periods, acs_timer());
+    printf("  tics/s    %.0f\n", acs_timer() / ((end - start) / 1e9));
+    bench_report_timer(&t_economy);
+    bench_report_timer(&t_pass);
+    bench_report_per("industry_end_period", t_pass.ns, (long) num_industries * economy_periods);
+
+    if (scenario->replay) {
+        bench_report_timer(&t_save);
+    }
+
+    bench_report_timer(&t_accept);
+    bench_report_timer(&t_add);
+    bench_report_timer(&t_balance);
+    bench_report_timer(&t_route);
+    printf("  routes    %ld of %ld found\n", routes_found, t_route.calls);
+
+    if (scenario->snapshots) {
+        printf("  snapshots %d full, avg %ld words; %d delta, avg %ld words\n", bench_snapshots.fulls, bench_snapshots.fulls ? bench_snapshots.full_words / bench_snapshots.fulls : 0,
+            bench_snapshots.deltas, bench_snapshots.deltas ? bench_snapshots.delta_words / bench_snapshots.deltas : 0);
+        bench_report_per("economy_save (full)", bench_snapshots.full_ns, bench_snapshots.fulls);
+        bench_report_per("economy_save (delta)", bench_snapshots.delta_ns, bench_snapshots.deltas);
+        bench_report_per("economy_restore", restore_ns, 1);
+        printf("  restored  %d snapshots\n", restored);
+    }
+
+    printf("  peak rss  %ld KiB\n", usage.ru_maxrss);
+
+    return 0;
+}
+
+static int bench_run_forked(const struct bench_scenario_t *scenario) {
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+
+    pid = fork();
+
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+
+    if (pid == 0) {
+        const int res = bench_run(scenario);
+
+        fflush(stdout);
+        _exit(res);
+    }
+
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)) {
+        return 1;
+    }
+
+    return WEXITSTATUS(status);
+}
+
+static void bench_usage(const char *argv0) {
+    fprintf(stderr,
+        "usage: %s [scenario...]\n"
+        "       %s -i industries -s stations -c companies [-v vehicles] [-p periods] [-d deliveries] [-D] [-g places] [-S] [-j threads] [-l slice] [-R]\n"
+        "\n"
+        "scenarios:", argv0, argv0);
+
+    for (size_t i = 0; i < NUM_BENCH_SCENARIOS; i++) {
+        fprintf(stderr, " %s", bench_scenarios[i].name);
+    }
+
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv) {
+    struct bench_scenario_t custom = { "custom", 0, 0, 0, 0, 100, 16, INDUSTRY_DISTRIBUTE_EVEN };
+    int opt, failed = 0, use_custom = 0;
+    size_t i;
+
+    while ((opt = getopt(argc, argv, "i:s:c:v:p:d:Dg:Sj:l:Rh")) != -1) {
+        use_custom = 1;
+
+        switch (opt) {
+            case 'i': custom.num_industries = atoi(optarg); break;
+            case 's': custom.num_stations = atoi(optarg); break;
+            case 'c': custom.num_companies = atoi(optarg); break;
+            case 'v': custom.num_vehicles = atoi(optarg); break;
+            case 'p': custom.periods = atoi(optarg); break;
+            case 'd': custom.deliveries = atoi(optarg); break;
+            case 'D': custom.distribution = INDUSTRY_DISTRIBUTE_DEMAND; break;
+            case 'g': custom.places = atoi(optarg); break;
+            case 'S': custom.snapshots = 1; break;
+            case 'j': custom.threads = atoi(optarg); break;
+            case 'l': custom.slice = atoi(optarg); break;
+            case 'R': custom.replay = 1; break;
+
+            default:
+                bench_usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (use_custom) {
+        if (custom.num_industries <= 0 || custom.num_industries > MAX_INDUSTRIES
+         || custom.num_stations < 0 || custom.num_stations > MAX_STATIONS
+         || custom.num_companies < 0 || custom.num_companies > MAX_COMPANIES
+         || custom.num_vehicles < 0 || custom.num_vehicles > MAX_VEHICLES
+         || custom.places < 0 || custom.places > MAX_SPOTS
+         || custom.threads < 0 || custom.threads > MAX_WORKERS
+         || custom.slice < 0) {
+            bench_usage(argv[0]);
+            return 2;
+        }
+
+        return bench_run_forked(&custom);
+    }
+
+    if (optind == argc) {
+        for (i = 0; i < NUM_BENCH_SCENARIOS; i++) {
+            failed |= bench_run_forked(&bench_scenarios[i]);
+        }
+
+        return failed;
+    }
+
+    for (; optind < argc; optind++) {
+        for (i = 0; i < NUM_BENCH_SCENARIOS; i++) {
+            if (strcmp(argv[optind], bench_scenarios[i].name) == 0) {
+                break;
+            }
+        }
+
+        if (i == NUM_BENCH_SCENARIOS) {
+            bench_usage(argv[0]);
+            return 2;
+        }
+
+        failed |= bench_run_forked(&bench_scenarios[i]);
+    }
+
+    return failed;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file host_memreport.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Static memory report of a capacity profile.
+ * @version added in 0.1
+ * @date 2021-03-16
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * Prints the footprint of every static world table under the capacity
+ * profile it is built with (see m_profile.h), along with what a single
+ * item of each kind costs, and exits with an error if the tables add
+ * up to more than the profile's memory budget. build.ninja runs it on
+ * every build, so a profile that outgrows its budget fails the build.
+ *
+ * The simulation sources are included here whole, since most tables
+ * are static to their modules. Sizes are as laid out by the compiler
+ * building this report, which need not match gdcc's layout exactly;
+ * they are meant to compare profiles against each other and against
+ * a budget set in the same terms, not as an exact ACS memory map.
+ */
+
+#include <stdio.h>
+
+#include "../src/m_error.c"
+#include "../src/m_fixed.c"
+#include "../src/m_snapshot.c"
+#include "../src/m_replay.c"
+#include "../src/h_cargo.c"
+#include "../src/h_industry.c"
+#include "../src/h_station.c"
+#include "../src/h_company.c"
+#include "../src/h_economy.c"
+#include "../src/h_vehicle.c"
+#include "../src/h_route.c"
+#include "../src/i_place.c"
+#include "../src/i_mapgen.c"
+#include "host_acs.c"
+
+
+/**
+ * @brief A static table, and its size in bytes.
+ */
+struct memreport_table_t {
+    const char *module;
+    const char *name;
+    size_t size;
+};
+
+/**
+ * @brief The cost of a single item of a kind, in bytes.
+ */
+struct memreport_item_t {
+    const char *name;
+    size_t size;
+};
+
+#define MEMREPORT_TABLE(module, table) { module, #table, sizeof(table) }
+
+static const struct memreport_table_t memreport_tables[] = {
+    MEMREPORT_TABLE("h_cargo", cargo_types),
+#ifdef INDUSTRY_SOA
+    MEMREPORT_TABLE("h_industry", industry_soa),
+#else
+    MEMREPORT_TABLE("h_industry", industries),
+#endif
+    MEMREPORT_TABLE("h_industry", industry_catchments),
+    MEMREPORT_TABLE("h_industry", industry_snapshot_hashes),
+    MEMREPORT_TABLE("h_industry", industry_catchment_snapshot_hashes),
+    MEMREPORT_TABLE("h_industry", industry_types),
+    MEMREPORT_TABLE("h_station", stations),
+    MEMREPORT_TABLE("h_station", station_dirty),
+    MEMREPORT_TABLE("h_station", station_snapshot_hashes),
+    MEMREPORT_TABLE("h_company", companies),
+    MEMREPORT_TABLE("h_company", company_free),
+    MEMREPORT_TABLE("h_company", player_companies),
+    MEMREPORT_TABLE("h_company", company_ledgers),
+    MEMREPORT_TABLE("h_company", company_snapshot_hashes),
+    MEMREPORT_TABLE("h_company", company_ledger_snapshot_hashes),
+    MEMREPORT_TABLE("h_vehicle", vehicles),
+    MEMREPORT_TABLE("h_vehicle", vehicle_free),
+    MEMREPORT_TABLE("h_vehicle", vehicle_queue),
+    MEMREPORT_TABLE("h_vehicle", vehicle_snapshot_hashes),
+    MEMREPORT_TABLE("h_vehicle", vehicle_free_snapshot_hashes),
+    MEMREPORT_TABLE("h_vehicle", vehicle_queue_snapshot_hashes),
+    MEMREPORT_TABLE("h_route", route_links),
+    MEMREPORT_TABLE("h_route", route_out),
+    MEMREPORT_TABLE("h_route", route_in),
+    MEMREPORT_TABLE("h_route", route_link_snapshot_hashes),
+    MEMREPORT_TABLE("h_route", route_trees),
+    MEMREPORT_TABLE("h_route", route_work_next),
+    MEMREPORT_TABLE("h_route", route_work_cost),
+    MEMREPORT_TABLE("h_route", route_heap),
+    MEMREPORT_TABLE("i_place", place_spotmap),
+    MEMREPORT_TABLE("i_place", place_spots),
+    MEMREPORT_TABLE("i_place", place_free_spots),
+    MEMREPORT_TABLE("i_place", spot_query_stamps),
+    MEMREPORT_TABLE("i_place", place_covers),
+    MEMREPORT_TABLE("i_place", spot_snapshot_hashes),
+    MEMREPORT_TABLE("i_place", spot_free_snapshot_hashes),
+    MEMREPORT_TABLE("i_place", spotmap_snapshot_hashes),
+    MEMREPORT_TABLE("i_place", spot_cover_snapshot_hashes),
+    MEMREPORT_TABLE("i_mapgen", mapgen_places),
+    MEMREPORT_TABLE("m_snapshot", snapshot_block),
+    MEMREPORT_TABLE("m_snapshot", snapshot_regions),
+    MEMREPORT_TABLE("m_replay", replay_log),
+    MEMREPORT_TABLE("m_replay", replay_line),
+    MEMREPORT_TABLE("m_error", error_strings)
+};
+
+#define NUM_MEMREPORT_TABLES (sizeof(memreport_tables) / sizeof(*memreport_tables))
+
+/**
+ * @brief What each item added to a profile's capacity costs, across all tables.
+ *
+ * Industries and stations do not count the spot each of them takes.
+ */
+static const struct memreport_item_t memreport_items[] = {
+    { "industry",   sizeof(struct industry_t) + sizeof(industry_catchments[0]) },
+    { "station",    sizeof(stations[0]) + sizeof(route_out[0]) + sizeof(route_in[0]) + sizeof(route_work_next[0]) + sizeof(route_work_cost[0])
+                  + MAX_ROUTE_TREES * (sizeof(route_trees[0].next_hop[0]) + sizeof(route_trees[0].cost[0])) },
+    { "company",    sizeof(companies[0]) + sizeof(company_ledgers[0]) },
+    { "vehicle",    sizeof(vehicles[0]) + sizeof(vehicle_free[0]) + sizeof(vehicle_queue[0]) },
+    { "route link", sizeof(route_links[0]) + sizeof(route_heap[0]) },
+    { "spot",       sizeof(place_spots[0]) + sizeof(place_free_spots[0]) + sizeof(spot_query_stamps[0]) + sizeof(mapgen_places[0]) },
+    { "spot tile",  sizeof(place_spotmap.tiles[0]) + 2 * sizeof(place_spotmap.slots[0]) }
+};
+
+#define NUM_MEMREPORT_ITEMS (sizeof(memreport_items) / sizeof(*memreport_items))
+
+
+int main(void) {
+    size_t i, total = 0;
+
+    printf("profile %s\n\n", PROFILE_NAME);
+    printf("  %-12s %-34s %12s\n", "module", "table", "bytes");
+
+    for (i = 0; i < NUM_MEMREPORT_TABLES; i++) {
+        printf("  %-12s %-34s %12zu\n", memreport_tables[i].module, memreport_tables[i].name, memreport_tables[i].size);
+        total += memreport_tables[i].size;
+    }
+
+    printf("  %-47s %12zu\n\n", "total", total);
+
+    printf("  %-47s %12s\n", "per item", "bytes");
+
+    for (i = 0; i < NUM_MEMREPORT_ITEMS; i++) {
+        printf("  %-47s %12zu\n", memreport_items[i].name, memreport_items[i].size);
+    }
+
+    printf("\n");
+
+    if (total > (size_t) PROFILE_MEMORY_BUDGET) {
+        printf("over budget: %zu of %zu bytes\n", total, (size_t) PROFILE_MEMORY_BUDGET);
+        fprintf(stderr, "profile %s: static tables take %zu bytes, over its budget of %zu\n", PROFILE_NAME, total, (size_t) PROFILE_MEMORY_BUDGET);
+        return 1;
+    }
+
+    printf("within budget: %zu of %zu bytes\n", total, (size_t) PROFILE_MEMORY_BUDGET);
+
+    return 0;
+}
@@ -0,0 +1,389 @@
+/**
+ * @file host_replay.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Replays a dumped economy event log on the native host build.
+ * @version added in 0.1
+ * @date 2021-03-17
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * Reads the last dump printed by the replay_dump script out of a log
+ * file (see m_replay.h), restores the world from the store in it, and
+ * calls again, in order, every function the events after the mark of
+ * the last snapshot were recorded by. Each call is checked against its
+ * event, and timed; replaying the same dump several times over makes
+ * for a benchmark of the load it was recorded under.
+ *
+ * The store is written into a temporary file, as the bench does. Its
+ * snapshots can only be restored if they were written by a build with
+ * the same table layout as this one, such as the bench's (-R); those
+ * of the ZDoom builds are not, yet.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "m_acs.h"
+#include "m_replay.h"
+#include "h_economy.h"
+#include "h_company.h"
+#include "h_industry.h"
+#include "h_station.h"
+
+
+/**
+ * @brief The longest line of a log file that is read whole.
+ */
+#define REPLAY_MAX_LINE 256
+
+/**
+ * @brief A dump, as read out of a log file.
+ */
+static struct {
+    unsigned int header[5];
+    unsigned int *store;
+    size_t store_length, store_room;
+    struct replay_event_t *events;
+    size_t num_events, events_room;
+    int complete;
+} replay_dump_read;
+
+static const char *const replay_kind_names[NUM_REPLAY_KINDS] = {
+    "snapshot",
+    "company_post",
+    "company_loan",
+    "station_add_aged_cargo",
+    "industry_accept_cargo"
+};
+
+/**
+ * @brief The wall time spent replaying each kind of event, and how many were.
+ */
+static struct {
+    double ns;
+    long calls;
+} replay_timers[NUM_REPLAY_KINDS];
+
+
+static double replay_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Parses the hexadecimal words after the tag of a dump line.
+ *
+ * @return size_t The number of words parsed.
+ */
+static size_t replay_parse_words(const char *text, unsigned int *words, size_t max_words) {
+    size_t num_words = 0;
+    char *end;
+
+    while (num_words < max_words) {
+        words[num_words] = (unsigned int) strtoul(text, &end, 16);
+
+        if (end == text) {
+            break;
+        }
+
+        text = end;
+        num_words++;
+    }
+
+    return num_words;
+}
+
+static int replay_grow(void **array, size_t *room, size_t needed, size_t item_size) {
+    void *grown;
+
+    if (needed <= *room) {
+        return 0;
+    }
+
+    grown = realloc(*array, (*room ? *room * 2 : 1024) * item_size);
+
+    if (grown == NULL) {
+        return -1;
+    }
+
+    *array = grown;
+    *room = *room ? *room * 2 : 1024;
+
+    return 0;
+}
+
+/**
+ * @brief Reads the last whole dump out of a log file.
+ */
+static int replay_read_dump(FILE *log) {
+    char line[REPLAY_MAX_LINE];
+    unsigned int words[REPLAY_DUMP_LINE_WORDS > REPLAY_EVENT_WORDS ? REPLAY_DUMP_LINE_WORDS : REPLAY_EVENT_WORDS];
+    size_t num_words;
+    int in_dump = 0;
+
+    while (fgets(line, sizeof(line), log) != NULL) {
+        if (strncmp(line, "IFREPLAY END", 12) == 0) {
+            replay_dump_read.complete = in_dump;
+            in_dump = 0;
+        }
+
+        else if (strncmp(line, "IFREPLAY ", 9) == 0) {
+            // a later dump replaces any earlier one
+            in_dump = replay_parse_words(line + 9, replay_dump_read.header, 5) == 5;
+            replay_dump_read.store_length = 0;
+            replay_dump_read.num_events = 0;
+            replay_dump_read.complete = 0;
+        }
+
+        else if (in_dump && strncmp(line, "IFSTORE ", 8) == 0) {
+            num_words = replay_parse_words(line + 8, words, REPLAY_DUMP_LINE_WORDS);
+
+            if (replay_grow((void **) &replay_dump_read.store, &replay_dump_read.store_room, replay_dump_read.store_length + num_words, sizeof(unsigned int)) < 0) {
+                return -1;
+            }
+
+            memcpy(&replay_dump_read.store[replay_dump_read.store_length], words, num_words * sizeof(unsigned int));
+            replay_dump_read.store_length += num_words;
+        }
+
+        else if (in_dump && strncmp(line, "IFEVENT ", 8) == 0) {
+            if (replay_parse_words(line + 8, words, REPLAY_EVENT_WORDS) != REPLAY_EVENT_WORDS) {
+                in_dump = 0;
+                continue;
+            }
+
+            if (replay_grow((void **) &replay_dump_read.events, &replay_dump_read.events_room, replay_dump_read.num_events + 1, sizeof(struct replay_event_t)) < 0) {
+                return -1;
+            }
+
+            replay_decode(words, &replay_dump_read.events[replay_dump_read.num_events++]);
+        }
+    }
+
+    if (!replay_dump_read.complete
+     || replay_dump_read.store_length != replay_dump_read.header[4]
+     || replay_dump_read.num_events != replay_dump_read.header[3]) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Calls the function an event was recorded by, with the same arguments.
+ *
+ * The subject comes straight out of the log, which may be stale or
+ * corrupt, so it is checked against the restored world first; an
+ * event about something that does not exist counts as failed.
+ *
+ * @return error_return_t Whatever the function returned.
+ */
+static error_return_t replay_call(const struct replay_event_t *event) {
+    switch (event->kind) {
+        case REPLAY_COMPANY_BALANCE:
+            if (event->subject < 0 || !company_exists(event->subject)) {
+                return -ERR_COMPANY_BAD_INDEX;
+            }
+
+            return company_post(event->subject, event->args[0], event->amount);
+
+        case REPLAY_COMPANY_LOAN:
+            if (event->subject < 0 || !company_exists(event->subject)) {
+                return -ERR_COMPANY_BAD_INDEX;
+            }
+
+            return company_loan(event->subject, event->amount);
+
+        case REPLAY_STATION_CARGO:
+            if (event->subject < 0 || !station_exists(event->subject)) {
+                return -ERR_STATION_BAD_INDEX;
+            }
+
+            return station_add_aged_cargo(event->subject, event->args[0], event->args[1], event->amount, event->args[2]);
+
+        case REPLAY_INDUSTRY_ACCEPT:
+            if (event->subject < 0 || event->subject >= num_industries) {
+                return -ERR_INDUSTRY_BAD_INDEX;
+            }
+
+            return industry_accept_cargo(event->subject, event->args[0], event->amount);
+
+        default:
+            return 0;
+    }
+}
+
+static void replay_print_event(const char *label, size_t index, const struct replay_event_t *event, const struct replay_event_t *replayed) {
+    printf("  %-9s #%zu %s(%d), %g -> %g in the game, %g -> %g replayed\n", label, index, replay_kind_names[event->kind], event->subject,
+        econ_to_float(event->before), econ_to_float(event->after), econ_to_float(replayed->before), econ_to_float(replayed->after));
+}
+
+static void replay_usage(const char *argv0) {
+    fprintf(stderr,
+        "usage: %s [-f] [-n repeats] logfile\n"
+        "\n"
+        "  -f  replay every event in the dump, even if the log does not reach back to the last snapshot\n"
+        "  -n  replay the dump this many times over, restoring the world each time\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    const struct replay_event_t *event, *replayed;
+    FILE *log;
+    char store_path[64];
+    double lap;
+    unsigned int number;
+    size_t start = 0, i;
+    long drifted = 0, diverged = 0, failed = 0;
+    int opt, force = 0, forced = 0, repeats = 1, repeat, restored;
+    error_return_t res;
+
+    while ((opt = getopt(argc, argv, "fn:h")) != -1) {
+        switch (opt) {
+            case 'f': force = 1; break;
+            case 'n': repeats = atoi(optarg); break;
+
+            default:
+                replay_usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind != argc - 1 || repeats <= 0) {
+        replay_usage(argv[0]);
+        return 2;
+    }
+
+    log = strcmp(argv[optind], "-") == 0 ? stdin : fopen(argv[optind], "r");
+
+    if (log == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    if (replay_read_dump(log) < 0) {
+        fprintf(stderr, "%s: no whole event log dump found\n", argv[optind]);
+        return 1;
+    }
+
+    if (replay_dump_read.header[0] != REPLAY_VERSION || replay_dump_read.header[1] != (unsigned int) ECON_ONE) {
+        fprintf(stderr, "%s: dump is of a different build or version\n", argv[optind]);
+        return 1;
+    }
+
+    snprintf(store_path, sizeof(store_path), "%s/infindus-replay-%d.snap", P_tmpdir, (int) getpid());
+    host_store_path = store_path;
+
+    acs_store_clear();
+
+    if (!acs_store_append(replay_dump_read.store, replay_dump_read.store_length)) {
+        fprintf(stderr, "%s: could not write store\n", store_path);
+        return 1;
+    }
+
+    // replay from the mark of the last snapshot, which the store holds the world as of
+    for (i = replay_dump_read.num_events; i > 0; i--) {
+        if (replay_dump_read.events[i - 1].kind == REPLAY_SNAPSHOT) {
+            start = i;
+            break;
+        }
+    }
+
+    for (repeat = 0; repeat < repeats; repeat++) {
+        restored = economy_restore();
+
+        if (restored == -ERR_SNAPSHOT_BAD_LAYOUT) {
+            fprintf(stderr, "%s: dump was written by a build with a different table layout (such as the ZDoom builds, or another profile); only dumps of this very build, e.g. by infindus-bench -R, can be replayed\n", argv[optind]);
+            remove(store_path);
+            return 1;
+        }
+
+        if (restored < 0) {
+            fprintf(stderr, "%s: could not restore world from the dump\n", argv[optind]);
+            remove(store_path);
+            return 1;
+        }
+
+        if (repeat == 0 && (start == 0 || replay_dump_read.events[start - 1].subject != (int) snapshot_sequence())) {
+            if (!force) {
+                fprintf(stderr, "%s: event log does not reach back to the last snapshot (try -f)\n", argv[optind]);
+                remove(store_path);
+                return 1;
+            }
+
+            forced = 1;
+            start = 0;
+        }
+
+        if (repeat == 0) {
+            printf("replay %s\n", argv[optind]);
+            printf("  dump      %zu of %u events recorded, %zu store words\n", replay_dump_read.num_events, replay_dump_read.header[2], replay_dump_read.store_length);
+            printf("  restored  %d snapshots; replaying from event #%zu%s\n", restored, start, forced ? " (forced)" : "");
+        }
+
+        for (i = start; i < replay_dump_read.num_events; i++) {
+            event = &replay_dump_read.events[i];
+
+            if (event->kind == REPLAY_SNAPSHOT || event->kind >= NUM_REPLAY_KINDS) {
+                continue;
+            }
+
+            number = replay_count();
+            lap = replay_now_ns();
+            res = replay_call(event);
+
+            replay_timers[event->kind].ns += replay_now_ns() - lap;
+            replay_timers[event->kind].calls++;
+
+            if (repeat > 0) {
+                continue;
+            }
+
+            if (res < 0) {
+                if (failed++ == 0) {
+                    printf("  failed    #%zu %s(%d)\n", i, replay_kind_names[event->kind], event->subject);
+                }
+
+                continue;
+            }
+
+            replayed = replay_get(number);
+
+            if (replayed == NULL) {
+                continue;
+            }
+
+            // a value that drifted away from the game's cannot be expected to come out the same
+            if (replayed->before != event->before) {
+                if (drifted++ == 0) {
+                    replay_print_event("drifted", i, event, replayed);
+                }
+            }
+
+            else if (replayed->after != event->after) {
+                if (diverged++ == 0) {
+                    replay_print_event("diverged", i, event, replayed);
+                }
+            }
+        }
+    }
+
+    remove(store_path);
+
+    printf("  replayed  %zu events, %d times\n", replay_dump_read.num_events - start, repeats);
+
+    for (i = 0; i < NUM_REPLAY_KINDS; i++) {
+        if (replay_timers[i].calls > 0) {
+            printf("  ns/call   %-26s %10.1f  (%ld calls)\n", replay_kind_names[i], replay_timers[i].ns / replay_timers[i].calls, replay_timers[i].calls);
+        }
+    }
+
+    printf("  checked   %ld diverged, %ld failed, %ld drifted\n", diverged, failed, drifted);
+
+    return diverged > 0 || failed > 0;
+}
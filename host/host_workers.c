@@ -0,0 +1,140 @@
+/**
+ * @file host_workers.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Worker thread pool for the native host build.
+ * @version added in 0.1
+ * @date 2021-03-17
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * Implements m_workers.h on top of POSIX threads. Workers sleep until
+ * a job is run, then take up its parts through an atomic counter, so
+ * the only locking is in waking them up and waiting for them to be
+ * done.
+ */
+
+#include <pthread.h>
+
+#include "m_workers.h"
+
+
+static pthread_t host_workers[MAX_WORKERS];
+static int host_num_workers = 1;
+
+static pthread_mutex_t host_workers_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_workers_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t host_workers_done = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief The job being run, and how many parts it is split into.
+ */
+static worker_job_t host_job;
+static int host_job_parts;
+
+/**
+ * @brief The next part of the job to be taken up.
+ */
+static int host_job_next;
+
+/**
+ * @brief Counts the jobs run so far; workers wake up when it changes.
+ */
+static unsigned int host_job_round = 0;
+
+/**
+ * @brief The number of workers yet to be done with the job.
+ */
+static int host_job_busy = 0;
+
+
+/**
+ * @brief Does parts of the running job, until there are none left.
+ */
+static void _host_workers_take_parts(void) {
+    int part;
+
+    while ((part = __atomic_fetch_add(&host_job_next, 1, __ATOMIC_RELAXED)) < host_job_parts) {
+        host_job(part, host_job_parts);
+    }
+}
+
+static void *_host_worker_main(void *arg) {
+    unsigned int round = 0;
+
+    pthread_mutex_lock(&host_workers_lock);
+
+    for (;;) {
+        while (host_job_round == round) {
+            pthread_cond_wait(&host_workers_wake, &host_workers_lock);
+        }
+
+        round = host_job_round;
+
+        pthread_mutex_unlock(&host_workers_lock);
+        _host_workers_take_parts();
+        pthread_mutex_lock(&host_workers_lock);
+
+        if (--host_job_busy == 0) {
+            pthread_cond_signal(&host_workers_done);
+        }
+    }
+
+    return NULL;
+}
+
+error_return_t workers_start(int count) {
+    if (count > MAX_WORKERS) {
+        count = MAX_WORKERS;
+    }
+
+    if (host_num_workers > 1) {
+        errori(ERR_WORKERS_START);
+    }
+
+    for (; host_num_workers < count; host_num_workers++) {
+        if (pthread_create(&host_workers[host_num_workers], NULL, _host_worker_main, NULL) != 0) {
+            errori(ERR_WORKERS_START);
+        }
+
+        pthread_detach(host_workers[host_num_workers]);
+    }
+
+    return 0;
+}
+
+int workers_count(void) {
+    return host_num_workers;
+}
+
+void workers_run(worker_job_t job, int num_parts) {
+    int part;
+
+    if (host_num_workers <= 1) {
+        for (part = 0; part < num_parts; part++) {
+            job(part, num_parts);
+        }
+
+        return;
+    }
+
+    pthread_mutex_lock(&host_workers_lock);
+
+    host_job = job;
+    host_job_parts = num_parts;
+    host_job_next = 0;
+    host_job_busy = host_num_workers - 1;
+    host_job_round++;
+
+    pthread_cond_broadcast(&host_workers_wake);
+    pthread_mutex_unlock(&host_workers_lock);
+
+    _host_workers_take_parts();
+
+    pthread_mutex_lock(&host_workers_lock);
+
+    while (host_job_busy > 0) {
+        pthread_cond_wait(&host_workers_done, &host_workers_lock);
+    }
+
+    pthread_mutex_unlock(&host_workers_lock);
+}
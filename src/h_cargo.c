@@ -20,7 +20,8 @@ const struct cargo_t cargo_types[] = {
 
         "Flesh",
         "kg",
-        (920 * 512) / 1000
+        (920 * 512) / 1000,
+        ECON_C(4.5), { 4, 18 } // payment, transit_buckets
     },
 
     {
@@ -28,7 +29,8 @@ const struct cargo_t cargo_types[] = {
         "l",
 
         // in litres
-        512
+        512,
+        ECON_C(3.0), { 7, 255 } // payment, transit_buckets
     },
 
     {
@@ -37,7 +39,8 @@ const struct cargo_t cargo_types[] = {
 
         "Brains",
         "kg",
-        (1100 * 512) / 1000
+        (1100 * 512) / 1000,
+        ECON_C(6.0), { 2, 20 } // payment, transit_buckets
     },
 
     {
@@ -46,25 +49,29 @@ const struct cargo_t cargo_types[] = {
 
         "Hooves",
         "kg",
-        (7859 * 512) / 1000
+        (7859 * 512) / 1000,
+        ECON_C(3.2), { 9, 255 } // payment, transit_buckets
     },
 
     {
         "Wart",
         "l",
-        512 // litres of crop harvest
+        512, // litres of crop harvest
+        ECON_C(3.5), { 4, 40 } // payment, transit_buckets
     },
 
     {
         "Blood",
         "l",
-        512 // litres of blood
+        512, // litres of blood
+        ECON_C(4.0), { 3, 24 } // payment, transit_buckets
     },
 
     {
         "Bottled Pain",
         "l",
-        512 // litres of pain lol
+        512, // litres of pain lol
+        ECON_C(5.5), { 5, 28 } // payment, transit_buckets
     },
 
     {
@@ -72,7 +79,8 @@ const struct cargo_t cargo_types[] = {
 
         "Steel",
         "kg",
-        (7859 * 512) / 1000
+        (7859 * 512) / 1000,
+        ECON_C(4.8), { 7, 255 } // payment, transit_buckets
     },
 
     {
@@ -81,7 +89,8 @@ const struct cargo_t cargo_types[] = {
 
         "Bonesteel",
         "kg",
-        (7100 * 512) / 1000
+        (7100 * 512) / 1000,
+        ECON_C(5.5), { 7, 255 } // payment, transit_buckets
     },
 
     {
@@ -89,25 +98,29 @@ const struct cargo_t cargo_types[] = {
 
         "Fertilizer",
         "kg",
-        (961 * 512) / 1000
+        (961 * 512) / 1000,
+        ECON_C(3.0), { 10, 255 } // payment, transit_buckets
     },
 
     {
         "Energy",
         "kJ",
-        (25400 * 512) // 25400 kJ required to boil 10L of water, in 1L of energy
+        (25400 * 512), // 25400 kJ required to boil 10L of water, in 1L of energy
+        ECON_C(6.0), { 1, 10 } // payment, transit_buckets
     },
 
     {
         "Bottled Pride",
         "l",
-        512
+        512,
+        ECON_C(6.0), { 5, 28 } // payment, transit_buckets
     },
 
     {
         "Hate Ale",
         "l",
-        512
+        512,
+        ECON_C(5.0), { 6, 40 } // payment, transit_buckets
     },
 
     {
@@ -117,25 +130,80 @@ const struct cargo_t cargo_types[] = {
 
         "Gas",
         "l",
-        512
+        512,
+        ECON_C(3.5), { 15, 255 } // payment, transit_buckets
     },
 
     {
         "Goods",
         "kg",
-        (3500 * 512) / 1000
+        (3500 * 512) / 1000,
+        ECON_C(6.5), { 5, 28 } // payment, transit_buckets
     },
 
     {
         // The density of silicon is 2330 g/L.
         "Silicon",
         "kg",
-        (2330 * 512) / 1000
+        (2330 * 512) / 1000,
+        ECON_C(4.5), { 9, 255 } // payment, transit_buckets
     },
 
     {
         "Microchips",
         "l",
-        512
+        512,
+        ECON_C(8.0), { 1, 32 } // payment, transit_buckets
     }
-};
\ No newline at end of file
+};
+
+const size_t num_cargo_types = sizeof(cargo_types) / sizeof(*cargo_types);
+
+void cargo_parcel_merge(struct cargo_parcel_t *parcel, econ_t amount, float age, float origin_x, float origin_y) {
+    const econ_t total = parcel->amount + amount;
+
+    if (amount <= 0.0) {
+        return;
+    }
+
+    // the scale of fixed-point amounts cancels out in these averages
+    parcel->age = (parcel->age * (float) parcel->amount + age * (float) amount) / (float) total;
+    parcel->origin_x = (parcel->origin_x * (float) parcel->amount + origin_x * (float) amount) / (float) total;
+    parcel->origin_y = (parcel->origin_y * (float) parcel->amount + origin_y * (float) amount) / (float) total;
+    parcel->amount = total;
+}
+
+econ_t cargo_delivery_payment(cargo_handle_t cargo_type, econ_t amount, float distance, unsigned int age) {
+    if (cargo_type >= num_cargo_types) {
+        errorac(ERR_BAD_MATERIAL, 0, "cargo_delivery_payment");
+    }
+
+    const struct cargo_t *const cargo = &cargo_types[cargo_type];
+
+    int over_first = (int) age - cargo->transit_buckets[0];
+    int over_second;
+    int time_factor;
+    econ_t payment;
+
+    if (over_first < 0) {
+        over_first = 0;
+    }
+
+    over_second = over_first - cargo->transit_buckets[1];
+
+    if (over_second < 0) {
+        over_second = 0;
+    }
+
+    time_factor = CARGO_MAX_TIME_FACTOR - over_first - over_second;
+
+    if (time_factor < CARGO_MIN_TIME_FACTOR) {
+        time_factor = CARGO_MIN_TIME_FACTOR;
+    }
+
+    payment = econ_mul(cargo->payment, amount / 512);
+    payment = econ_mul(payment, econ_from_float(distance / 1024.0f));
+
+    // scaled by the ratio, not by time_factor and back, which would saturate large payments
+    return econ_mul(payment, econ_div(econ_from_int(time_factor), econ_from_int(CARGO_MAX_TIME_FACTOR)));
+}
@@ -13,11 +13,46 @@
 
 #include <stddef.h>
 
+#include "m_acs.h"
+#include "m_error.h"
+#include "m_fixed.h"
+
 
 /**
  * @brief The maximum number of cargo types.
  */
-#define MAX_CARGO_TYPES 64;
+#define MAX_CARGO_TYPES 64
+
+/**
+ * @brief The length of a cargo age bucket, in tics.
+ *
+ * Cargo age is not counted in tics, but in buckets this long. Cargo
+ * only ages once per bucket, in a single pass over all stations (see
+ * station_age_cargo), much like OpenTTD ages its cargo once every
+ * 185 ticks.
+ */
+#define CARGO_AGE_BUCKET_TICS (5 * TICRATE)
+
+/**
+ * @brief The oldest a cargo can get, in age buckets.
+ *
+ * Cargo age saturates here.
+ */
+#define CARGO_MAX_AGE 255
+
+/**
+ * @brief The delivery time factor of cargo delivered in time.
+ *
+ * @see cargo_delivery_payment
+ */
+#define CARGO_MAX_TIME_FACTOR 255
+
+/**
+ * @brief The lowest delivery time factor, no matter how late cargo is.
+ *
+ * @see cargo_delivery_payment
+ */
+#define CARGO_MIN_TIME_FACTOR 31
 
 
 /**
@@ -51,6 +86,24 @@ struct cargo_t {
      * Units of this cargo type.
      */
     int conversion;
+
+    /**
+     * @brief Base delivery payment.
+     *
+     * The money paid for delivering 512 Cargo Units of this cargo
+     * type 1024 units of distance away from its origin, if delivered
+     * in time.
+     */
+    econ_t payment;
+
+    /**
+     * @brief How long this cargo type keeps its value, in age buckets.
+     *
+     * Cargo delivered within transit_buckets[0] age buckets is paid in
+     * full. Past that, payment starts dropping; past another
+     * transit_buckets[1] buckets, it drops twice as fast.
+     */
+    unsigned char transit_buckets[2];
 };
 
 /**
@@ -58,10 +111,72 @@ struct cargo_t {
  */
 extern const struct cargo_t cargo_types[];
 
+/**
+ * @brief The number of cargo types in cargo_types.
+ */
+extern const size_t num_cargo_types;
+
 /**
  * @brief An index into a cargo type.
  */
 typedef size_t cargo_handle_t;
 
+/**
+ * @brief An amount of cargo on the move.
+ *
+ * Cargo taken out of stations is carried around in parcels. Cargo of
+ * different ages and origins can be merged into the same parcel; its
+ * age and origin are then averaged, weighted by amount.
+ */
+struct cargo_parcel_t {
+    /**
+     * @brief Amount of cargo in this parcel, in Cargo Units.
+     */
+    econ_t amount;
+
+    /**
+     * @brief Age of the cargo in this parcel, in age buckets.
+     */
+    float age;
+
+    /**
+     * @brief X coordinate of where the cargo in this parcel came from.
+     */
+    float origin_x;
+
+    /**
+     * @brief Y coordinate of where the cargo in this parcel came from.
+     */
+    float origin_y;
+};
+
+/**
+ * @brief Merges an amount of cargo into a parcel.
+ *
+ * @param parcel The parcel to merge cargo into.
+ * @param amount The amount of cargo to merge, in Cargo Units.
+ * @param age The age of the cargo to merge, in age buckets.
+ * @param origin_x X coordinate of where the cargo came from.
+ * @param origin_y Y coordinate of where the cargo came from.
+ */
+void cargo_parcel_merge(struct cargo_parcel_t *parcel, econ_t amount, float age, float origin_x, float origin_y);
+
+/**
+ * @brief Computes the payment for delivering cargo.
+ *
+ * Follows OpenTTD's delivery payment formula. Payment is proportional
+ * to the amount of cargo and to the distance between where it was
+ * picked up and where it was delivered, and is scaled by a time factor,
+ * which starts at CARGO_MAX_TIME_FACTOR and drops as the cargo ages
+ * past the cargo type's transit_buckets, down to CARGO_MIN_TIME_FACTOR.
+ *
+ * @param cargo_type The type of the cargo delivered.
+ * @param amount The amount of cargo delivered, in Cargo Units.
+ * @param distance The distance from the cargo's origin.
+ * @param age The age of the cargo, in age buckets.
+ * @return econ_t The money to be paid for the delivery.
+ */
+econ_t cargo_delivery_payment(cargo_handle_t cargo_type, econ_t amount, float distance, unsigned int age);
+
 
 #endif // CARGO_H
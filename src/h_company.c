@@ -12,33 +12,125 @@
 
 #include "m_error.h"
 #include "h_company.h"
+#include "m_replay.h"
+#include "h_station.h"
+#include "h_vehicle.h"
 
 
 static struct company_t companies[MAX_COMPANIES];
 size_t num_companies = 0;
-float max_loan = DEFAULT_MAX_LOAN;
+econ_t max_loan = ECON_C(DEFAULT_MAX_LOAN);
+econ_t loan_interest = ECON_C(DEFAULT_LOAN_INTEREST / 100.0);
 
-company_handle_t company_found_company(const char *const name, float initial_loan) {
-    const company_handle_t company = num_companies++;
+/**
+ * @brief Slots of dissolved companies, free to be reused.
+ */
+static size_t company_free[MAX_COMPANIES];
+
+/**
+ * @brief The number of items in company_free.
+ */
+static size_t num_company_free = 0;
+
+/**
+ * @brief The company each player is a chairman of, by PlayerNumber.
+ *
+ * Each item holds the slot of the company plus one, or 0 if the
+ * player chairs none.
+ */
+static unsigned short player_companies[MAX_PLAYERS];
+
+/**
+ * @brief The ledger of each company, as a ring of periods.
+ *
+ * The open period of every company is row company_ledger_periods
+ * modulo COMPANY_LEDGER_PERIODS.
+ */
+static struct company_ledger_row_t company_ledgers[MAX_COMPANIES][COMPANY_LEDGER_PERIODS];
+
+/**
+ * @brief The number of periods closed so far.
+ */
+static unsigned int company_ledger_periods = 0;
+
+/**
+ * @brief Hashes of the blocks of the company tables, as of the last snapshot.
+ */
+static unsigned int company_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(companies))];
+static unsigned int company_ledger_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(company_ledgers))];
+
+static const struct snapshot_region_t company_snapshot[] = {
+    SNAPSHOT_REGION(companies, company_snapshot_hashes),
+    SNAPSHOT_REGION(num_companies, NULL),
+    SNAPSHOT_REGION(company_free, NULL),
+    SNAPSHOT_REGION(num_company_free, NULL),
+    SNAPSHOT_REGION(player_companies, NULL),
+    SNAPSHOT_REGION(max_loan, NULL),
+    SNAPSHOT_REGION(loan_interest, NULL),
+    SNAPSHOT_REGION(company_ledgers, company_ledger_snapshot_hashes),
+    SNAPSHOT_REGION(company_ledger_periods, NULL)
+};
+
+static struct company_ledger_row_t *_company_ledger_row(size_t slot, unsigned int period) {
+    return &company_ledgers[slot][period % COMPANY_LEDGER_PERIODS];
+}
+
+/**
+ * @brief Gets the handle to the company in a slot, as of its current generation.
+ */
+static size_t _company_handle(size_t slot) {
+    return slot | (size_t) companies[slot].generation << COMPANY_SLOT_BITS;
+}
+
+int company_exists(company_handle_t company) {
+    const size_t slot = COMPANY_SLOT(company);
+
+    return slot < num_companies && companies[slot].active && _company_handle(slot) == company;
+}
 
-    strcpy(companies[company].name, name);
+company_handle_t company_found_company(const char *const name, econ_t initial_loan) {
+    size_t slot;
 
-    companies[company].balance = 0.0;
-    companies[company].debt = 0.0;
-    companies[company].num_chairmen = 0;
+    if (num_company_free > 0) {
+        slot = company_free[--num_company_free];
+    }
+
+    else if (num_companies < MAX_COMPANIES) {
+        slot = num_companies++;
+    }
+
+    else {
+        errorac(ERR_COMPANY_MAXED, -1, "company_found_company");
+    }
+
+    strcpy(companies[slot].name, name);
+
+    companies[slot].balance = 0;
+    companies[slot].debt = 0;
+    companies[slot].num_chairmen = 0;
+    companies[slot].active = 1;
+
+    memset(company_ledgers[slot], 0, sizeof(company_ledgers[slot]));
 
     if (initial_loan > 0) {
-        company_loan(company, initial_loan);
+        company_loan(_company_handle(slot), initial_loan);
     }
 
-    return company;
+    return _company_handle(slot);
 }
 
 static error_return_t _company_check_index(company_handle_t company) {
-    if (company >= num_companies) {
+    const size_t slot = COMPANY_SLOT(company);
+
+    if (slot >= num_companies) {
         errori(ERR_COMPANY_BAD_INDEX);
     }
 
+    if (!companies[slot].active || _company_handle(slot) != company) {
+        // a handle to a company since dissolved
+        errori(ERR_COMPANY_DISSOLVED);
+    }
+
     return 0;
 }
 
@@ -47,13 +139,30 @@ error_return_t company_add_chairman(company_handle_t company, unsigned int playe
 
     errcli(_company_check_index(company));
 
-    if (company_has_chairman(company, player_num) > 0) {
+    const size_t slot = COMPANY_SLOT(company);
+
+    if (player_num >= MAX_PLAYERS) {
+        errori(ERR_COMPANY_BAD_PLAYER);
+    }
+
+    if (player_companies[player_num] == slot + 1) {
         errori(ERR_COMPANY_ALREADY_HAS_CHAIRMAN);
     }
 
-    index = companies[company].num_chairmen++;
+    if (player_companies[player_num] != 0) {
+        errori(ERR_COMPANY_PLAYER_HAS_COMPANY);
+    }
+
+    if (companies[slot].num_chairmen >= MAX_CHAIRMEN_PER_COMPANY) {
+        errori(ERR_COMPANY_CHAIRMEN_FULL);
+    }
+
+    index = companies[slot].num_chairmen++;
 
-    companies[company].chairmen[index] = player_num;
+    companies[slot].chairmen[index] = player_num;
+    player_companies[player_num] = slot + 1;
+
+    company_check_chairmen();
 
     return 0;
 }
@@ -63,42 +172,139 @@ error_return_t company_remove_chairman(company_handle_t company, unsigned int pl
 
     errcli(_company_check_index(company));
 
-    index = 0;
+    const size_t slot = COMPANY_SLOT(company);
 
-    while (companies[company].chairmen[index] != player_num && index < companies[company].num_chairmen) {
-        index++;
+    if (player_num >= MAX_PLAYERS) {
+        errori(ERR_COMPANY_BAD_PLAYER);
     }
 
-    if (index == companies[company].num_chairmen) {
+    if (player_companies[player_num] != slot + 1) {
         // chairman not found
         errori(ERR_COMPANY_ALREADY_HAS_NOT_CHAIRMAN);
     }
 
-    while (index < companies[company].num_chairmen) {
-        if (index < MAX_CHAIRMEN_PER_COMPANY) {
-            companies[company].chairmen[index] = companies[company].chairmen[index + 1];
-        }
+    index = 0;
+
+    while (index < companies[slot].num_chairmen && companies[slot].chairmen[index] != player_num) {
+        index++;
+    }
+
+    // close the gap
+    companies[slot].num_chairmen--;
 
+    while (index < companies[slot].num_chairmen) {
+        companies[slot].chairmen[index] = companies[slot].chairmen[index + 1];
         index++;
     }
 
+    player_companies[player_num] = 0;
+
+    company_check_chairmen();
+
     return 0;
 }
 
 error_return_t company_has_chairman(company_handle_t company, unsigned int player_num) {
     errcli(_company_check_index(company));
 
-    for (int index = 0; index < companies[company].num_chairmen; index++) {
-        if (companies[company].chairmen[index] == player_num) {
-            return 1;
+    if (player_num >= MAX_PLAYERS) {
+        errori(ERR_COMPANY_BAD_PLAYER);
+    }
+
+    return player_companies[player_num] == COMPANY_SLOT(company) + 1;
+}
+
+size_t company_of_chairman(unsigned int player_num) {
+    if (player_num >= MAX_PLAYERS) {
+        errorac(ERR_COMPANY_BAD_PLAYER, -1, "company_of_chairman");
+    }
+
+    if (player_companies[player_num] == 0) {
+        return -1;
+    }
+
+    return _company_handle(player_companies[player_num] - 1);
+}
+
+#ifdef DEBUG
+
+void company_check_chairmen(void) {
+    size_t slot;
+    unsigned int player_num, index;
+
+    for (slot = 0; slot < num_companies; slot++) {
+        if (!companies[slot].active) {
+            continue;
+        }
+
+        if (companies[slot].num_chairmen > MAX_CHAIRMEN_PER_COMPANY) {
+            _error_c(ERR_COMPANY_CHAIRMEN_MISMATCH, "company_check_chairmen (chairmen count)");
+            continue;
+        }
+
+        for (index = 0; index < companies[slot].num_chairmen; index++) {
+            player_num = companies[slot].chairmen[index];
+
+            if (player_num >= MAX_PLAYERS || player_companies[player_num] != slot + 1) {
+                _error_c(ERR_COMPANY_CHAIRMEN_MISMATCH, "company_check_chairmen (chairman without index)");
+            }
         }
     }
 
-    return 0;
+    for (player_num = 0; player_num < MAX_PLAYERS; player_num++) {
+        if (player_companies[player_num] == 0) {
+            continue;
+        }
+
+        slot = player_companies[player_num] - 1;
+
+        if (slot >= num_companies || !companies[slot].active) {
+            _error_c(ERR_COMPANY_CHAIRMEN_MISMATCH, "company_check_chairmen (index to no company)");
+            continue;
+        }
+
+        for (index = 0; index < companies[slot].num_chairmen && companies[slot].chairmen[index] != player_num; index++);
+
+        if (index == companies[slot].num_chairmen) {
+            _error_c(ERR_COMPANY_CHAIRMEN_MISMATCH, "company_check_chairmen (index without chairman)");
+        }
+    }
+}
+
+#endif // DEBUG
+
+/**
+ * @brief Dissolves the company in a slot, removing its assets and freeing the slot.
+ */
+static void _company_dissolve(size_t slot) {
+    const size_t company = _company_handle(slot);
+
+    int index;
+
+    vehicle_remove_owned(company);
+    station_remove_owned(company);
+
+    for (index = 0; index < companies[slot].num_chairmen; index++) {
+        player_companies[companies[slot].chairmen[index]] = 0;
+    }
+
+    companies[slot].active = 0;
+    companies[slot].num_chairmen = 0;
+
+    // every handle to it goes stale
+    companies[slot].generation++;
+
+    company_free[num_company_free++] = slot;
+
+    company_check_chairmen();
 }
 
-static void _company_dissolve(company_handle_t company) {
-    // TODO: add code for dissolving company
+error_return_t company_dissolve(company_handle_t company) {
+    errcli(_company_check_index(company));
+
+    _company_dissolve(COMPANY_SLOT(company));
+
+    return 0;
 }
 
 /**
@@ -109,48 +315,126 @@ static void _company_dissolve(company_handle_t company) {
  * negative of max_loan, this company is not financially healthy; then
  * destitute it and dissolve its assets.
  */
-static void _company_check_healthy(company_handle_t company) {
-    if (companies[company].balance - companies[company].debt < -max_loan) {
-        _company_dissolve(company);
+static void _company_check_healthy(size_t slot) {
+    if (companies[slot].balance - companies[slot].debt < -max_loan) {
+        _company_dissolve(slot);
     }
 }
 
-static void _company_charge_interest(company_handle_t company) {
-    if (companies[company].debt > 0) {
-        company_add_to_balance(company, -companies[company].debt * DEFAULT_LOAN_INTEREST);
+static void _company_post(size_t slot, enum ledger_category_t category, econ_t amount) {
+    struct company_ledger_row_t *const row = _company_ledger_row(slot, company_ledger_periods);
+    const econ_t before = companies[slot].balance;
+
+    companies[slot].balance = econ_add(before, amount);
+    row->amounts[category] = econ_add(row->amounts[category], amount);
+
+    replay_record(REPLAY_COMPANY_BALANCE, _company_handle(slot), category, 0, 0, amount, before, companies[slot].balance);
+}
+
+/**
+ * @brief Values a company, from its balance sheet and the profits in its ledger.
+ */
+static econ_t _company_value(size_t slot) {
+    const unsigned int num_closed = company_ledger_periods < COMPANY_LEDGER_PERIODS ? company_ledger_periods + 1 : COMPANY_LEDGER_PERIODS;
+
+    econ_t profit = 0;
+    unsigned int period, category;
+
+    // the period being closed counts too
+    for (period = 0; period < num_closed; period++) {
+        const struct company_ledger_row_t *const row = _company_ledger_row(slot, company_ledger_periods - period);
+
+        for (category = 0; category < NUM_LEDGER_CATEGORIES; category++) {
+            profit = econ_add(profit, row->amounts[category]);
+        }
     }
+
+    profit /= (int) num_closed;
+
+    if (profit < 0) {
+        profit = 0;
+    }
+
+    return econ_add(companies[slot].balance - companies[slot].debt, econ_mul(profit, econ_from_int(COMPANY_VALUE_PERIODS)));
 }
 
-error_return_t company_add_to_balance(company_handle_t company, float amount) {
+error_return_t company_add_to_balance(company_handle_t company, econ_t amount) {
     errcli(_company_check_index(company));
 
-    companies[company].balance += amount;
+    _company_post(COMPANY_SLOT(company), amount < 0 ? LEDGER_OTHER_EXPENSES : LEDGER_OTHER_INCOME, amount);
+
+    return 0;
+}
+
+error_return_t company_post(company_handle_t company, enum ledger_category_t category, econ_t amount) {
+    errcli(_company_check_index(company));
 
-    if (amount < 0) {
-        _company_check_healthy(company);
+    if ((unsigned int) category >= NUM_LEDGER_CATEGORIES) {
+        errori(ERR_COMPANY_BAD_LEDGER_CATEGORY);
     }
 
+    _company_post(COMPANY_SLOT(company), category, amount);
+
     return 0;
 }
 
-error_return_t company_loan(company_handle_t company, float amount) {
+error_return_t company_get_ledger(company_handle_t company, size_t periods_ago, struct company_ledger_row_t *row) {
     errcli(_company_check_index(company));
 
+    if (periods_ago >= COMPANY_LEDGER_PERIODS || periods_ago > company_ledger_periods) {
+        codei(ERR_COMPANY_BAD_LEDGER_PERIOD);
+    }
+
+    *row = *_company_ledger_row(COMPANY_SLOT(company), company_ledger_periods - periods_ago);
+
+    return 0;
+}
+
+void company_end_period(void) {
+    size_t slot;
+
+    for (slot = 0; slot < num_companies; slot++) {
+        if (!companies[slot].active) {
+            continue;
+        }
+
+        if (companies[slot].debt > 0) {
+            _company_post(slot, LEDGER_INTEREST, -econ_mul(companies[slot].debt, loan_interest));
+        }
+
+        _company_ledger_row(slot, company_ledger_periods)->value = _company_value(slot);
+        _company_check_healthy(slot);
+
+        // the next period's row still holds the oldest one
+        memset(_company_ledger_row(slot, company_ledger_periods + 1), 0, sizeof(struct company_ledger_row_t));
+    }
+
+    company_ledger_periods++;
+}
+
+error_return_t company_loan(company_handle_t company, econ_t amount) {
+    const econ_t asked = amount;
+
+    errcli(_company_check_index(company));
+
+    const size_t slot = COMPANY_SLOT(company);
+    const econ_t before = companies[slot].debt;
+
     if (amount > 0) {
         // offset to fit within max_loan
-        if (companies[company].debt + amount > max_loan) {
-            amount = max_loan - companies[company].debt;
+        if (companies[slot].debt + amount > max_loan) {
+            amount = max_loan - companies[slot].debt;
         }
 
-        if (amount == 0.0) {
+        if (amount == 0) {
             // amount cannot be loaned
             // (debt is already at max_loan)
             codei(ERR_COMPANY_LOAN_MAXED_OUT);
         }
 
         // add to balance, but also debt
-        companies[company].balance += amount;
-        companies[company].debt += amount;
+        companies[slot].balance += amount;
+        companies[slot].debt += amount;
     }
 
     else if (amount < 0) {
@@ -159,19 +443,27 @@ error_return_t company_loan(company_handle_t company, float amount) {
         amount = -amount;
 
         // try to pay back
-        if (amount > companies[company].debt) {
-            amount = companies[company].debt;
+        if (amount > companies[slot].debt) {
+            amount = companies[slot].debt;
         }
 
-        if (amount > companies[company].balance) {
+        if (amount > companies[slot].balance) {
             // not within balance
             codei(ERR_COMPANY_LOAN_PAYBACK_EXCEED_BALANCE);
         }
 
         // withdraw from debt, but also balance
-        companies[company].debt -= amount;
-        companies[company].balance -= amount;
+        companies[slot].debt -= amount;
+        companies[slot].balance -= amount;
     }
 
+    replay_record(REPLAY_COMPANY_LOAN, company, 0, 0, 0, asked, before, companies[slot].debt);
+
     return 0;
 }
+
+const struct snapshot_region_t *company_snapshot_regions(size_t *num_regions) {
+    *num_regions = sizeof(company_snapshot) / sizeof(*company_snapshot);
+
+    return company_snapshot;
+}
@@ -14,6 +14,9 @@
 #include <stddef.h>
 
 #include "m_error.h"
+#include "m_fixed.h"
+#include "m_profile.h"
+#include "m_snapshot.h"
 
 
 /**
@@ -21,10 +24,40 @@
  */
 #define MAX_CHAIRMEN_PER_COMPANY 8
 
+/**
+ * @brief The number of players in a game, as in ZDoom's MAXPLAYERS.
+ *
+ * Only PlayerNumbers below this can be chairmen.
+ */
+#ifndef MAX_PLAYERS
+#define MAX_PLAYERS 8
+#endif
+
 /**
  * @brief The maximum number of companies that can populate the world.
  */
+#ifndef MAX_COMPANIES
 #define MAX_COMPANIES 64
+#endif
+
+/**
+ * @brief The number of low bits of a company handle that hold its slot.
+ *
+ * The bits above hold the generation of the slot, which counts up
+ * every time a company in it is dissolved, so that a handle to a
+ * dissolved company is never taken for the one founded in its slot
+ * later on.
+ */
+#define COMPANY_SLOT_BITS 8
+
+#if MAX_COMPANIES > (1 << COMPANY_SLOT_BITS)
+#error MAX_COMPANIES does not fit in COMPANY_SLOT_BITS
+#endif
+
+/**
+ * @brief Gets the slot of the companies table a company handle refers to.
+ */
+#define COMPANY_SLOT(company) ((company) & ((1u << COMPANY_SLOT_BITS) - 1))
 
 /**
  * @brief The initial maximum amount that can be owed to the bank.
@@ -33,9 +66,72 @@
 
 /**
  * @brief The initial interest rate of loans taken from the bank.
+ *
+ * In percent of the debt, charged at the end of every economy period.
  */
 #define DEFAULT_LOAN_INTEREST 5
 
+/**
+ * @brief The number of periods kept in each company's ledger.
+ *
+ * The period still open included.
+ */
+#define COMPANY_LEDGER_PERIODS 8
+
+/**
+ * @brief How many periods of profit a company is valued at, besides its net assets.
+ */
+#define COMPANY_VALUE_PERIODS 4
+
+/**
+ * @brief A category of a company's income and expenses.
+ */
+enum ledger_category_t {
+    /**
+     * @brief Payment for cargo delivered.
+     */
+    LEDGER_CARGO_INCOME,
+
+    /**
+     * @brief Any other money coming in.
+     */
+    LEDGER_OTHER_INCOME,
+
+    /**
+     * @brief Interest charged on debt.
+     */
+    LEDGER_INTEREST,
+
+    /**
+     * @brief Any other money going out.
+     */
+    LEDGER_OTHER_EXPENSES,
+
+    NUM_LEDGER_CATEGORIES
+};
+
+/**
+ * @brief A period of a company's ledger.
+ */
+struct company_ledger_row_t {
+    /**
+     * @brief The amount posted to each category during the period.
+     *
+     * Income is positive and expenses negative, so that the profit of
+     * the period is the sum of all of them.
+     */
+    econ_t amounts[NUM_LEDGER_CATEGORIES];
+
+    /**
+     * @brief The value of the company, as of the end of the period.
+     *
+     * The balance, minus the debt, plus COMPANY_VALUE_PERIODS times
+     * the average profit of the periods in the ledger, if there was
+     * any. 0 while the period is still open.
+     */
+    econ_t value;
+};
+
 
 /**
  * @brief A company.
@@ -52,7 +148,7 @@ struct company_t {
      * What gold there is available to be immediately spent
      * (i.e. liquid assets).
      */
-    float balance;
+    econ_t balance;
 
     /**
      * @brief How much this company owes to the bank.
@@ -60,7 +156,7 @@ struct company_t {
      * Debt is the amount of money in loans a company has taken out and
      * not yet paid back.
      */
-    float debt;
+    econ_t debt;
 
     /**
      * @brief The list of managing players.
@@ -80,35 +176,85 @@ struct company_t {
      * The number, between 0 and 8, of players managing this company.
      */
     unsigned char num_chairmen;
+
+    /**
+     * @brief The generation of this company's slot.
+     *
+     * The number of companies dissolved in this slot so far.
+     *
+     * @see COMPANY_SLOT_BITS
+     */
+    unsigned int generation;
+
+    /**
+     * @brief Whether this company exists.
+     *
+     * Dissolved companies leave their slot behind, to be reused by the
+     * next company founded.
+     */
+    unsigned char active;
 };
 
 /**
- * @brief Count of all companies currently in the game.
+ * @brief The number of company slots in use, including dissolved ones.
  */
 extern size_t num_companies;
 
 /**
  * @brief The maximum loan that can be taken out by a company.
  */
-extern float max_loan;
+extern econ_t max_loan;
 
 /**
- * @brief An index to a company.
+ * @brief The interest rate of loans, as a fraction of the debt charged every period.
+ */
+extern econ_t loan_interest;
+
+/**
+ * @brief A handle to a company: its slot, tagged with the slot's generation.
+ *
+ * @see COMPANY_SLOT_BITS
  */
 typedef const size_t company_handle_t;
 
+/**
+ * @brief Checks whether a company exists.
+ *
+ * @param company The company handle to check.
+ * @return int 1 if a company exists with this handle, else 0.
+ */
+int company_exists(company_handle_t company);
+
 /**
  * @brief Founds a new company.
  *
+ * The slot of a dissolved company is reused, if there is any.
+ *
  * @param name The name of the new company, as a string.
  * @param initial_loan An initial loan to be taken out, up to max_loan.
- * @return company_handle_t The handle to the new company created.
+ * @return company_handle_t The handle to the new company created, or -1 on error.
+ */
+company_handle_t company_found_company(const char *const name, econ_t initial_loan);
+
+/**
+ * @brief Dissolves a company, along with all its assets.
+ *
+ * Every station and vehicle the company owns is removed, and its slot
+ * is freed for the next company founded. Any handle to the company is
+ * stale from then on, and refused by every company function.
+ *
+ * Companies that go broke are dissolved at the end of the period (see
+ * company_end_period).
+ *
+ * @param company The company to dissolve.
  */
-company_handle_t company_found_company(const char *const name, float initial_loan);
+error_return_t company_dissolve(company_handle_t company);
 
 /**
  * @brief Adds a player as a chairman of a company.
  *
+ * A player can only chair one company at a time.
+ *
  * @param company The company to add the chairman to.
  * @param player_num The player number to add as a chairman.
  */
@@ -131,11 +277,37 @@ error_return_t company_remove_chairman(company_handle_t company, unsigned int pl
  */
 error_return_t company_has_chairman(company_handle_t company, unsigned int player_num);
 
+/**
+ * @brief Gets the company a player is a chairman of.
+ *
+ * @param player_num The player number to look up.
+ * @return size_t The handle to the player's company, or -1 if they chair none.
+ */
+size_t company_of_chairman(unsigned int player_num);
+
+#ifdef DEBUG
+
+/**
+ * @brief Checks that the chairmen of every company agree with the company of every player.
+ *
+ * Logs an error for each disagreement found. Done after every change
+ * to chairmen in debug builds; in any other build, it compiles to
+ * nothing.
+ */
+void company_check_chairmen(void);
+
+#else
+
+#define company_check_chairmen() ((void) 0)
+
+#endif // DEBUG
+
 /**
  * @brief Adds to the balance of a company.
  *
  * Adds a certain amount to the liquid and immediately spendable
- * balance of a company, effective immediately.
+ * balance of a company, effective immediately. It is posted to the
+ * company's ledger as other income or expenses.
  *
  * Use a negative amount to withdraw an arbitrary amount of money
  * from the company.
@@ -143,7 +315,37 @@ error_return_t company_has_chairman(company_handle_t company, unsigned int playe
  * @param company The company to add the amount to.
  * @param amount The amount to add to the company's balance.
  */
-error_return_t company_add_to_balance(company_handle_t company, float amount);
+error_return_t company_add_to_balance(company_handle_t company, econ_t amount);
+
+/**
+ * @brief Adds to the balance of a company, under a category of its ledger.
+ *
+ * A company going broke is only found out at the end of the period
+ * (see company_end_period), however much it spends in the meantime.
+ *
+ * @param company The company to add the amount to.
+ * @param category The category to post the amount to.
+ * @param amount The amount to add, negative for expenses.
+ */
+error_return_t company_post(company_handle_t company, enum ledger_category_t category, econ_t amount);
+
+/**
+ * @brief Gets a period of a company's ledger.
+ *
+ * @param company The company whose ledger to read.
+ * @param periods_ago 0 for the period still open, 1 for the last one closed, and so on.
+ * @param row Where to store the period.
+ */
+error_return_t company_get_ledger(company_handle_t company, size_t periods_ago, struct company_ledger_row_t *row);
+
+/**
+ * @brief Closes the books of every company, at the end of an economy period.
+ *
+ * In a single pass over all companies: charges interest on debt,
+ * values each company, dissolves those that went broke, and opens
+ * the next period of their ledgers.
+ */
+void company_end_period(void);
 
 /**
  * @brief Loans to the balance of a company.
@@ -164,7 +366,15 @@ error_return_t company_add_to_balance(company_handle_t company, float amount);
  * @param company The company to loan to or pay back from.
  * @param amount The amount to be loaned, or if negative, to be paid back.
  */
-error_return_t company_loan(company_handle_t company, float amount);
+error_return_t company_loan(company_handle_t company, econ_t amount);
+
+/**
+ * @brief Gets the company tables, as snapshot regions.
+ *
+ * @param num_regions Where to store the number of regions.
+ * @return const struct snapshot_region_t* The regions, in a fixed order.
+ */
+const struct snapshot_region_t *company_snapshot_regions(size_t *num_regions);
 
 
 #endif // COMPANY_H
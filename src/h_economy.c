@@ -0,0 +1,271 @@
+/**
+ * @file h_economy.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Economy period scheduling logic.
+ * @version added in 0.1
+ * @date 2021-03-14
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ */
+
+#include "h_economy.h"
+#include "h_company.h"
+#include "h_industry.h"
+#include "h_route.h"
+#include "h_station.h"
+#include "h_vehicle.h"
+#include "i_place.h"
+#include "m_replay.h"
+
+
+int economy_periods = 0;
+
+/**
+ * @brief How many tics have passed in the current period.
+ */
+static int economy_tics = 0;
+
+/**
+ * @brief How many tics have passed since cargo last aged.
+ */
+static int economy_age_tics = 0;
+
+/**
+ * @brief The next industry to be updated by the running pass.
+ *
+ * Negative if no pass is running.
+ */
+static int economy_cursor = -1;
+
+/**
+ * @brief The tic the world was saved at, as of the snapshot it is in.
+ *
+ * Vehicle schedules are in tics of the level they were saved in; once
+ * restored, they are pushed back by as many tics as have passed since.
+ */
+static int economy_saved_tic = 0;
+
+/**
+ * @brief What a snapshot pass is for.
+ */
+enum economy_snapshot_pass_t {
+    ECONOMY_SNAPSHOT_NONE,
+    ECONOMY_SNAPSHOT_SAVE,
+    ECONOMY_SNAPSHOT_RESTORE
+};
+
+/**
+ * @brief What the running snapshot pass is for.
+ */
+static enum economy_snapshot_pass_t economy_snapshot_pass = ECONOMY_SNAPSHOT_NONE;
+
+/**
+ * @brief The tic the running snapshot pass began at, and vehicles were held at.
+ */
+static int economy_snapshot_tic;
+
+int economy_slice_industries = ECONOMY_SLICE_INDUSTRIES;
+
+int economy_slice_blocks = ECONOMY_SLICE_BLOCKS;
+
+int economy_autosave_periods = ECONOMY_AUTOSAVE_PERIODS;
+
+static const struct snapshot_region_t economy_snapshot[] = {
+    SNAPSHOT_REGION(economy_periods, NULL),
+    SNAPSHOT_REGION(economy_tics, NULL),
+    SNAPSHOT_REGION(economy_age_tics, NULL),
+    SNAPSHOT_REGION(economy_cursor, NULL),
+    SNAPSHOT_REGION(economy_saved_tic, NULL)
+};
+
+/**
+ * @brief Gets the regions of every module that snapshots cover.
+ *
+ * @return size_t The number of regions.
+ */
+static size_t _economy_snapshot_regions(struct snapshot_region_t *regions) {
+    const struct snapshot_region_t *(*const modules[])(size_t *) = {
+        industry_snapshot_regions,
+        station_snapshot_regions,
+        company_snapshot_regions,
+        vehicle_snapshot_regions,
+        route_snapshot_regions,
+        spot_snapshot_regions
+    };
+
+    const struct snapshot_region_t *module_regions;
+    size_t num_regions = 0, num_module_regions, i, j;
+
+    for (i = 0; i < sizeof(modules) / sizeof(*modules); i++) {
+        module_regions = modules[i](&num_module_regions);
+
+        for (j = 0; j < num_module_regions; j++) {
+            regions[num_regions++] = module_regions[j];
+        }
+    }
+
+    for (j = 0; j < sizeof(economy_snapshot) / sizeof(*economy_snapshot); j++) {
+        regions[num_regions++] = economy_snapshot[j];
+    }
+
+    return num_regions;
+}
+
+
+/**
+ * @brief Updates the next slice of industries in the running pass.
+ */
+static void _economy_pass_slice(void) {
+    int end = economy_cursor + economy_slice_industries;
+
+    if (end > num_industries) {
+        end = num_industries;
+    }
+
+    industry_end_period_range(economy_cursor, end);
+    economy_cursor = end;
+
+    if (economy_cursor >= num_industries) {
+        economy_cursor = -1;
+        economy_periods++;
+
+        company_end_period();
+
+        // a pass of its own, written over the next few tics
+        if (economy_autosave_periods > 0 && economy_periods % economy_autosave_periods == 0) {
+            economy_save_begin(snapshot_sequence() > ECONOMY_AUTOSAVE_DELTAS ? SNAPSHOT_FULL : SNAPSHOT_DELTA);
+        }
+    }
+}
+
+/**
+ * @brief Carries on with the running snapshot pass, and wraps it up once it is done.
+ *
+ * @param max_blocks How many blocks to work on at most.
+ * @return error_return_t 0 while the pass goes on, else what snapshot_step came to.
+ */
+static error_return_t _economy_snapshot_slice(size_t max_blocks) {
+    const error_return_t res = snapshot_step(max_blocks);
+    const enum economy_snapshot_pass_t pass = economy_snapshot_pass;
+
+    if (res == 0) {
+        return 0;
+    }
+
+    economy_snapshot_pass = ECONOMY_SNAPSHOT_NONE;
+
+    if (res < 0 || pass == ECONOMY_SNAPSHOT_SAVE) {
+        vehicle_release(economy_snapshot_tic);
+    }
+
+    else {
+        vehicle_release(economy_saved_tic);
+
+        // the trees were worked out from links that are gone now
+        route_forget_trees();
+    }
+
+    if (res > 0 && pass == ECONOMY_SNAPSHOT_SAVE) {
+        // replays start from the last snapshot written (see m_replay.h)
+        replay_record(REPLAY_SNAPSHOT, (int) snapshot_sequence(), 0, 0, 0, 0, 0, 0);
+    }
+
+    return res;
+}
+
+void economy_tick(void) {
+    COUNT(COUNTER_ECONOMY_TICK);
+
+    // the world holds still while it is saved or restored, so that it is all of a single tic
+    if (economy_snapshot_pass != ECONOMY_SNAPSHOT_NONE) {
+        _economy_snapshot_slice(economy_slice_blocks);
+        return;
+    }
+
+    if (++economy_age_tics >= CARGO_AGE_BUCKET_TICS) {
+        economy_age_tics = 0;
+        station_age_cargo();
+        vehicle_age_cargo();
+    }
+
+    vehicle_tick_all();
+    route_tick();
+
+    if (++economy_tics >= ECONOMY_PERIOD_TICS) {
+        economy_tics = 0;
+        counter_end_period();
+
+        // a pass that is somehow still running just carries on
+        if (economy_cursor < 0) {
+            economy_cursor = 0;
+        }
+    }
+
+    if (economy_cursor >= 0) {
+        _economy_pass_slice();
+    }
+}
+
+int economy_pass_running(void) {
+    return economy_cursor >= 0;
+}
+
+int economy_snapshot_running(void) {
+    return economy_snapshot_pass != ECONOMY_SNAPSHOT_NONE;
+}
+
+error_return_t economy_save_begin(enum snapshot_kind_t kind) {
+    struct snapshot_region_t regions[MAX_SNAPSHOT_REGIONS];
+
+    errcli(snapshot_write_begin(regions, _economy_snapshot_regions(regions), kind));
+
+    // only the header is written yet, so this still makes it into the snapshot
+    economy_snapshot_tic = economy_saved_tic = acs_timer();
+    economy_snapshot_pass = ECONOMY_SNAPSHOT_SAVE;
+    vehicle_hold();
+
+    return 0;
+}
+
+error_return_t economy_restore_begin(void) {
+    struct snapshot_region_t regions[MAX_SNAPSHOT_REGIONS];
+
+    errcli(snapshot_restore_begin(regions, _economy_snapshot_regions(regions)));
+
+    economy_snapshot_tic = acs_timer();
+    economy_snapshot_pass = ECONOMY_SNAPSHOT_RESTORE;
+    vehicle_hold();
+
+    return 0;
+}
+
+error_return_t economy_save(enum snapshot_kind_t kind) {
+    errcli(economy_save_begin(kind));
+
+    return _economy_snapshot_slice(SNAPSHOT_STEP_ALL);
+}
+
+error_return_t economy_restore(void) {
+    errcli(economy_restore_begin());
+
+    return _economy_snapshot_slice(SNAPSHOT_STEP_ALL);
+}
+
+/**
+ * @brief Runs the economy, for as long as the level lasts.
+ */
+ACS_OPEN_SCRIPT(economy_run) {
+    for (;;) {
+        economy_tick();
+        acs_delay(1);
+    }
+}
+
+/**
+ * @brief Restores the world from the persistent store, e.g. for a player joining late.
+ *
+ * The restore is carried on by economy_run, over the next few tics.
+ */
+ACS_NAMED_SCRIPT(economy_load) {
+    economy_restore_begin();
+}
@@ -0,0 +1,177 @@
+/**
+ * @file h_economy.h
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Economy periods and their scheduling.
+ * @version added in 0.1
+ * @date 2021-03-14
+ *
+ * The economy advances in periods. Over a period, industries merely
+ * accumulate whatever cargo is delivered to them; once the period
+ * ends, every industry converts its material into production in a
+ * single pass.
+ *
+ * That pass is spread over several tics, a fixed number of industries
+ * at a time, so that no single tic runs over the ACS VM's instruction
+ * budget, no matter how many industries there are.
+ *
+ * The economy also moves all vehicles and works on outdated routes
+ * every tic, and ages all cargo, in stations and vehicles alike, once
+ * every CARGO_AGE_BUCKET_TICS tics.
+ *
+ * Every economy_autosave_periods periods, once the end-of-period pass
+ * is done, the economy also autosaves a snapshot of the world (see
+ * m_snapshot.h): mostly deltas, which only hold what changed since the
+ * previous autosave, and a full snapshot every so often, so that the
+ * chain of deltas to restore never grows too long.
+ *
+ * Autosaves and restores are passes of their own, spread over several
+ * tics like the end-of-period pass, economy_slice_blocks snapshot
+ * blocks at a time. While one is running, the rest of the economy is
+ * paused, and vehicles are held where they are (see vehicle_hold), so
+ * that the snapshot is of a single tic; other scripts should leave the
+ * world alone meanwhile too (see economy_snapshot_running).
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ */
+
+#ifndef ECONOMY_H
+#define ECONOMY_H
+
+#include "m_acs.h"
+#include "m_error.h"
+#include "m_snapshot.h"
+
+
+/**
+ * @brief The length of an economy period, in tics.
+ */
+#define ECONOMY_PERIOD_TICS (30 * TICRATE)
+
+/**
+ * @brief How many industries the end-of-period pass updates per tic, unless set otherwise.
+ */
+#define ECONOMY_SLICE_INDUSTRIES 8
+
+/**
+ * @brief How many snapshot blocks an autosave or a restore works on per tic, unless set otherwise.
+ */
+#define ECONOMY_SLICE_BLOCKS 32
+
+/**
+ * @brief How many periods pass between autosaves, unless set otherwise.
+ */
+#ifndef ECONOMY_AUTOSAVE_PERIODS
+#define ECONOMY_AUTOSAVE_PERIODS 4
+#endif
+
+/**
+ * @brief How many delta autosaves follow each full one.
+ */
+#define ECONOMY_AUTOSAVE_DELTAS 15
+
+
+/**
+ * @brief The number of economy periods fully processed so far.
+ */
+extern int economy_periods;
+
+/**
+ * @brief How many industries the end-of-period pass updates per tic.
+ *
+ * ECONOMY_SLICE_INDUSTRIES unless set otherwise. Offline simulation,
+ * which has no per-tic budget to keep to, may update many more at
+ * once, e.g. so that worker threads each get a sizeable share.
+ */
+extern int economy_slice_industries;
+
+/**
+ * @brief How many snapshot blocks an autosave or a restore works on per tic.
+ *
+ * ECONOMY_SLICE_BLOCKS unless set otherwise.
+ */
+extern int economy_slice_blocks;
+
+/**
+ * @brief How many periods pass between autosaves; 0 disables them.
+ *
+ * ECONOMY_AUTOSAVE_PERIODS unless set otherwise.
+ */
+extern int economy_autosave_periods;
+
+/**
+ * @brief Advances the economy by a single tic.
+ *
+ * Must be called exactly once per tic. When a period ends, this starts
+ * the end-of-period pass; while a pass is running, each call updates
+ * the next economy_slice_industries industries. Once they are all
+ * done, the books of every company are closed (see company_end_period),
+ * and an autosave is begun, if one is due. While the world is being
+ * saved or restored, each call only carries that on.
+ */
+void economy_tick(void);
+
+/**
+ * @brief Checks whether an end-of-period pass is still running.
+ *
+ * @return int 1 if some industries are yet to be updated, else 0.
+ */
+int economy_pass_running(void);
+
+/**
+ * @brief Checks whether the world is being saved or restored.
+ *
+ * @return int 1 if an autosave or a restore is still running, else 0.
+ */
+int economy_snapshot_running(void);
+
+/**
+ * @brief Begins saving a snapshot of the world into the persistent store.
+ *
+ * Covers all industries, stations, companies, vehicles and spots, the
+ * route links vehicles make up, the spotmap, and the economy's own
+ * schedule. The snapshot is written by economy_tick, over the next few
+ * tics. Once it is whole, the event log is marked (see m_replay.h), so
+ * that replays can start from the snapshot.
+ *
+ * @param kind Whether to write a full snapshot, or a delta over the previous one.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t economy_save_begin(enum snapshot_kind_t kind);
+
+/**
+ * @brief Begins restoring the world from the snapshots in the persistent store.
+ *
+ * The world is restored by economy_tick, over the next few tics. Route
+ * trees are not in snapshots, and are worked out again from the
+ * restored links once it is done; vehicle schedules are pushed back by
+ * however long it has been since the snapshot was saved.
+ *
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t economy_restore_begin(void);
+
+/**
+ * @brief Saves a snapshot of the world into the persistent store, in one go.
+ *
+ * Meant for offline simulation, which has no per-tic budget to keep to.
+ *
+ * @see economy_save_begin
+ *
+ * @param kind Whether to write a full snapshot, or a delta over the previous one.
+ * @return error_return_t The number of words written, or an error.
+ */
+error_return_t economy_save(enum snapshot_kind_t kind);
+
+/**
+ * @brief Restores the world from the snapshots in the persistent store, in one go.
+ *
+ * Meant for offline simulation, which has no per-tic budget to keep to.
+ *
+ * @see economy_restore_begin
+ *
+ * @return error_return_t The number of snapshots restored, or an error.
+ */
+error_return_t economy_restore(void);
+
+
+#endif // ECONOMY_H
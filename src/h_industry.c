@@ -11,225 +11,150 @@
  */
 
 #include "h_industry.h"
+#include "h_station.h"
+#include "i_place.h"
 #include "m_error.h"
+#include "m_replay.h"
 
+#ifdef INDUSTRY_THREADS
+#include "m_workers.h"
+#endif
+
+
+#ifdef INDUSTRY_SOA
+
+/**
+ * @brief All industries, stored one field per array.
+ *
+ * Besides the fields of industry_t, this holds a copy of the type
+ * parameters the production kernels need, and the kernels' outputs,
+ * so that a pass over a range of industries never has to look
+ * anything up by type. Passes are sliced, and split among workers, at
+ * any industry, so the kernels loop over exactly their own range and
+ * leave any partial vector at its ends to the compiler.
+ */
+static struct {
+    size_t type[MAX_INDUSTRIES];
+    econ_t material[MAX_INDUS_MATS][MAX_INDUSTRIES];
+    econ_t material_tot[MAX_INDUSTRIES];
+    float pos_x[MAX_INDUSTRIES];
+    float pos_y[MAX_INDUSTRIES];
+    size_t spot[MAX_INDUSTRIES];
+    econ_t produced[MAX_INDUS_MATS][MAX_INDUSTRIES];
+    econ_t transported[MAX_INDUS_MATS][MAX_INDUSTRIES];
+
+    // -- Type parameters; supply types are 1 or 0, to select without branching.
+    // Those and the counts are plain numbers, not fixed-point amounts, so that
+    // multiplying by them never needs econ_mul.
+
+    econ_t is_boost[MAX_INDUSTRIES];
+    econ_t is_convert[MAX_INDUSTRIES];
+    econ_t is_assemble[MAX_INDUSTRIES];
+    econ_t accepted[MAX_INDUS_MATS][MAX_INDUSTRIES];
+    econ_t num_accepts[MAX_INDUSTRIES];
+    econ_t base_production[MAX_INDUSTRIES];
+    econ_t boost_rate[MAX_INDUSTRIES];
+    econ_t boost_threshold[MAX_INDUSTRIES];
+
+    // -- Kernel outputs
+
+    econ_t boost_factor[MAX_INDUSTRIES];
+    econ_t production[MAX_INDUSTRIES];
+} industry_soa;
+
+#define INDUS_TYPE(ind)             (industry_soa.type[ind])
+#define INDUS_MATERIAL(ind, mat)    (industry_soa.material[mat][ind])
+#define INDUS_MATERIAL_TOT(ind)     (industry_soa.material_tot[ind])
+#define INDUS_POS_X(ind)            (industry_soa.pos_x[ind])
+#define INDUS_POS_Y(ind)            (industry_soa.pos_y[ind])
+#define INDUS_SPOT(ind)             (industry_soa.spot[ind])
+#define INDUS_PRODUCED(ind, mat)    (industry_soa.produced[mat][ind])
+#define INDUS_TRANSPORTED(ind, mat) (industry_soa.transported[mat][ind])
+
+#else
 
 static struct industry_t industries[MAX_INDUSTRIES];
+
+#define INDUS_TYPE(ind)             (industries[ind].type)
+#define INDUS_MATERIAL(ind, mat)    (industries[ind].material[mat])
+#define INDUS_MATERIAL_TOT(ind)     (industries[ind].material_tot)
+#define INDUS_POS_X(ind)            (industries[ind].pos_x)
+#define INDUS_POS_Y(ind)            (industries[ind].pos_y)
+#define INDUS_SPOT(ind)             (industries[ind].spot)
+#define INDUS_PRODUCED(ind, mat)    (industries[ind].produced[mat])
+#define INDUS_TRANSPORTED(ind, mat) (industries[ind].transported[mat])
+
+#endif // INDUSTRY_SOA
+
 int num_industries;
 
+enum industry_distribution_t industry_distribution = INDUSTRY_DISTRIBUTE_EVEN;
+
 /**
- * @brief All definitions of industry types in the game.
+ * @brief The catchment index of each industry, by industry handle.
  */
-const struct industry_type_t industry_types[MAX_INDUS_TYPES] = {
-    { // Flesh Exsanguiner
-        ISUPTYPE_CONVERT, // supply_type
-        "Flesh Exsanguiner", // label
-        "Seed_Industry_FleshExsanguiner", // spawner_type
-
-        0.0, // base_production
-        0.0, // boost_rate
-        0.0, // boost_threshold
-        512.0, // reach
-
-        // accept
-        1, { 0 /* Flesh */ },
-        { 1.0 },
-
-        // supply
-        1, { 5 /* Blood */ },
-        { 0.7, }
-    },
-
-    { // Hoof Smeltery
-        ISUPTYPE_CONVERT, // supply_type
-        "Hoof Smeltery", // label
-        "Seed_Industry_HoofSmeltery", // spawner_type
-
-        0.0, // base_production
-        2.5, // boost_rate
-        0.0, // boost_threshold
-        512.0, // reach
-
-        // accept
-        2, { 3 /* Hooves */, 10 /* Energy */ },
-        { 0.8, 2.0, 0, 0 },
-
-        // supply
-        2, { 7 /* Steel */, 5 /* Blood */ },
-        { 1.1, 0.15 }
-    },
-
-    { // Wart Fields
-        ISUPTYPE_BOOST, // supply_type
-        "Wart Fields", // label
-        "Seed_Industry_WartFields", // spawner_type
-
-        12.0, // base_production
-        3.0, // boost_rate
-        20.0, // boost_threshold
-        1200.0, // reach
-
-        // accept
-        1, { 9 /*Fertilizer */ },
-        { 1.0 },
-
-        // supply
-        1, { 4 /* Wart */ },
-        { 5.0 }
-    },
-
-    { // Neural Exciter
-        ISUPTYPE_CONVERT, // supply_type
-        "Neural Exciter", // label
-        "Seed_Industry_NeuralExciter", // spawner_type
-
-        0, // base_production
-        1.6, // boost_rate
-        0.0, // boost_threshold
-        600.0, // reach
-
-        // accept
-        2, { 2 /* Brains */, 6 /* Bottled Pain */ },
-        { 0.4, 1.2 },
-
-        // supply
-        1, { 11 /* Bottled Pride */ },
-        { 2.0 }
-    },
-
-    { // Bonesteel Refinery
-        ISUPTYPE_CONVERT, // supply_type
-        "Bonesteel Refinery", // label
-        "Seed_Industry_BonesteelRefinery", // spawner_type
-
-        0, // base_production
-        1.8, // boost_rate
-        0.0, // boost_threshold
-        700.0, // reach
-
-        // accept
-        2, { 7 /* Steel */, 1 /* Bones */ },
-        { 0.6, 0.4 },
-
-        // supply
-        1, { 8 /* Bonesteel */ },
-        { 0.3 }
-    },
-
-    { // Brewery
-        ISUPTYPE_CONVERT, // supply_type
-        "Brewery", // label
-        "Seed_Industry_Brewery", // spawner_type
-
-        0, // base_production
-        1.6, // boost_rate
-        0.0, // boost_threshold
-        512.0, // reach
-
-        // accept
-        3, { 11 /* Bottled Pride */, 4 /* Wart */, 0 /* Flesh */ },
-        { 1.2, 0.8, 0.3 },
-
-        // supply
-        2, { 9 /* Fertilizer */, 12  /* Hate Ale */ },
-        { 1.1, 0.4 }
-    },
-
-    { // Fermenting Pit
-        ISUPTYPE_CONVERT, // supply_type
-        "Fermenting Pit", // label
-        "Seed_Industry_FermentingPit", // spawner_type
-
-        0, // base_production
-        1.6, // boost_rate
-        0.0, // boost_threshold
-        768.0, // reach
-
-        // accept
-        3, { 6 /* Bottled Pain */, 5 /* Blood */, 0 /* Flesh */ },
-        { 1.1, 0.8, 0.3 },
-
-        // supply
-        2, { 9 /* Fertilizer */, 13 /* Gas */ },
-        { 3.0, 8.0 }
-    },
-
-    { // Gas Furnace
-        ISUPTYPE_CONVERT,
-        "Gas Furnace",
-        "Seed_Industry_GasFurnace",
-
-        0,
-        3.0,
-        0.0,
-        768.0,
-
-        1, { 13 /* Gas */ },
-        { 1.0 },
-
-        1, { 10 /* Energy */ },
-        { 0.2 }
-    },
-
-    { // Artisan Workshop
-        ISUPTYPE_CONVERT,
-        "Artisan Workshop",
-        "Seed_Industry_ArtisanWorkshop",
-
-        0,
-        2.5,
-        0.0,
-        512.0,
-
-        3, { 8 /* Bonesteel */, 12 /* Hate Ale */, 16 /* Microchips */ },
-        { 0.5, 1.8, 1.1 },
-
-        1, { 14 /* Goods */ },
-        { 1.5 }
-    },
-
-    { // Silicon Furnace
-        ISUPTYPE_ASSEMBLE,
-        "Silicon Furnace",
-        "Seed_Industry_SiliconFurnace",
-
-        0,
-        2.5,
-        0.0,
-        512.0,
-
-        2, { 1 /* Bonesteel */, 13 /* Gas */ },
-        { 0.5, 1.25 },
-
-        1, { 15 /* Silicon */ },
-        { 0.8 }
-    },
-
-    { // Semiconductor Factory
-        ISUPTYPE_CONVERT,
-        "Semiconductor Factory",
-        "Seed_Industry_SemiconductorFactory",
-
-        0,
-        2.5,
-        0.0,
-        768.0,
-
-        3, { 15 /* Silicon */, 2 /* Brains */, 10 /* Energy */ },
-        { 0.5, 1.0, 0.5 },
-
-        1, { 16 /* Microchips */ },
-        { 2.5 }
-    }
+static struct industry_catchment_t industry_catchments[MAX_INDUSTRIES];
+
+/**
+ * @brief Hashes of the blocks of the industry tables, as of the last snapshot.
+ */
+#ifdef INDUSTRY_SOA
+static unsigned int industry_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(industry_soa))];
+#else
+static unsigned int industry_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(industries))];
+#endif
+static unsigned int industry_catchment_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(industry_catchments))];
+
+#ifdef INDUSTRY_THREADS
+
+/**
+ * @brief The most shares of cargo a single industry can supply over a pass.
+ */
+#define INDUSTRY_MAX_SHARES (MAX_INDUS_MATS * MAX_CATCHMENT_STATIONS)
+
+/**
+ * @brief A share of supplied cargo, held back until it can be added to its station.
+ */
+struct industry_share_t {
+    station_handle_t station;
+    cargo_handle_t cargo_type;
+    econ_t amount;
 };
 
+/**
+ * @brief The shares each industry supplied in the running threaded pass, by industry handle.
+ */
+static struct industry_share_t industry_shares[MAX_INDUSTRIES][INDUSTRY_MAX_SHARES];
+static int industry_num_shares[MAX_INDUSTRIES];
+
+/**
+ * @brief Whether supplied cargo is being held back, as workers must not write to stations.
+ */
+static int industry_holding_shares = 0;
+
+/**
+ * @brief The industries of the running threaded pass.
+ */
+static industry_handle_t industry_pass_begin, industry_pass_end;
+
+#endif // INDUSTRY_THREADS
+
+static const struct snapshot_region_t industry_snapshot[] = {
+#ifdef INDUSTRY_SOA
+    SNAPSHOT_REGION(industry_soa, industry_snapshot_hashes),
+#else
+    SNAPSHOT_REGION(industries, industry_snapshot_hashes),
+#endif
+    SNAPSHOT_REGION(industry_catchments, industry_catchment_snapshot_hashes),
+    SNAPSHOT_REGION(num_industries, NULL)
+};
 
 static error_return_t _industry_check_index(industry_handle_t ind_industry, const char *const ctx) {
-    if (ind_industry >= num_industries || industries[ind_industry].type == -1) {
+    if (ind_industry >= num_industries || INDUS_TYPE(ind_industry) == -1) {
         erroric(ERR_INDUSTRY_BAD_INDEX, ctx);
     }
 
-    if (industry_types[industries[ind_industry].type].supply_type == ISUPTYPE_UNKNOWN) {
+    if (industry_types[INDUS_TYPE(ind_industry)].supply_type == ISUPTYPE_UNKNOWN) {
         erroric(ERR_INDUSTRY_BAD_TYPE, ctx);
     }
 
@@ -239,31 +164,315 @@ static error_return_t _industry_check_index(industry_handle_t ind_industry, cons
 static error_return_t _industry_check_index_and_accept(industry_handle_t ind_industry, size_t accept, const char *const ctx) {
     errcli(_industry_check_index(ind_industry, ctx));
 
-    if (accept >= industry_types[industries[ind_industry].type].num_accepts || industry_types[industries[ind_industry].type].accepts[accept] == -1) {
+    if (accept >= industry_types[INDUS_TYPE(ind_industry)].num_accepts) {
         erroric(ERR_INDUSTRY_BAD_ACCEPT, ctx);
     }
 
     return 0;
 }
 
-error_return_t industry_make_production(industry_handle_t ind_industry, float amount) {
-    errcli(_industry_check_index(ind_industry, "industry_check_production"));
+/**
+ * @brief Computes which supplied cargo types of an industry a station loads.
+ */
+static unsigned char _industry_supply_mask(const struct industry_type_t *const indtype, station_handle_t ind_station) {
+    unsigned char mask = 0;
+    int i;
 
-    struct industry_t *const indus = &industries[ind_industry];
-    const struct industry_type_t *const indtype = &industry_types[indus->type];
+    for (i = 0; i < indtype->num_supplies; i++) {
+        if (station_is_loading(ind_station, indtype->supplies[i])) {
+            mask |= 1 << i;
+        }
+    }
 
+    return mask;
+}
+
+/**
+ * @brief Recounts how many stations in a catchment load each supplied cargo type.
+ */
+static void _industry_catchment_recount(struct industry_catchment_t *const catchment) {
     int i;
-    size_t cargo_type;
-    float supply;
+    size_t j;
+
+    for (i = 0; i < MAX_INDUS_MATS; i++) {
+        catchment->num_loading[i] = 0;
+
+        for (j = 0; j < catchment->num_stations; j++) {
+            if (catchment->supply_masks[j] & (1 << i)) {
+                catchment->num_loading[i]++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Adds a station to an industry's catchment, if it is within reach.
+ */
+static error_return_t _industry_catchment_try_add(industry_handle_t ind_industry, station_handle_t ind_station, float x, float y) {
+    const struct industry_type_t *const indtype = &industry_types[INDUS_TYPE(ind_industry)];
+    struct industry_catchment_t *const catchment = &industry_catchments[ind_industry];
+
+    const float dx = x - INDUS_POS_X(ind_industry);
+    const float dy = y - INDUS_POS_Y(ind_industry);
+
+    if (dx * dx + dy * dy > indtype->reach * indtype->reach) {
+        // out of reach
+        return 0;
+    }
+
+    if (catchment->num_stations >= MAX_CATCHMENT_STATIONS) {
+        erroric(ERR_INDUSTRY_CATCHMENT_FULL, "industry_catchment_add_station");
+    }
+
+    catchment->stations[catchment->num_stations] = ind_station;
+    catchment->supply_masks[catchment->num_stations] = _industry_supply_mask(indtype, ind_station);
+    catchment->num_stations++;
+
+    _industry_catchment_recount(catchment);
+
+    return 1;
+}
+
+size_t industry_query_reach(float x, float y, industry_handle_t *out, size_t max) {
+    spot_handle_t covering[MAX_INDUSTRIES];
+    size_t num_covering, found = 0, i;
+
+    // industries cover every tile their reach overlaps
+    num_covering = spot_query_cover(x, y, SPOT_KIND_MASK(SPOT_KIND_INDUSTRY), covering, MAX_INDUSTRIES);
+
+    for (i = 0; i < num_covering && found < max; i++) {
+        const industry_handle_t ind_industry = spot_get(covering[i])->owner;
+        const float reach = industry_types[INDUS_TYPE(ind_industry)].reach;
+        const float dx = x - INDUS_POS_X(ind_industry);
+        const float dy = y - INDUS_POS_Y(ind_industry);
+
+        if (dx * dx + dy * dy <= reach * reach) {
+            out[found++] = ind_industry;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * @brief Finds the industries whose reach covers a station.
+ *
+ * @return size_t The number of industries stored in out.
+ */
+static size_t _industry_query_near_station(station_handle_t ind_station, industry_handle_t *out) {
+    float x, y;
+
+    if (station_get_position(ind_station, &x, &y) < 0) {
+        return 0;
+    }
 
-    for (i = 0; i < MAX_INDUS_MATS && indtype->supplies[i] != -1; i++) {
-        supply = amount * indtype->supply_weight[i];
-        cargo_type = indtype->supplies[i];
+    return industry_query_reach(x, y, out, MAX_INDUSTRIES);
+}
+
+void industry_catchment_add_station(station_handle_t ind_station) {
+    industry_handle_t near[MAX_INDUSTRIES];
+    size_t num_near, i;
+    float x, y;
+
+    errclv(station_get_position(ind_station, &x, &y));
+
+    num_near = _industry_query_near_station(ind_station, near);
+
+    for (i = 0; i < num_near; i++) {
+        _industry_catchment_try_add(near[i], ind_station, x, y);
+    }
+}
+
+void industry_catchment_remove_station(station_handle_t ind_station) {
+    industry_handle_t near[MAX_INDUSTRIES];
+    size_t num_near, i, j;
+
+    num_near = _industry_query_near_station(ind_station, near);
 
-        indus->produced[i] += supply;
+    for (i = 0; i < num_near; i++) {
+        struct industry_catchment_t *const catchment = &industry_catchments[near[i]];
 
-        // TODO: add actual cargo distribution code
+        for (j = 0; j < catchment->num_stations; j++) {
+            if (catchment->stations[j] == ind_station) {
+                break;
+            }
+        }
+
+        if (j == catchment->num_stations) {
+            continue;
+        }
+
+        // order does not matter; move the last entry into this one
+        catchment->num_stations--;
+        catchment->stations[j] = catchment->stations[catchment->num_stations];
+        catchment->supply_masks[j] = catchment->supply_masks[catchment->num_stations];
+
+        _industry_catchment_recount(catchment);
     }
+}
+
+void industry_catchment_update_station(station_handle_t ind_station) {
+    industry_handle_t near[MAX_INDUSTRIES];
+    size_t num_near, i, j;
+
+    num_near = _industry_query_near_station(ind_station, near);
+
+    for (i = 0; i < num_near; i++) {
+        const industry_handle_t ind_industry = near[i];
+        struct industry_catchment_t *const catchment = &industry_catchments[ind_industry];
+
+        for (j = 0; j < catchment->num_stations; j++) {
+            if (catchment->stations[j] == ind_station) {
+                catchment->supply_masks[j] = _industry_supply_mask(&industry_types[INDUS_TYPE(ind_industry)], ind_station);
+                _industry_catchment_recount(catchment);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Adds a share of an industry's supplied cargo into a station.
+ */
+static void _industry_add_share(industry_handle_t ind_industry, station_handle_t ind_station, cargo_handle_t cargo_type, econ_t amount) {
+#ifdef INDUSTRY_THREADS
+    if (industry_holding_shares) {
+        struct industry_share_t *const share = &industry_shares[ind_industry][industry_num_shares[ind_industry]++];
+
+        share->station = ind_station;
+        share->cargo_type = cargo_type;
+        share->amount = amount;
+
+        return;
+    }
+#endif
+
+    station_add_cargo(ind_station, cargo_type, -1, amount);
+}
+
+/**
+ * @brief Gets a station's pickup rate, to weigh its share of supplied cargo by.
+ */
+static error_return_t _industry_get_pickup_rate(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t *rate) {
+#ifdef INDUSTRY_THREADS
+    if (industry_holding_shares) {
+        // brought up to date later, as the shares are added
+        return station_peek_pickup_rate(ind_station, cargo_type, rate);
+    }
+#endif
+
+    return station_get_pickup_rate(ind_station, cargo_type, rate);
+}
+
+/**
+ * @brief Distributes cargo among the stations in a catchment, weighted by their pickup rates.
+ *
+ * The weights are kept on the stack, for at most MAX_CATCHMENT_STATIONS.
+ */
+static void _industry_distribute_by_demand(industry_handle_t ind_industry, const struct industry_catchment_t *const catchment, int ind_supply, cargo_handle_t cargo_type, econ_t supply) {
+    econ_t weights[MAX_CATCHMENT_STATIONS];
+    econ_t total = 0;
+    size_t j;
+
+    for (j = 0; j < catchment->num_stations; j++) {
+        if (!(catchment->supply_masks[j] & (1 << ind_supply))) {
+            continue;
+        }
+
+        if (_industry_get_pickup_rate(catchment->stations[j], cargo_type, &weights[j]) < 0) {
+            weights[j] = 0;
+        }
+
+        weights[j] += INDUSTRY_DEMAND_BASE;
+        total += weights[j];
+    }
+
+    for (j = 0; j < catchment->num_stations; j++) {
+        if (catchment->supply_masks[j] & (1 << ind_supply)) {
+            _industry_add_share(ind_industry, catchment->stations[j], cargo_type, econ_mul(supply, econ_div(weights[j], total)));
+        }
+    }
+}
+
+/**
+ * @brief Distributes one supplied cargo type into the stations in an industry's catchment.
+ *
+ * Called by the generated supply function of each industry type, once
+ * per supplied cargo type.
+ *
+ * @param ind_industry The industry supplying the cargo. Not checked.
+ * @param ind_supply Index of the supplied cargo in the industry's type.
+ * @param cargo_type The supplied cargo type.
+ * @param supply The amount of cargo supplied.
+ */
+static void _industry_supply(industry_handle_t ind_industry, int ind_supply, cargo_handle_t cargo_type, econ_t supply) {
+    const struct industry_catchment_t *const catchment = &industry_catchments[ind_industry];
+
+    size_t j;
+    econ_t share;
+
+    if (supply <= 0) {
+        return;
+    }
+
+    INDUS_PRODUCED(ind_industry, ind_supply) = econ_add(INDUS_PRODUCED(ind_industry, ind_supply), supply);
+
+    if (catchment->num_loading[ind_supply] == 0) {
+        // no station to move this cargo to
+        INDUS_TRANSPORTED(ind_industry, ind_supply) = econ_mul(INDUS_TRANSPORTED(ind_industry, ind_supply), econ_div(INDUS_PRODUCED(ind_industry, ind_supply) - supply, INDUS_PRODUCED(ind_industry, ind_supply)));
+        return;
+    }
+
+    if (industry_distribution == INDUSTRY_DISTRIBUTE_DEMAND) {
+        _industry_distribute_by_demand(ind_industry, catchment, ind_supply, cargo_type, supply);
+    }
+
+    else {
+        // distribute evenly among all stations loading this cargo type
+        share = supply / catchment->num_loading[ind_supply];
+
+        for (j = 0; j < catchment->num_stations; j++) {
+            if (catchment->supply_masks[j] & (1 << ind_supply)) {
+                _industry_add_share(ind_industry, catchment->stations[j], cargo_type, share);
+            }
+        }
+    }
+
+    // all of it was transported; weigh it into this period's ratio
+    INDUS_TRANSPORTED(ind_industry, ind_supply) += econ_mul(ECON_ONE - INDUS_TRANSPORTED(ind_industry, ind_supply), econ_div(supply, INDUS_PRODUCED(ind_industry, ind_supply)));
+}
+
+/**
+ * @brief The specialized production functions of an industry type.
+ *
+ * Generated for every industry type, along with industry_types, from
+ * data/industries.recipe by tools/gen_recipes.py. The accepted and
+ * supplied cargo types, weights and rates of the type are constants
+ * in them, so they never need to look anything up in industry_types.
+ */
+struct industry_recipe_t {
+    /**
+     * @brief Spends an industry's accumulated material into production.
+     *
+     * Takes boosting into account. Returns the production made, or a
+     * negative amount if the industry cannot produce in its current
+     * state (i.e. an assemble-type industry missing material).
+     */
+    econ_t (*produce)(industry_handle_t ind_industry);
+
+    /**
+     * @brief Distributes an amount of production as supplied cargo.
+     */
+    void (*supply)(industry_handle_t ind_industry, econ_t amount);
+};
+
+// the industry type table and recipes, generated at build time
+#include "../build/gen/industry_types.c"
+
+error_return_t industry_make_production(industry_handle_t ind_industry, econ_t amount) {
+    errcli(_industry_check_index(ind_industry, "industry_make_production"));
+
+    industry_recipes[INDUS_TYPE(ind_industry)].supply(ind_industry, amount);
 
     return 0;
 }
@@ -271,16 +480,15 @@ error_return_t industry_make_production(industry_handle_t ind_industry, float am
 unsigned char industry_is_boosted(industry_handle_t ind_industry) {
     errcla(_industry_check_index(ind_industry, "industry_check_production"), 0);
 
-    struct industry_t *const indus = &industries[ind_industry];
-    const struct industry_type_t *const indtype = &industry_types[indus->type];
+    const struct industry_type_t *const indtype = &industry_types[INDUS_TYPE(ind_industry)];
 
     int i;
 
     switch (indtype->supply_type) {
         case ISUPTYPE_CONVERT:
             // check if all cargo types are received
-            for (i = 0; i < MAX_INDUS_MATS && indtype->accepts[i] != -1; i++) {
-                if (indus->material[i] == 0) {
+            for (i = 0; i < indtype->num_accepts; i++) {
+                if (INDUS_MATERIAL(ind_industry, i) == 0) {
                     // this cargo type is not received
                     return 0;
                 }
@@ -289,7 +497,7 @@ unsigned char industry_is_boosted(industry_handle_t ind_industry) {
             return 1;
 
         case ISUPTYPE_BOOST:
-            return indus->material_tot >= indtype->boost_threshold;
+            return INDUS_MATERIAL_TOT(ind_industry) >= indtype->boost_threshold;
 
         default:
             break;
@@ -301,83 +509,409 @@ unsigned char industry_is_boosted(industry_handle_t ind_industry) {
 error_return_t industry_check_production(industry_handle_t ind_industry) {
     errcli(_industry_check_index(ind_industry, "industry_check_production"));
 
-    struct industry_t *const indus = &industries[ind_industry];
-    const struct industry_type_t *const indtype = &industry_types[indus->type];
+    COUNT(COUNTER_INDUSTRY_CHECK_PRODUCTION);
+
+    const struct industry_recipe_t *const recipe = &industry_recipes[INDUS_TYPE(ind_industry)];
+    const econ_t production = recipe->produce(ind_industry);
+
+    if (production < 0) {
+        // do not produce, missing material
+        codei(ERR_BAD_MATERIAL);
+    }
+
+    // apply production
+    recipe->supply(ind_industry, production);
+
+    return 0;
+}
+
+industry_handle_t industry_create(size_t ind_indus_type, float x, float y) {
+    if (ind_indus_type >= MAX_INDUS_TYPES || industry_types[ind_indus_type].supply_type == ISUPTYPE_UNKNOWN) {
+        errorac(ERR_INDUSTRY_BAD_TYPE, -1, "industry_create");
+    }
+
+    if (num_industries >= MAX_INDUSTRIES) {
+        errorac(ERR_INDUSTRY_MAXED, -1, "industry_create");
+    }
+
+    const industry_handle_t ind_industry = num_industries;
+    const struct industry_type_t *const indtype = &industry_types[ind_indus_type];
 
-    int boosted = 0;
+    spot_handle_t near[MAX_STATIONS];
+    size_t num_near, j;
     int i;
-    float production = 0.0;
-    float spent_mat = 0.0;
 
-    // check if industry is producing at all, and spend cargos
-    switch (indtype->supply_type) {
-        case ISUPTYPE_ASSEMBLE:
-            // produce only if all cargo types are received
-            for (i = 0; i < MAX_INDUS_MATS && indtype->accepts[i] != -1; i++) {
-                if (indus->material[i] == 0) {
-                    // do not produce, no material of this type
-                    erroric(ERR_BAD_MATERIAL, "industry_check_production");
-                }
+    INDUS_TYPE(ind_industry) = ind_indus_type;
+    INDUS_POS_X(ind_industry) = x;
+    INDUS_POS_Y(ind_industry) = y;
+    INDUS_MATERIAL_TOT(ind_industry) = 0;
 
-                if (spent_mat == 0.0 || spent_mat > indus->material[i]) {
-                    spent_mat = indus->material[i];
-                }
+    for (i = 0; i < MAX_INDUS_MATS; i++) {
+        INDUS_MATERIAL(ind_industry, i) = 0;
+        INDUS_PRODUCED(ind_industry, i) = 0;
+        INDUS_TRANSPORTED(ind_industry, i) = 0;
+    }
+
+#ifdef INDUSTRY_SOA
+    industry_soa.is_boost[ind_industry] = indtype->supply_type == ISUPTYPE_BOOST;
+    industry_soa.is_convert[ind_industry] = indtype->supply_type == ISUPTYPE_CONVERT;
+    industry_soa.is_assemble[ind_industry] = indtype->supply_type == ISUPTYPE_ASSEMBLE;
+    industry_soa.num_accepts[ind_industry] = indtype->num_accepts;
+    industry_soa.base_production[ind_industry] = indtype->base_production;
+    industry_soa.boost_rate[ind_industry] = indtype->boost_rate;
+    industry_soa.boost_threshold[ind_industry] = indtype->boost_threshold;
+
+    for (i = 0; i < MAX_INDUS_MATS; i++) {
+        industry_soa.accepted[i][ind_industry] = i < indtype->num_accepts;
+    }
+#endif
+
+    INDUS_SPOT(ind_industry) = make_owned_spot(x, y, SPOT_KIND_INDUSTRY, ind_industry);
+
+    if (INDUS_SPOT(ind_industry) == (spot_handle_t) -1) {
+        return -1;
+    }
+
+    if (spot_link(INDUS_SPOT(ind_industry), 0) < 0) {
+        free_spot(INDUS_SPOT(ind_industry), 0);
+        return -1;
+    }
+
+    if (spot_cover(INDUS_SPOT(ind_industry), indtype->reach) < 0) {
+        free_spot(INDUS_SPOT(ind_industry), 0);
+        return -1;
+    }
+
+    // index the stations already within reach
+    industry_catchments[ind_industry].num_stations = 0;
+    _industry_catchment_recount(&industry_catchments[ind_industry]);
+
+    num_near = spot_query_radius(x, y, indtype->reach, SPOT_KIND_MASK(SPOT_KIND_STATION), near, MAX_STATIONS);
+
+    for (j = 0; j < num_near; j++) {
+        const struct spot_t *const spot = spot_get(near[j]);
+
+        _industry_catchment_try_add(ind_industry, spot->owner, spot->x, spot->y);
+    }
+
+    return num_industries++;
+}
+
+size_t industry_get_type(industry_handle_t ind_industry) {
+    errcla(_industry_check_index(ind_industry, "industry_get_type"), -1);
+
+    return INDUS_TYPE(ind_industry);
+}
+
+error_return_t industry_accept_cargo(industry_handle_t ind_industry, size_t ind_accept, econ_t amount) {
+    errcli(_industry_check_index_and_accept(ind_industry, ind_accept, "industry_accept_cargo"));
+
+    COUNT(COUNTER_INDUSTRY_ACCEPT_CARGO);
+
+    // production is left for the end of the period; see industry_end_period
+    const econ_t weighted = econ_mul(amount, industry_types[INDUS_TYPE(ind_industry)].accept_weight[ind_accept]);
+    const econ_t before = INDUS_MATERIAL(ind_industry, ind_accept);
+
+    INDUS_MATERIAL(ind_industry, ind_accept) = econ_add(before, weighted);
+    INDUS_MATERIAL_TOT(ind_industry) = econ_add(INDUS_MATERIAL_TOT(ind_industry), weighted);
+
+    replay_record(REPLAY_INDUSTRY_ACCEPT, ind_industry, (int) ind_accept, 0, 0, amount, before, INDUS_MATERIAL(ind_industry, ind_accept));
+
+    return 0;
+}
+
+econ_t industry_deliver_cargo(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t amount) {
+    econ_t accepted;
+
+    industry_deliver_batch(ind_station, 1, &cargo_type, &amount, &accepted);
+
+    return accepted;
+}
+
+void industry_deliver_batch(station_handle_t ind_station, size_t num_cargos, const cargo_handle_t *cargo_types, const econ_t *amounts, econ_t *accepted) {
+    industry_handle_t near[MAX_INDUSTRIES];
+    size_t num_near, num_accepting, i, j;
+    econ_t share, left;
+
+    num_near = _industry_query_near_station(ind_station, near);
+
+    for (j = 0; j < num_cargos; j++) {
+        accepted[j] = 0;
+
+        if (amounts[j] <= 0 || cargo_types[j] >= num_cargo_types) {
+            continue;
+        }
+
+        num_accepting = 0;
+
+        for (i = 0; i < num_near; i++) {
+            if (industry_types[INDUS_TYPE(near[i])].accept_slots[cargo_types[j]] != 0) {
+                num_accepting++;
             }
+        }
 
-            // spend cargos
-            for (i = 0; i < MAX_INDUS_MATS; i++) {
-                if (indtype->accepts[i] == -1) {
-                    break;
-                }
+        if (num_accepting == 0) {
+            continue;
+        }
 
-                production += spent_mat;
-                indus->material[i] -= spent_mat;
+        share = amounts[j] / (int) num_accepting;
+        left = amounts[j];
+
+        for (i = 0; i < num_near; i++) {
+            const unsigned char slot = industry_types[INDUS_TYPE(near[i])].accept_slots[cargo_types[j]];
+
+            if (slot == 0) {
+                continue;
             }
 
-        case ISUPTYPE_CONVERT:
-            // produce for every cargo type
-            for (i = 0; i < MAX_INDUS_MATS && indtype->accepts[i] != -1; i++) {
-                if (indus->material[i] == 0.0) {
-                    continue;
-                }
+            // the last one also takes whatever the division left over
+            if (--num_accepting == 0) {
+                share = left;
+            }
+
+            left -= share;
 
-                production += indus->material[i];
-                indus->material[i] = 0.0;
+            if (industry_accept_cargo(near[i], slot - 1, share) == 0) {
+                accepted[j] = econ_add(accepted[j], share);
             }
+        }
+    }
+}
 
-            break;
+error_return_t industry_end_period(industry_handle_t ind_industry) {
+    errcli(_industry_check_index(ind_industry, "industry_end_period"));
 
-        case ISUPTYPE_BOOST:
-            // always produce at least base rate
-            production = indtype->base_production;
-            break;
+    COUNT(COUNTER_INDUSTRY_END_PERIOD);
 
-        default:
-            erroric(ERR_INDUSTRY_BAD_SUP_TYPE, "industry_check_production");
+    const struct industry_type_t *const indtype = &industry_types[INDUS_TYPE(ind_industry)];
+
+    int i;
+
+    // stats are per period
+    for (i = 0; i < MAX_INDUS_MATS; i++) {
+        INDUS_PRODUCED(ind_industry, i) = 0;
+        INDUS_TRANSPORTED(ind_industry, i) = 0;
     }
 
-    // check if this industry is boosted
-    boosted = industry_is_boosted(ind_industry);
+    // not producing anything is a perfectly normal outcome
+    industry_check_production(ind_industry);
 
-    if (boosted) {
-        production *= indtype->boost_rate;
+    // boost-type industries only count material received over a period
+    if (indtype->supply_type == ISUPTYPE_BOOST) {
+        for (i = 0; i < MAX_INDUS_MATS; i++) {
+            INDUS_MATERIAL(ind_industry, i) = 0;
+        }
     }
 
-    // apply production
-    industry_make_production(ind_industry, production);
+    INDUS_MATERIAL_TOT(ind_industry) = 0;
+
+    for (i = 0; i < MAX_INDUS_MATS; i++) {
+        INDUS_MATERIAL_TOT(ind_industry) = econ_add(INDUS_MATERIAL_TOT(ind_industry), INDUS_MATERIAL(ind_industry, i));
+    }
 
     return 0;
 }
 
-error_return_t industry_accept_cargo(industry_handle_t ind_industry, size_t ind_accept, float amount) {
-    errcli(_industry_check_index_and_accept(ind_industry, ind_accept, "industry_accept_cargo"));
+#ifdef INDUSTRY_SOA
+
+/**
+ * @brief Reset kernel; clears the period stats of a range of industries.
+ */
+static void _industry_kernel_reset(size_t begin, size_t end) {
+    size_t ind;
+    int mat;
+
+    for (mat = 0; mat < MAX_INDUS_MATS; mat++) {
+        econ_t *const produced = industry_soa.produced[mat];
+        econ_t *const transported = industry_soa.transported[mat];
+
+        for (ind = begin; ind < end; ind++) {
+            produced[ind] = 0;
+            transported[ind] = 0;
+        }
+    }
+}
 
-    struct industry_t *const indus = &industries[ind_industry];
+/**
+ * @brief Boost kernel; works out the boost factor of a range of industries.
+ *
+ * Boost-type industries are boosted if they received enough material
+ * over the period, convert-type industries if they received every
+ * accepted cargo type, and assemble-type industries never are. The
+ * factor is either the type's boost rate, or 1.
+ */
+static void _industry_kernel_boost(size_t begin, size_t end) {
+    size_t ind;
+    int mat;
 
-    indus->material[ind_accept] += amount;
-    indus->material_tot += amount;
+    for (ind = begin; ind < end; ind++) {
+        econ_t all_received = 1;
+        econ_t boosted;
 
-    industry_check_production(ind_industry);
+        for (mat = 0; mat < MAX_INDUS_MATS; mat++) {
+            all_received *= (industry_soa.material[mat][ind] != 0 || industry_soa.accepted[mat][ind] == 0) ? 1 : 0;
+        }
 
-    return 0;
+        boosted = industry_soa.is_boost[ind] * (industry_soa.material_tot[ind] >= industry_soa.boost_threshold[ind] ? 1 : 0)
+                + industry_soa.is_convert[ind] * all_received;
+
+        industry_soa.boost_factor[ind] = boosted != 0 ? industry_soa.boost_rate[ind] : ECON_ONE;
+    }
+}
+
+/**
+ * @brief Production kernel; turns material into production, for a range of industries.
+ *
+ * Boost-type industries produce their base production, convert-type
+ * industries all of their material, and assemble-type industries the
+ * least received material times the number of accepted cargo types,
+ * if every type was received. All material is spent, except what is
+ * left over by assemble-type industries.
+ */
+static void _industry_kernel_produce(size_t begin, size_t end) {
+    size_t ind;
+    int mat;
+
+    for (ind = begin; ind < end; ind++) {
+        econ_t sum = 0;
+        econ_t least = ECON_MAX;
+        econ_t all_received = 1;
+        econ_t spent, total = 0;
+
+        for (mat = 0; mat < MAX_INDUS_MATS; mat++) {
+            const econ_t material = industry_soa.material[mat][ind];
+            const econ_t accepted = industry_soa.accepted[mat][ind];
+
+            sum += material;
+            all_received *= (material != 0 || accepted == 0) ? 1 : 0;
+            least = (accepted != 0 && material < least) ? material : least;
+        }
+
+        spent = all_received != 0 && industry_soa.is_assemble[ind] != 0 ? least : 0;
+
+        industry_soa.production[ind] = econ_mul(
+            industry_soa.is_boost[ind] * industry_soa.base_production[ind]
+          + industry_soa.is_convert[ind] * sum
+          + spent * industry_soa.num_accepts[ind],
+            industry_soa.boost_factor[ind]
+        );
+
+        for (mat = 0; mat < MAX_INDUS_MATS; mat++) {
+            const econ_t left = industry_soa.is_assemble[ind] * (industry_soa.material[mat][ind] - spent * industry_soa.accepted[mat][ind]);
+
+            industry_soa.material[mat][ind] = left;
+            total += left;
+        }
+
+        industry_soa.material_tot[ind] = total;
+    }
+}
+
+#endif // INDUSTRY_SOA
+
+/**
+ * @brief Updates a range of industries at the end of a period.
+ */
+static void _industry_end_period_slice(industry_handle_t begin, industry_handle_t end) {
+    industry_handle_t ind_industry;
+
+#ifdef INDUSTRY_SOA
+    _industry_kernel_reset(begin, end);
+    _industry_kernel_boost(begin, end);
+    _industry_kernel_produce(begin, end);
+
+    for (ind_industry = begin; ind_industry < end; ind_industry++) {
+        if (industry_soa.production[ind_industry] > 0) {
+            industry_recipes[INDUS_TYPE(ind_industry)].supply(ind_industry, industry_soa.production[ind_industry]);
+        }
+    }
+#else
+    for (ind_industry = begin; ind_industry < end; ind_industry++) {
+        // closed industries are simply skipped
+        industry_end_period(ind_industry);
+    }
+#endif
+}
+
+#ifdef INDUSTRY_THREADS
+
+/**
+ * @brief Worker job; updates one range of the industries of a threaded pass.
+ */
+static void _industry_pass_part(int part, int num_parts) {
+    const size_t length = industry_pass_end - industry_pass_begin;
+    const industry_handle_t begin = industry_pass_begin + length * part / num_parts;
+    const industry_handle_t end = industry_pass_begin + length * (part + 1) / num_parts;
+
+    industry_handle_t ind_industry;
+
+    for (ind_industry = begin; ind_industry < end; ind_industry++) {
+        industry_num_shares[ind_industry] = 0;
+    }
+
+    _industry_end_period_slice(begin, end);
+}
+
+/**
+ * @brief Worker job; adds the shares held back in a threaded pass into one range of stations.
+ *
+ * Each range spans whole words of the stations' dirty mask, so that
+ * no two workers ever write to the same word. Shares are added in
+ * industry handle order, as a single thread would have.
+ */
+static void _industry_add_shares_part(int part, int num_parts) {
+    const station_handle_t first = 32 * (STATION_MASK_WORDS * part / num_parts);
+    const station_handle_t last = 32 * (STATION_MASK_WORDS * (part + 1) / num_parts);
+
+    industry_handle_t ind_industry;
+    econ_t rate;
+    int i;
+
+    for (ind_industry = industry_pass_begin; ind_industry < industry_pass_end; ind_industry++) {
+        for (i = 0; i < industry_num_shares[ind_industry]; i++) {
+            const struct industry_share_t *const share = &industry_shares[ind_industry][i];
+
+            if (share->station < first || share->station >= last) {
+                continue;
+            }
+
+            if (industry_distribution == INDUSTRY_DISTRIBUTE_DEMAND) {
+                // the rate was only peeked at; bring it up to date, as reading it would have
+                station_get_pickup_rate(share->station, share->cargo_type, &rate);
+            }
+
+            station_add_cargo(share->station, share->cargo_type, -1, share->amount);
+        }
+    }
+}
+
+#endif // INDUSTRY_THREADS
+
+void industry_end_period_range(industry_handle_t begin, industry_handle_t end) {
+    if (end > num_industries) {
+        end = num_industries;
+    }
+
+#ifdef INDUSTRY_THREADS
+    if (workers_count() > 1 && end >= begin + INDUSTRY_THREADS_MIN_RANGE) {
+        industry_pass_begin = begin;
+        industry_pass_end = end;
+
+        industry_holding_shares = 1;
+        workers_run(_industry_pass_part, workers_count());
+        industry_holding_shares = 0;
+
+        workers_run(_industry_add_shares_part, workers_count());
+
+        return;
+    }
+#endif
+
+    _industry_end_period_slice(begin, end);
+}
+
+const struct snapshot_region_t *industry_snapshot_regions(size_t *num_regions) {
+    *num_regions = sizeof(industry_snapshot) / sizeof(*industry_snapshot);
+
+    return industry_snapshot;
 }
@@ -17,7 +17,10 @@
 #include <stdio.h>
 
 #include "m_error.h"
+#include "m_profile.h"
+#include "m_snapshot.h"
 #include "h_cargo.h"
+#include "h_station.h"
 
 
 /**
@@ -37,7 +40,38 @@
 /**
  * @brief Max. number of industries populating the world.
  */
-#define MAX_INDUSTRIES  128
+#ifndef MAX_INDUSTRIES
+#define MAX_INDUSTRIES 128
+#endif
+
+/**
+ * @brief Max. number of stations within reach of a single industry.
+ */
+#define MAX_CATCHMENT_STATIONS 16
+
+/**
+ * @brief The fewest industries an end-of-period pass is split among workers for.
+ *
+ * Only meaningful in builds that define INDUSTRY_THREADS, which run
+ * the end-of-period pass on the worker pool (see m_workers.h). Each
+ * worker updates its own range of industries, while the cargo they
+ * supply into stations is held back, to be added once all of them
+ * are done, by workers each owning their own range of stations. Cargo
+ * is added to every station in the very same order as a single thread
+ * would, so that the results are exactly the same whatever the number
+ * of workers.
+ */
+#define INDUSTRY_THREADS_MIN_RANGE 32
+
+/**
+ * @brief The pickup rate every station is assumed to have on top of its own.
+ *
+ * In Cargo Units per period, for INDUSTRY_DISTRIBUTE_DEMAND. Keeps
+ * stations that nobody picked cargo up from lately from being cut off
+ * for good; without any cargo waiting, there would be nothing to pick
+ * up once service starts.
+ */
+#define INDUSTRY_DEMAND_BASE ECON_C(1.0)
 
 
 /**
@@ -81,6 +115,27 @@ enum industry_supply_type_t {
     ISUPTYPE_CONVERT
 };
 
+/**
+ * @brief How industries distribute their supplied cargo among the stations in reach.
+ */
+enum industry_distribution_t {
+    /**
+     * @brief Every station loading a cargo type gets an even share of it.
+     */
+    INDUSTRY_DISTRIBUTE_EVEN,
+
+    /**
+     * @brief Every station loading a cargo type gets a share weighted by its pickup rate.
+     *
+     * Stations where vehicles pick cargo up often get more of it than
+     * stations seldom served.
+     *
+     * @see station_get_pickup_rate
+     * @see INDUSTRY_DEMAND_BASE
+     */
+    INDUSTRY_DISTRIBUTE_DEMAND
+};
+
 /**
  * @brief An industry type.
  */
@@ -120,7 +175,7 @@ struct industry_type_t {
      * always produced over a period's length of time. This can still
      * be boosted by boost_rate.
      */
-    float base_production;
+    econ_t base_production;
 
     /**
      * @brief The boost rate.
@@ -128,7 +183,7 @@ struct industry_type_t {
      * How much the output production is multiplied by, if an industry
      * of this type is 'boosted'.
      */
-    float boost_rate;
+    econ_t boost_rate;
 
     /**
      * @brief The boost threshold.
@@ -137,7 +192,7 @@ struct industry_type_t {
      * Material Units to trigger the boost-state of industries of this
      * type.
      */
-    float boost_threshold;
+    econ_t boost_threshold;
 
     /**
      * @brief The radius of station reach.
@@ -170,7 +225,7 @@ struct industry_type_t {
      * is the amount of accepted cargo in Cargo Units, multiplied by
      * the *weight* of that accepted cargo.
      */
-    float accept_weight[MAX_INDUS_MATS];
+    econ_t accept_weight[MAX_INDUS_MATS];
 
     /**
      * @brief Number of cargo types supplied.
@@ -195,11 +250,24 @@ struct industry_type_t {
      *
      * Production is not split by the number of cargo types supplied.
      */
-    float supply_weight[MAX_INDUS_MATS];
+    econ_t supply_weight[MAX_INDUS_MATS];
+
+    /**
+     * @brief The index in accepts of each cargo type plus one, or 0 if it is not accepted.
+     *
+     * Written out by tools/gen_recipes.py along with accepts, so that
+     * delivering cargo never has to search accepts.
+     */
+    unsigned char accept_slots[MAX_CARGO_TYPES];
 };
 
 /**
  * @brief An instance of an industry somewhere in the world.
+ *
+ * This is how industries are stored by default. Builds that define
+ * INDUSTRY_SOA store each field in its own contiguous array instead,
+ * indexed by industry handle, so that end-of-period passes can process
+ * many industries at once; the fields are the same either way.
  */
 struct industry_t {
     /**
@@ -220,7 +288,7 @@ struct industry_t {
      * Each item's cargo type is defined by the industry type's
      * corresponding 'accepts' item.
      */
-    float material[MAX_INDUS_MATS];
+    econ_t material[MAX_INDUS_MATS];
 
     /**
      * @brief Total of all material accumulated in this industry.
@@ -228,7 +296,7 @@ struct industry_t {
      * The ungrouped total of all material accumulated in this industry,
      * in Material Units.
      */
-    float material_tot;
+    econ_t material_tot;
 
     /**
      * @brief X coordinate of the position of this industry ingame.
@@ -240,6 +308,11 @@ struct industry_t {
      */
     float pos_y;
 
+    /**
+     * @brief The spot standing for this industry in the spotmap.
+     */
+    size_t spot;
+
     // -- Stats
 
     /**
@@ -250,7 +323,7 @@ struct industry_t {
      *
      * Each number is reset at the end of the period.
      */
-    float produced[MAX_INDUS_MATS];
+    econ_t produced[MAX_INDUS_MATS];
 
     /**
      * @brief The transported ratio of supplied cargo over this period.
@@ -263,7 +336,46 @@ struct industry_t {
      *
      * All values here are reset at the end of the period.
      */
-    float transported[MAX_INDUS_MATS];
+    econ_t transported[MAX_INDUS_MATS];
+};
+
+/**
+ * @brief The stations within reach of an industry.
+ *
+ * Each industry keeps its own catchment index, which is updated
+ * whenever a station is built, removed or changes which cargo types
+ * it loads, as well as when the industry itself is created. Produced
+ * cargo is only ever distributed among the stations listed here,
+ * so that production never needs to look at every station in the
+ * world.
+ */
+struct industry_catchment_t {
+    /**
+     * @brief Stations within reach of the industry.
+     *
+     * @note Only items up to (num_stations - 1) should be iterated.
+     */
+    station_handle_t stations[MAX_CATCHMENT_STATIONS];
+
+    /**
+     * @brief Which supplied cargo types each station loads.
+     *
+     * Bit i of an item is set if the station with the same index
+     * in 'stations' loads the industry type's supplies[i].
+     */
+    unsigned char supply_masks[MAX_CATCHMENT_STATIONS];
+
+    /**
+     * @brief The number of stations within reach.
+     */
+    size_t num_stations;
+
+    /**
+     * @brief How many stations load each supplied cargo type.
+     *
+     * Indexed like the industry type's supplies.
+     */
+    unsigned char num_loading[MAX_INDUS_MATS];
 };
 
 /**
@@ -271,6 +383,20 @@ struct industry_t {
  */
 extern int num_industries;
 
+/**
+ * @brief How all industries distribute their supplied cargo.
+ *
+ * INDUSTRY_DISTRIBUTE_EVEN by default.
+ */
+extern enum industry_distribution_t industry_distribution;
+
+/**
+ * @brief All definitions of industry types in the game.
+ *
+ * Unused entries have a supply_type of ISUPTYPE_UNKNOWN.
+ */
+extern const struct industry_type_t industry_types[MAX_INDUS_TYPES];
+
 
 // --
 
@@ -290,15 +416,19 @@ unsigned char industry_is_boosted(industry_handle_t ind_industry);
 /**
  * @brief Produce a certain amount of production units from this industry.
  *
- * Each supplied cargo type is distributed evenly to any reachable stations where
+ * Each supplied cargo type is distributed to any reachable stations where
  * that cargo type is loaded. The exact amount of each cargo is the amount of
  * production units multiplied by the respective supply_weight value in that industry's
- * type. Each is divided by the number of stations loading that kind of cargo.
+ * type. It is split among the stations loading that kind of cargo as set by
+ * industry_distribution; evenly, by default.
+ *
+ * Only stations in the industry's catchment index are considered, so the
+ * cost of this is proportional to the number of stations in reach.
  *
  * @param ind_industry The industry from the which to make production.
  * @param amount The amount of production units to be converted into cargo units.
  */
-error_return_t industry_make_production(industry_handle_t ind_industry, float amount);
+error_return_t industry_make_production(industry_handle_t ind_industry, econ_t amount);
 
 /**
  * @brief Update an industry to convert any (and all) accumulatedmaterial into production.
@@ -313,14 +443,142 @@ error_return_t industry_check_production(industry_handle_t ind_industry);
 /**
  * @brief Accepts into an industry a specific type of accepted cargo, at a specific amount.
  *
+ * The cargo is only accumulated as material, weighted by the accepted
+ * cargo's accept_weight; it is converted into production at the end
+ * of the economy period, by industry_end_period.
+ *
  * @param ind_industry Index of the industry instance.
  * @param ind_accept Index of the accepted cargo in the industry's type. NOT cargo type!
  * @param amount Amount of this cargo to be accepted.
  */
-error_return_t industry_accept_cargo(industry_handle_t ind_industry, size_t ind_accept, float amount);
+error_return_t industry_accept_cargo(industry_handle_t ind_industry, size_t ind_accept, econ_t amount);
+
+/**
+ * @brief Delivers cargo unloaded at a station into the industries in reach that accept it.
+ *
+ * The cargo is split evenly among all industries within reach of the
+ * station which accept the cargo type, and is accepted by each as if
+ * by industry_accept_cargo. Whatever the split leaves over goes to the
+ * last of them, so none of it is lost.
+ *
+ * @param ind_station The station where the cargo is unloaded.
+ * @param cargo_type The type of the cargo unloaded.
+ * @param amount The amount of cargo unloaded.
+ * @return econ_t The amount of cargo the industries actually accepted; 0 if none accepts it.
+ */
+econ_t industry_deliver_cargo(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t amount);
+
+/**
+ * @brief Delivers several cargo types unloaded at a station at once.
+ *
+ * Like industry_deliver_cargo for each cargo type, but only finds the
+ * industries in reach of the station once, for all of them.
+ *
+ * @param ind_station The station where the cargo is unloaded.
+ * @param num_cargos The number of cargo types unloaded.
+ * @param cargo_types The type of each cargo unloaded.
+ * @param amounts The amount of each cargo unloaded.
+ * @param accepted Where to store the amount of each cargo actually accepted; 0 for unknown cargo types.
+ */
+void industry_deliver_batch(station_handle_t ind_station, size_t num_cargos, const cargo_handle_t *cargo_types, const econ_t *amounts, econ_t *accepted);
+
+/**
+ * @brief Ends the economy period for an industry.
+ *
+ * Resets the industry's per-period stats, makes production out of all
+ * material accumulated over the period, and clears the period's
+ * material count. Called by the economy scheduler once per period, for
+ * every industry.
+ *
+ * @param ind_industry Index of the industry instance.
+ */
+error_return_t industry_end_period(industry_handle_t ind_industry);
+
+/**
+ * @brief Ends the economy period for a range of industries.
+ *
+ * Same as calling industry_end_period on every industry from begin up
+ * to (but not including) end. In structure-of-arrays builds, the
+ * whole range goes through the production kernels at once, and only
+ * distributing the resulting cargo is done per industry.
+ *
+ * @param begin The first industry in the range.
+ * @param end One past the last industry in the range; clamped to num_industries.
+ */
+void industry_end_period_range(industry_handle_t begin, industry_handle_t end);
+
+/**
+ * @brief Creates a new industry of a given type at a position.
+ *
+ * This only sets up the industry's state; it does not spawn anything
+ * in the physical world. Industries are placed and spawned on the map
+ * by the map generator (see i_mapgen.h).
+ *
+ * @param ind_indus_type The index of the industry type, in industry_types.
+ * @param x X coordinate of the position of the new industry.
+ * @param y Y coordinate of the position of the new industry.
+ * @return industry_handle_t The handle of the new industry, or -1 on error.
+ */
+industry_handle_t industry_create(size_t ind_indus_type, float x, float y);
+
+/**
+ * @brief Gets the type of an industry.
+ *
+ * @param ind_industry The industry whose type to get.
+ * @return size_t The index of the industry's type in industry_types, or -1 if there is no such industry.
+ */
+size_t industry_get_type(industry_handle_t ind_industry);
+
+/**
+ * @brief Finds the industries whose reach covers a position.
+ *
+ * Costs a single spotmap tile lookup, and a distance check for each
+ * industry whose reach overlaps that tile; e.g. to show which
+ * industries a station would serve before it is built.
+ *
+ * @param x X coordinate of the position.
+ * @param y Y coordinate of the position.
+ * @param out Where to store the handles of the industries found.
+ * @param max The number of handles out has room for.
+ * @return size_t The number of industries found.
+ */
+size_t industry_query_reach(float x, float y, industry_handle_t *out, size_t max);
+
+/**
+ * @brief Adds a newly built station to the catchment of industries in reach.
+ *
+ * Called by station code; there should be no need to call this
+ * elsewhere.
+ *
+ * @param ind_station The station that was built.
+ */
+void industry_catchment_add_station(station_handle_t ind_station);
+
+/**
+ * @brief Removes a station from the catchment of all industries.
+ *
+ * Called by station code, before the station is actually removed.
+ *
+ * @param ind_station The station being removed.
+ */
+void industry_catchment_remove_station(station_handle_t ind_station);
+
+/**
+ * @brief Refreshes which supplied cargo a station loads, in all catchments.
+ *
+ * Called by station code whenever a station's loaded cargo types change.
+ *
+ * @param ind_station The station whose loaded cargo types changed.
+ */
+void industry_catchment_update_station(station_handle_t ind_station);
 
-// TODO: decide on a way to do industry_spawn
-//size_t industry_spawn(size_t ind_indus_type, );
+/**
+ * @brief Gets the industry tables, as snapshot regions.
+ *
+ * @param num_regions Where to store the number of regions.
+ * @return const struct snapshot_region_t* The regions, in a fixed order.
+ */
+const struct snapshot_region_t *industry_snapshot_regions(size_t *num_regions);
 
 
 #endif // INDUSTRY_H
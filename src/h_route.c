@@ -0,0 +1,649 @@
+/**
+ * @file h_route.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Cargo routing logic.
+ * @version added in 0.1
+ * @date 2021-03-16
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * How links between stations are kept, and how route trees are worked
+ * out from them, a slice at a time.
+ */
+
+#include "h_route.h"
+
+
+/**
+ * @brief A shortest path tree towards a station, for a type of cargo.
+ */
+struct route_tree_t {
+    /**
+     * @brief Whether this tree is in use.
+     */
+    unsigned char active;
+
+    /**
+     * @brief Whether this tree has to be worked out again.
+     */
+    unsigned char dirty;
+
+    /**
+     * @brief The type of cargo routed.
+     */
+    cargo_handle_t cargo_type;
+
+    /**
+     * @brief The station all routes in this tree lead to.
+     */
+    station_handle_t dest;
+
+    /**
+     * @brief The value of route_use_clock when this tree was last asked for.
+     */
+    unsigned int last_used;
+
+    /**
+     * @brief The next hop from each station towards dest, or -1 if none.
+     */
+    station_handle_t next_hop[MAX_STATIONS];
+
+    /**
+     * @brief The cost from each station to dest, or a negative value if unreachable.
+     */
+    float cost[MAX_STATIONS];
+};
+
+/**
+ * @brief A station waiting to be settled, in the route work heap.
+ */
+struct route_heap_item_t {
+    float cost;
+    station_handle_t station;
+};
+
+/**
+ * @brief All links between stations.
+ */
+static struct route_link_t route_links[MAX_ROUTE_LINKS];
+
+/**
+ * @brief The number of link slots in use, including removed ones.
+ */
+static int num_route_links;
+
+/**
+ * @brief The first of the removed links, plus one, or 0 if none.
+ *
+ * Removed links are chained through their next_out field.
+ */
+static int route_link_free;
+
+/**
+ * @brief The first link going from each station, plus one, or 0 if none.
+ */
+static int route_out[MAX_STATIONS];
+
+/**
+ * @brief The first link going to each station, plus one, or 0 if none.
+ */
+static int route_in[MAX_STATIONS];
+
+/**
+ * @brief All route trees.
+ */
+static struct route_tree_t route_trees[MAX_ROUTE_TREES];
+
+/**
+ * @brief Counts every time a tree is asked for, to tell which was used least recently.
+ */
+static unsigned int route_use_clock;
+
+/**
+ * @brief The tree being worked out, or -1 if none.
+ *
+ * Its old next hops and costs are kept as they are until it is done;
+ * the work in progress lives in route_work_next and route_work_cost.
+ */
+static int route_work_tree = -1;
+
+/**
+ * @brief Where to look for the next dirty tree from.
+ */
+static int route_work_cursor;
+
+static station_handle_t route_work_next[MAX_STATIONS];
+static float route_work_cost[MAX_STATIONS];
+
+/**
+ * @brief How many station slots were in use when the work started.
+ *
+ * Stations built since then have no links, so are unreachable anyway.
+ */
+static int route_work_stations;
+
+/**
+ * @brief The station being settled, and its cost.
+ */
+static station_handle_t route_work_node;
+static float route_work_node_cost;
+
+/**
+ * @brief The next link into route_work_node to be looked at, plus one, or 0 if none.
+ */
+static int route_work_link;
+
+/**
+ * @brief Stations waiting to be settled, as a binary min-heap.
+ *
+ * Stations are pushed again whenever a cheaper route to them is
+ * found, instead of being moved within the heap; older items are then
+ * skipped when popped. Since a station is only pushed when one of the
+ * links into it is looked at, and each link is only looked at once,
+ * the heap never holds more items than there are links, plus the
+ * destination itself.
+ */
+static struct route_heap_item_t route_heap[MAX_ROUTE_LINKS + 1];
+static int route_heap_length;
+
+/**
+ * @brief Hashes of the blocks of the link table, as of the last snapshot.
+ */
+static unsigned int route_link_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(route_links))];
+
+static const struct snapshot_region_t route_snapshot[] = {
+    SNAPSHOT_REGION(route_links, route_link_snapshot_hashes),
+    SNAPSHOT_REGION(num_route_links, NULL),
+    SNAPSHOT_REGION(route_link_free, NULL),
+    SNAPSHOT_REGION(route_out, NULL),
+    SNAPSHOT_REGION(route_in, NULL)
+};
+
+
+/**
+ * @brief The cost of travelling along a link.
+ */
+static float _route_link_cost(const struct route_link_t *const link) {
+    return link->travel_tics / link->num_vehicles + ROUTE_CAPACITY_COST / (link->capacity > 1.0 ? link->capacity : 1.0);
+}
+
+/**
+ * @brief Finds the link between two stations for a cargo type.
+ *
+ * @return int The index of the link plus one, or 0 if none.
+ */
+static int _route_find_link(station_handle_t from, station_handle_t to, cargo_handle_t cargo_type) {
+    int ind_link;
+
+    for (ind_link = route_out[from]; ind_link != 0; ind_link = route_links[ind_link - 1].next_out) {
+        if (route_links[ind_link - 1].to == to && route_links[ind_link - 1].cargo_type == cargo_type) {
+            return ind_link;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Stops working on the current tree; it stays dirty.
+ */
+static void _route_work_abort(void) {
+    route_work_tree = -1;
+    route_work_link = 0;
+    route_heap_length = 0;
+}
+
+/**
+ * @brief Marks the trees that a changed link affects as dirty.
+ *
+ * A cheaper link only matters to a tree if it makes some station's
+ * route cheaper; a dearer link only matters if a route goes through
+ * it. The tree being worked out is always started over, since the
+ * work done so far may already be stale.
+ *
+ * @param old_cost The cost of the link before it changed, or negative if it did not exist.
+ * @param new_cost The cost of the link after it changed, or negative if it was removed.
+ */
+static void _route_link_changed(const struct route_link_t *const link, float old_cost, float new_cost) {
+    struct route_tree_t *tree;
+    int i;
+
+    for (i = 0; i < MAX_ROUTE_TREES; i++) {
+        tree = &route_trees[i];
+
+        if (!tree->active || tree->cargo_type != link->cargo_type) {
+            continue;
+        }
+
+        if (i == route_work_tree) {
+            _route_work_abort();
+            tree->dirty = 1;
+        }
+
+        else if (tree->dirty) {
+            continue;
+        }
+
+        else if (new_cost >= 0.0 && (old_cost < 0.0 || new_cost < old_cost)) {
+            if (tree->cost[link->to] >= 0.0 && (tree->cost[link->from] < 0.0 || tree->cost[link->to] + new_cost < tree->cost[link->from])) {
+                tree->dirty = 1;
+            }
+        }
+
+        else if (tree->next_hop[link->from] == link->to) {
+            tree->dirty = 1;
+        }
+    }
+}
+
+/**
+ * @brief Takes a link out of the link lists of its stations, and frees it.
+ */
+static void _route_unlink(int ind_link) {
+    struct route_link_t *const link = &route_links[ind_link - 1];
+
+    int *next;
+
+    // don't leave the tree work pointing at a freed link
+    if (route_work_link == ind_link) {
+        route_work_link = link->next_in;
+    }
+
+    for (next = &route_out[link->from]; *next != ind_link; next = &route_links[*next - 1].next_out);
+    *next = link->next_out;
+
+    for (next = &route_in[link->to]; *next != ind_link; next = &route_links[*next - 1].next_in);
+    *next = link->next_in;
+
+    link->num_vehicles = 0;
+    link->next_out = route_link_free;
+    route_link_free = ind_link;
+}
+
+/**
+ * @brief Removes a link outright, no matter how many vehicles travel along it.
+ */
+static void _route_drop_link(int ind_link) {
+    const float old_cost = _route_link_cost(&route_links[ind_link - 1]);
+
+    _route_unlink(ind_link);
+    _route_link_changed(&route_links[ind_link - 1], old_cost, -1.0);
+}
+
+static int _route_heap_before(const struct route_heap_item_t *a, const struct route_heap_item_t *b) {
+    if (a->cost != b->cost) {
+        return a->cost < b->cost;
+    }
+
+    return a->station < b->station;
+}
+
+static void _route_heap_push(float cost, station_handle_t ind_station) {
+    struct route_heap_item_t item = { cost, ind_station };
+    int index = route_heap_length++;
+
+    while (index > 0 && _route_heap_before(&item, &route_heap[(index - 1) / 2])) {
+        route_heap[index] = route_heap[(index - 1) / 2];
+        index = (index - 1) / 2;
+    }
+
+    route_heap[index] = item;
+}
+
+static struct route_heap_item_t _route_heap_pop(void) {
+    const struct route_heap_item_t top = route_heap[0];
+    const struct route_heap_item_t last = route_heap[--route_heap_length];
+
+    int index = 0, child;
+
+    for (;;) {
+        child = index * 2 + 1;
+
+        if (child >= route_heap_length) {
+            break;
+        }
+
+        if (child + 1 < route_heap_length && _route_heap_before(&route_heap[child + 1], &route_heap[child])) {
+            child++;
+        }
+
+        if (!_route_heap_before(&route_heap[child], &last)) {
+            break;
+        }
+
+        route_heap[index] = route_heap[child];
+        index = child;
+    }
+
+    route_heap[index] = last;
+
+    return top;
+}
+
+/**
+ * @brief Starts working on the next dirty tree, if there is any.
+ *
+ * @return int 1 if work was started, 0 if there are no dirty trees.
+ */
+static int _route_work_start(void) {
+    struct route_tree_t *tree;
+    int i, ind_tree;
+    station_handle_t ind_station;
+
+    for (i = 0; i < MAX_ROUTE_TREES; i++) {
+        ind_tree = (route_work_cursor + i) % MAX_ROUTE_TREES;
+
+        if (route_trees[ind_tree].active && route_trees[ind_tree].dirty) {
+            break;
+        }
+    }
+
+    if (i == MAX_ROUTE_TREES) {
+        return 0;
+    }
+
+    tree = &route_trees[ind_tree];
+
+    route_work_tree = ind_tree;
+    route_work_cursor = (ind_tree + 1) % MAX_ROUTE_TREES;
+    route_work_stations = num_stations;
+    tree->dirty = 0;
+
+    for (ind_station = 0; ind_station < route_work_stations; ind_station++) {
+        route_work_next[ind_station] = -1;
+        route_work_cost[ind_station] = -1.0;
+    }
+
+    // the tree is grown backwards, from the destination
+    route_work_next[tree->dest] = tree->dest;
+    route_work_cost[tree->dest] = 0.0;
+    route_work_link = 0;
+    route_heap_length = 0;
+
+    _route_heap_push(0.0, tree->dest);
+
+    return 1;
+}
+
+/**
+ * @brief Hands the finished work over to the tree being worked out.
+ */
+static void _route_work_finish(void) {
+    struct route_tree_t *const tree = &route_trees[route_work_tree];
+
+    station_handle_t ind_station;
+
+    for (ind_station = 0; ind_station < route_work_stations; ind_station++) {
+        tree->next_hop[ind_station] = route_work_next[ind_station];
+        tree->cost[ind_station] = route_work_cost[ind_station];
+    }
+
+    route_work_tree = -1;
+}
+
+/**
+ * @brief Finds the tree for a cargo type and destination, making it if needed.
+ *
+ * If all trees are in use, the least recently used one is dropped,
+ * unless it is being worked out.
+ */
+static struct route_tree_t *_route_use_tree(cargo_handle_t cargo_type, station_handle_t dest) {
+    struct route_tree_t *tree;
+    int i, ind_oldest = -1;
+    station_handle_t ind_station;
+
+    for (i = 0; i < MAX_ROUTE_TREES; i++) {
+        tree = &route_trees[i];
+
+        if (tree->active && tree->cargo_type == cargo_type && tree->dest == dest) {
+            tree->last_used = ++route_use_clock;
+            return tree;
+        }
+
+        if (i == route_work_tree) {
+            continue;
+        }
+
+        if (ind_oldest < 0 || !tree->active || (route_trees[ind_oldest].active && tree->last_used < route_trees[ind_oldest].last_used)) {
+            ind_oldest = i;
+        }
+    }
+
+    tree = &route_trees[ind_oldest];
+
+    tree->active = 1;
+    tree->dirty = 1;
+    tree->cargo_type = cargo_type;
+    tree->dest = dest;
+    tree->last_used = ++route_use_clock;
+
+    for (ind_station = 0; ind_station < MAX_STATIONS; ind_station++) {
+        tree->next_hop[ind_station] = -1;
+        tree->cost[ind_station] = -1.0;
+    }
+
+    return tree;
+}
+
+static error_return_t _route_check_query(cargo_handle_t cargo_type, station_handle_t from, station_handle_t dest, const char *const ctx) {
+    if (cargo_type >= num_cargo_types) {
+        erroric(ERR_BAD_MATERIAL, ctx);
+    }
+
+    if (!station_exists(from) || !station_exists(dest)) {
+        erroric(ERR_STATION_BAD_INDEX, ctx);
+    }
+
+    return 0;
+}
+
+error_return_t route_link_add(station_handle_t from, station_handle_t to, cargo_handle_t cargo_type, float capacity, float travel_tics) {
+    struct route_link_t *link;
+    int ind_link;
+    float old_cost = -1.0;
+
+    if (!station_exists(from) || !station_exists(to)) {
+        erroric(ERR_STATION_BAD_INDEX, "route_link_add");
+    }
+
+    if (from == to) {
+        return 0;
+    }
+
+    ind_link = _route_find_link(from, to, cargo_type);
+
+    if (ind_link != 0) {
+        old_cost = _route_link_cost(&route_links[ind_link - 1]);
+    }
+
+    else if (route_link_free != 0) {
+        ind_link = route_link_free;
+        route_link_free = route_links[ind_link - 1].next_out;
+    }
+
+    else if (num_route_links < MAX_ROUTE_LINKS) {
+        ind_link = ++num_route_links;
+    }
+
+    else {
+        erroric(ERR_ROUTE_LINKS_FULL, "route_link_add");
+    }
+
+    link = &route_links[ind_link - 1];
+
+    if (old_cost < 0.0) {
+        link->from = from;
+        link->to = to;
+        link->cargo_type = cargo_type;
+        link->capacity = 0.0;
+        link->travel_tics = 0.0;
+        link->num_vehicles = 0;
+        link->next_out = route_out[from];
+        link->next_in = route_in[to];
+
+        route_out[from] = ind_link;
+        route_in[to] = ind_link;
+    }
+
+    link->capacity += capacity;
+    link->travel_tics += travel_tics;
+    link->num_vehicles++;
+
+    _route_link_changed(link, old_cost, _route_link_cost(link));
+
+    return 0;
+}
+
+void route_link_remove(station_handle_t from, station_handle_t to, cargo_handle_t cargo_type, float capacity, float travel_tics) {
+    struct route_link_t *link;
+    int ind_link;
+    float old_cost;
+
+    if (from >= MAX_STATIONS || to >= MAX_STATIONS) {
+        return;
+    }
+
+    ind_link = _route_find_link(from, to, cargo_type);
+
+    // already gone along with one of its stations
+    if (ind_link == 0) {
+        return;
+    }
+
+    link = &route_links[ind_link - 1];
+
+    if (link->num_vehicles <= 1) {
+        _route_drop_link(ind_link);
+        return;
+    }
+
+    old_cost = _route_link_cost(link);
+
+    link->capacity -= capacity;
+    link->travel_tics -= travel_tics;
+    link->num_vehicles--;
+
+    _route_link_changed(link, old_cost, _route_link_cost(link));
+}
+
+void route_remove_station(station_handle_t ind_station) {
+    int i;
+
+    while (route_out[ind_station] != 0) {
+        _route_drop_link(route_out[ind_station]);
+    }
+
+    while (route_in[ind_station] != 0) {
+        _route_drop_link(route_in[ind_station]);
+    }
+
+    for (i = 0; i < MAX_ROUTE_TREES; i++) {
+        if (route_trees[i].active && route_trees[i].dest == ind_station) {
+            if (i == route_work_tree) {
+                _route_work_abort();
+            }
+
+            route_trees[i].active = 0;
+        }
+    }
+}
+
+error_return_t route_next_hop(cargo_handle_t cargo_type, station_handle_t from, station_handle_t dest, station_handle_t *next) {
+    errcli(_route_check_query(cargo_type, from, dest, "route_next_hop"));
+
+    COUNT(COUNTER_ROUTE_NEXT_HOP);
+
+    *next = _route_use_tree(cargo_type, dest)->next_hop[from];
+
+    return 0;
+}
+
+error_return_t route_get_cost(cargo_handle_t cargo_type, station_handle_t from, station_handle_t dest, float *cost) {
+    errcli(_route_check_query(cargo_type, from, dest, "route_get_cost"));
+
+    *cost = _route_use_tree(cargo_type, dest)->cost[from];
+
+    return 0;
+}
+
+int route_is_settled(void) {
+    int i;
+
+    if (route_work_tree >= 0) {
+        return 0;
+    }
+
+    for (i = 0; i < MAX_ROUTE_TREES; i++) {
+        if (route_trees[i].active && route_trees[i].dirty) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+void route_tick(void) {
+    const struct route_link_t *link;
+    struct route_heap_item_t item;
+    int steps;
+    float cost;
+
+    for (steps = 0; steps < ROUTE_SLICE_STEPS; steps++) {
+        if (route_work_tree < 0 && !_route_work_start()) {
+            return;
+        }
+
+        if (route_work_link != 0) {
+            link = &route_links[route_work_link - 1];
+            route_work_link = link->next_in;
+
+            if (link->cargo_type != route_trees[route_work_tree].cargo_type) {
+                continue;
+            }
+
+            cost = route_work_node_cost + _route_link_cost(link);
+
+            if (route_work_cost[link->from] < 0.0 || cost < route_work_cost[link->from]) {
+                route_work_cost[link->from] = cost;
+                route_work_next[link->from] = route_work_node;
+
+                _route_heap_push(cost, link->from);
+            }
+
+            continue;
+        }
+
+        if (route_heap_length == 0) {
+            _route_work_finish();
+            continue;
+        }
+
+        item = _route_heap_pop();
+
+        // a cheaper route to this station was already settled
+        if (item.cost > route_work_cost[item.station]) {
+            continue;
+        }
+
+        route_work_node = item.station;
+        route_work_node_cost = item.cost;
+        route_work_link = route_in[item.station];
+    }
+}
+
+void route_forget_trees(void) {
+    int i;
+
+    _route_work_abort();
+
+    for (i = 0; i < MAX_ROUTE_TREES; i++) {
+        route_trees[i].active = 0;
+        route_trees[i].dirty = 0;
+    }
+}
+
+const struct snapshot_region_t *route_snapshot_regions(size_t *num_regions) {
+    *num_regions = sizeof(route_snapshot) / sizeof(*route_snapshot);
+
+    return route_snapshot;
+}
@@ -0,0 +1,214 @@
+/**
+ * @file h_route.h
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Cargo routing between stations.
+ * @version added in 0.1
+ * @date 2021-03-16
+ *
+ * Stations are linked by the vehicles that serve them: every pair of
+ * consecutive orders of a vehicle links the two stations, once for
+ * each cargo type the vehicle carries. Each link is weighted by how
+ * long it takes to travel, and by how much it can carry; links that
+ * carry little are worth less than links that carry a lot.
+ *
+ * On top of this link graph, routes are kept as shortest path trees,
+ * one per cargo type and destination station, each of which tells the
+ * next hop from every other station towards its destination. Trees are
+ * only made when first asked for, and only worked out again when a
+ * link that changed would actually change them. That work is spread
+ * over several tics, ROUTE_SLICE_STEPS steps at a time, by route_tick;
+ * until a tree is done, the last one worked out is used.
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ */
+
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include <stddef.h>
+
+#include "m_error.h"
+#include "m_profile.h"
+#include "m_snapshot.h"
+#include "h_cargo.h"
+#include "h_station.h"
+
+
+/**
+ * @brief The maximum number of links between stations in the entire world.
+ *
+ * May be overridden at build time, like MAX_VEHICLES.
+ */
+#ifndef MAX_ROUTE_LINKS
+#define MAX_ROUTE_LINKS 1024
+#endif
+
+/**
+ * @brief The maximum number of route trees kept at once.
+ *
+ * When all are in use, the one least recently asked for is dropped to
+ * make room for a new one.
+ */
+#define MAX_ROUTE_TREES 64
+
+/**
+ * @brief How many steps of route tree work route_tick does per tic.
+ *
+ * Each step settles a station, or looks at a single link.
+ */
+#define ROUTE_SLICE_STEPS 256
+
+/**
+ * @brief How much capacity weighs on the cost of a link, in tics.
+ *
+ * A link costs as many extra tics as this value divided by the
+ * capacity of all vehicles along it, in Cargo Units.
+ */
+#define ROUTE_CAPACITY_COST 2000.0
+
+
+/**
+ * @brief A link between two stations, over which a type of cargo is carried.
+ */
+struct route_link_t {
+    /**
+     * @brief The station the link goes from.
+     */
+    station_handle_t from;
+
+    /**
+     * @brief The station the link goes to.
+     */
+    station_handle_t to;
+
+    /**
+     * @brief The type of cargo carried over the link.
+     */
+    cargo_handle_t cargo_type;
+
+    /**
+     * @brief The summed capacity of all vehicles along this link, in Cargo Units.
+     */
+    float capacity;
+
+    /**
+     * @brief The summed travel time of all vehicles along this link, in tics.
+     */
+    float travel_tics;
+
+    /**
+     * @brief How many vehicles travel along this link.
+     *
+     * The link is removed once none do.
+     */
+    int num_vehicles;
+
+    /**
+     * @brief The next link going from the same station, plus one, or 0 if none.
+     */
+    int next_out;
+
+    /**
+     * @brief The next link going to the same station, plus one, or 0 if none.
+     */
+    int next_in;
+};
+
+/**
+ * @brief Adds a vehicle to the link between two stations.
+ *
+ * The link is made if it does not exist yet.
+ *
+ * @param from The station the vehicle departs from.
+ * @param to The station the vehicle arrives at.
+ * @param cargo_type The type of cargo the vehicle carries.
+ * @param capacity How much cargo of that type fits in the vehicle.
+ * @param travel_tics How long the vehicle takes to travel, in tics.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t route_link_add(station_handle_t from, station_handle_t to, cargo_handle_t cargo_type, float capacity, float travel_tics);
+
+/**
+ * @brief Takes a vehicle out of the link between two stations.
+ *
+ * Must be passed the same values as the route_link_add call that
+ * added the vehicle. The link is removed if no vehicles remain in it.
+ *
+ * @param from The station the vehicle departs from.
+ * @param to The station the vehicle arrives at.
+ * @param cargo_type The type of cargo the vehicle carries.
+ * @param capacity How much cargo of that type fits in the vehicle.
+ * @param travel_tics How long the vehicle takes to travel, in tics.
+ */
+void route_link_remove(station_handle_t from, station_handle_t to, cargo_handle_t cargo_type, float capacity, float travel_tics);
+
+/**
+ * @brief Removes all links to and from a station, and all routes to it.
+ *
+ * @param ind_station The station that is being removed.
+ */
+void route_remove_station(station_handle_t ind_station);
+
+/**
+ * @brief Gets the next station along the route from a station to another.
+ *
+ * If no route tree exists yet for this cargo type and destination,
+ * one is queued to be worked out over the next few tics; until then,
+ * no route is found.
+ *
+ * @param cargo_type The type of cargo to be routed.
+ * @param from The station the cargo is in.
+ * @param dest The station the cargo should go to.
+ * @param next A pointer to a station handle in the which to store the next hop, or -1 if there is no known route.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t route_next_hop(cargo_handle_t cargo_type, station_handle_t from, station_handle_t dest, station_handle_t *next);
+
+/**
+ * @brief Gets the cost of the route from a station to another.
+ *
+ * @see route_next_hop
+ *
+ * @param cargo_type The type of cargo to be routed.
+ * @param from The station the cargo is in.
+ * @param dest The station the cargo should go to.
+ * @param cost A pointer to a float in the which to store the cost in tics, or a negative value if there is no known route.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t route_get_cost(cargo_handle_t cargo_type, station_handle_t from, station_handle_t dest, float *cost);
+
+/**
+ * @brief Checks whether all route trees are up to date.
+ *
+ * @return int 1 if no route tree is waiting to be worked out, else 0.
+ */
+int route_is_settled(void);
+
+/**
+ * @brief Works on outdated route trees, for up to ROUTE_SLICE_STEPS steps.
+ *
+ * Must be called once per tic.
+ */
+void route_tick(void);
+
+/**
+ * @brief Drops every route tree, and any work on them.
+ *
+ * Trees are not part of snapshots, as they can always be worked out
+ * again from the links; this must be called once the links have been
+ * restored from one. Trees are made anew as routes are asked for.
+ */
+void route_forget_trees(void);
+
+/**
+ * @brief Gets the route link tables, as snapshot regions.
+ *
+ * Route trees are left out; see route_forget_trees.
+ *
+ * @param num_regions Where to store the number of regions.
+ * @return const struct snapshot_region_t* The regions, in a fixed order.
+ */
+const struct snapshot_region_t *route_snapshot_regions(size_t *num_regions);
+
+
+#endif // ROUTE_H
@@ -14,6 +14,12 @@
 #include <stddef.h>
 
 #include "h_station.h"
+#include "h_economy.h"
+#include "h_industry.h"
+#include "h_route.h"
+#include "h_vehicle.h"
+#include "i_place.h"
+#include "m_replay.h"
 
 
 /**
@@ -22,61 +28,705 @@
 static struct station_t stations[MAX_STATIONS];
 
 /**
- * @brief Number of stations in the world.
+ * @brief Number of station slots in use, including removed ones.
  */
-static int num_stations;
+int num_stations;
+
+/**
+ * @brief Stations changed since the dirty state was last cleared, as a bitmask.
+ */
+static unsigned int station_dirty[STATION_MASK_WORDS];
+
+/**
+ * @brief Hashes of the blocks of the station table, as of the last snapshot.
+ */
+static unsigned int station_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(stations))];
+
+static const struct snapshot_region_t station_snapshot[] = {
+    SNAPSHOT_REGION(stations, station_snapshot_hashes),
+    SNAPSHOT_REGION(station_dirty, NULL),
+    SNAPSHOT_REGION(num_stations, NULL)
+};
 
 
 static error_return_t _station_check_index(station_handle_t ind_station, const char *const ctx) {
-    if (ind_station < num_stations) {
+    if (ind_station >= num_stations || !stations[ind_station].active) {
         erroric(ERR_STATION_BAD_INDEX, ctx);
     }
 
     return 0;
 }
 
-error_return_t station_add_cargo(station_handle_t ind_station, cargo_handle_t cargo_type, int origin, float amount) {
+/**
+ * @brief Marks a station, and optionally one of its cargo types, as changed.
+ *
+ * @param cargo_type The cargo type that changed, or -1 for none in particular.
+ */
+static void _station_mark_dirty(station_handle_t ind_station, cargo_handle_t cargo_type) {
+    station_dirty[ind_station / 32] |= 1u << (ind_station % 32);
+
+    if (cargo_type != (cargo_handle_t) -1) {
+        stations[ind_station].dirty_cargo[cargo_type / 32] |= 1u << (cargo_type % 32);
+    }
+}
+
+/**
+ * @brief Hashes the key of a cargo load.
+ */
+static unsigned int _station_hash_load(cargo_handle_t cargo_type, size_t origin) {
+    // same mixing as the spotmap's, over cargo type and origin
+    unsigned int hash = (unsigned int) cargo_type * 0x9E3779B1u ^ (unsigned int) origin * 0x85EBCA77u;
+
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+/**
+ * @brief Finds the load table slot of a cargo load.
+ *
+ * @return unsigned int The slot holding the load with this cargo type
+ *   and origin, or else the empty slot where it would be put.
+ */
+static unsigned int _station_find_load_slot(const struct station_t *const station, cargo_handle_t cargo_type, size_t origin) {
+    const unsigned int mask = STATION_LOAD_SLOTS - 1;
+
+    unsigned int slot;
+
+    COUNT(COUNTER_STATION_LOAD_SCAN);
+
+    // never full, as it has twice as many slots as there can be loads
+    for (slot = _station_hash_load(cargo_type, origin) & mask; station->load_slots[slot] != 0; slot = (slot + 1) & mask) {
+        const struct station_load_t *const load = &station->cargo_loads[station->load_slots[slot] - 1];
+
+        COUNT(COUNTER_STATION_LOAD_PROBE);
+
+        if (load->cargo_type == cargo_type && load->origin == origin) {
+            break;
+        }
+    }
+
+    return slot;
+}
+
+/**
+ * @brief Removes a cargo load from a station's load table.
+ *
+ * Shifts back any loads further along the probe sequence, so that
+ * lookups never stop early at the freed slot.
+ */
+static void _station_unlink_load_slot(struct station_t *const station, unsigned int slot) {
+    const unsigned int mask = STATION_LOAD_SLOTS - 1;
+
+    unsigned int next = slot;
+    unsigned int home;
+
+    for (;;) {
+        next = (next + 1) & mask;
+
+        if (station->load_slots[next] == 0) {
+            break;
+        }
+
+        const struct station_load_t *const load = &station->cargo_loads[station->load_slots[next] - 1];
+
+        home = _station_hash_load(load->cargo_type, load->origin) & mask;
+
+        // leave loads whose home slot lies cyclically in (slot, next]
+        if (slot <= next ? (slot < home && home <= next) : (slot < home || home <= next)) {
+            continue;
+        }
+
+        station->load_slots[slot] = station->load_slots[next];
+        slot = next;
+    }
+
+    station->load_slots[slot] = 0;
+}
+
+/**
+ * @brief Removes an emptied cargo load from a station.
+ *
+ * The last load takes its place in cargo_loads. The total of its cargo
+ * type is recounted from the remaining loads, so that no rounding
+ * leftovers pile up in it.
+ */
+static void _station_remove_load(struct station_t *const station, unsigned int slot) {
+    const size_t ind_load = station->load_slots[slot] - 1;
+    const cargo_handle_t cargo_type = station->cargo_loads[ind_load].cargo_type;
+
+    size_t i;
+
+    _station_unlink_load_slot(station, slot);
+
+    station->num_cargo_loads--;
+
+    if (ind_load != station->num_cargo_loads) {
+        const struct station_load_t *const last = &station->cargo_loads[station->num_cargo_loads];
+
+        station->load_slots[_station_find_load_slot(station, last->cargo_type, last->origin)] = ind_load + 1;
+        station->cargo_loads[ind_load] = *last;
+    }
+
+    station->cargo_totals[cargo_type] = 0;
+
+    for (i = 0; i < station->num_cargo_loads; i++) {
+        if (station->cargo_loads[i].cargo_type == cargo_type) {
+            station->cargo_totals[cargo_type] = econ_add(station->cargo_totals[cargo_type], station->cargo_loads[i].amount);
+        }
+    }
+}
+
+/**
+ * @brief Works out how much a station's pickup rates decay over the periods since they were last updated.
+ *
+ * Periods in which the station was not looked at had no pickups, and
+ * only decay the rates further.
+ */
+static econ_t _station_pickup_decay(const struct station_t *const station) {
+    const int periods = economy_periods - station->pickup_period;
+
+    econ_t decay = ECON_ONE;
+    int i;
+
+    if (periods >= STATION_PICKUP_MEMORY) {
+        return 0;
+    }
+
+    for (i = 1; i < periods; i++) {
+        decay = econ_mul(decay, ECON_C(1.0 - STATION_PICKUP_SMOOTHING));
+    }
+
+    return decay;
+}
+
+/**
+ * @brief Works out a station's pickup rate of a cargo type, with the pickups of past periods folded in.
+ */
+static econ_t _station_folded_pickup_rate(const struct station_t *const station, cargo_handle_t cargo_type, econ_t decay) {
+    const econ_t rate = station->pickup_rate[cargo_type] + econ_mul(station->picked_up[cargo_type] - station->pickup_rate[cargo_type], ECON_C(STATION_PICKUP_SMOOTHING));
+
+    return econ_mul(rate, decay);
+}
+
+/**
+ * @brief Folds the pickups of past periods into a station's pickup rates.
+ */
+static void _station_update_pickups(struct station_t *const station) {
+    econ_t decay;
+    int i;
+
+    if (economy_periods <= station->pickup_period) {
+        return;
+    }
+
+    decay = _station_pickup_decay(station);
+
+    for (i = 0; i < num_cargo_types; i++) {
+        station->pickup_rate[i] = _station_folded_pickup_rate(station, i, decay);
+        station->picked_up[i] = 0;
+    }
+
+    station->pickup_period = economy_periods;
+}
+
+/**
+ * @brief Takes cargo out of the load in a load table slot.
+ *
+ * @return econ_t The amount actually taken.
+ */
+static econ_t _station_take_from_load(struct station_t *const station, unsigned int slot, econ_t amount) {
+    struct station_load_t *const load = &station->cargo_loads[station->load_slots[slot] - 1];
+
+    _station_update_pickups(station);
+
+    if (amount >= load->amount) {
+        amount = load->amount;
+        station->picked_up[load->cargo_type] = econ_add(station->picked_up[load->cargo_type], amount);
+        _station_remove_load(station, slot);
+
+        return amount;
+    }
+
+    load->amount -= amount;
+    station->cargo_totals[load->cargo_type] -= amount;
+    station->picked_up[load->cargo_type] = econ_add(station->picked_up[load->cargo_type], amount);
+
+    return amount;
+}
+
+/**
+ * @brief Empties a station of all cargo.
+ */
+static void _station_clear_loads(struct station_t *const station) {
+    int i;
+
+    station->num_cargo_loads = 0;
+
+    for (i = 0; i < STATION_LOAD_SLOTS; i++) {
+        station->load_slots[i] = 0;
+    }
+
+    for (i = 0; i < MAX_CARGO_TYPES; i++) {
+        station->cargo_totals[i] = 0;
+    }
+
+    for (i = 0; i < CARGO_MASK_WORDS; i++) {
+        station->dirty_cargo[i] = 0;
+    }
+}
+
+int station_exists(station_handle_t ind_station) {
+    return ind_station < num_stations && stations[ind_station].active;
+}
+
+station_handle_t station_build(size_t owner, float x, float y) {
+    station_handle_t ind_station;
     int i;
 
-    errcli(_station_check_index(ind_station, "station_add_cargo"));
+    // reuse the slot of a removed station, if there is any
+    for (ind_station = 0; ind_station < num_stations; ind_station++) {
+        if (!stations[ind_station].active) {
+            break;
+        }
+    }
+
+    if (ind_station >= MAX_STATIONS) {
+        errorac(ERR_STATION_MAXED, -1, "station_build");
+    }
+
+    struct station_t *const station = &stations[ind_station];
+
+    station->spot = make_owned_spot(x, y, SPOT_KIND_STATION, ind_station);
+
+    if (station->spot == (spot_handle_t) -1) {
+        return -1;
+    }
+
+    if (spot_link(station->spot, 0) < 0) {
+        free_spot(station->spot, 0);
+        return -1;
+    }
+
+    station->pos_x = x;
+    station->pos_y = y;
+    station->owner = owner;
+    station->active = 1;
+
+    _station_clear_loads(station);
+
+    for (i = 0; i < CARGO_MASK_WORDS; i++) {
+        station->loading[i] = 0;
+    }
+
+    for (i = 0; i < MAX_CARGO_TYPES; i++) {
+        station->pickup_rate[i] = 0;
+        station->picked_up[i] = 0;
+    }
+
+    station->pickup_period = economy_periods;
+
+    if (ind_station == num_stations) {
+        num_stations++;
+    }
+
+    industry_catchment_add_station(ind_station);
+    _station_mark_dirty(ind_station, -1);
+
+    return ind_station;
+}
+
+error_return_t station_remove(station_handle_t ind_station) {
+    errcli(_station_check_index(ind_station, "station_remove"));
+
+    vehicle_orders_remove_station(ind_station);
+    industry_catchment_remove_station(ind_station);
+    route_remove_station(ind_station);
+    free_spot(stations[ind_station].spot, 0);
+
+    stations[ind_station].active = 0;
+    _station_clear_loads(&stations[ind_station]);
+    _station_mark_dirty(ind_station, -1);
+
+    return 0;
+}
+
+int station_remove_owned(size_t owner) {
+    station_handle_t ind_station;
+    int num_removed = 0;
+
+    for (ind_station = 0; ind_station < num_stations; ind_station++) {
+        if (stations[ind_station].active && stations[ind_station].owner == owner) {
+            station_remove(ind_station);
+            num_removed++;
+        }
+    }
+
+    return num_removed;
+}
+
+error_return_t station_get_position(station_handle_t ind_station, float *x, float *y) {
+    errcli(_station_check_index(ind_station, "station_get_position"));
+
+    *x = stations[ind_station].pos_x;
+    *y = stations[ind_station].pos_y;
+
+    return 0;
+}
+
+error_return_t station_set_loading(station_handle_t ind_station, cargo_handle_t cargo_type, int loading) {
+    errcli(_station_check_index(ind_station, "station_set_loading"));
+
+    if (cargo_type >= num_cargo_types) {
+        erroric(ERR_BAD_MATERIAL, "station_set_loading");
+    }
+
+    unsigned int *const word = &stations[ind_station].loading[cargo_type / 32];
+    const unsigned int bit = 1u << (cargo_type % 32);
+
+    if (!(*word & bit) == !loading) {
+        // nothing changes
+        return 0;
+    }
+
+    if (loading) {
+        *word |= bit;
+    }
+
+    else {
+        *word &= ~bit;
+    }
+
+    industry_catchment_update_station(ind_station);
+    _station_mark_dirty(ind_station, cargo_type);
+
+    return 0;
+}
+
+int station_is_loading(station_handle_t ind_station, cargo_handle_t cargo_type) {
+    if (!station_exists(ind_station) || cargo_type >= num_cargo_types) {
+        return 0;
+    }
+
+    return (stations[ind_station].loading[cargo_type / 32] >> (cargo_type % 32)) & 1;
+}
+
+error_return_t station_add_cargo(station_handle_t ind_station, cargo_handle_t cargo_type, int origin, econ_t amount) {
+    return station_add_aged_cargo(ind_station, cargo_type, origin, amount, 0);
+}
+
+error_return_t station_add_aged_cargo(station_handle_t ind_station, cargo_handle_t cargo_type, int origin, econ_t amount, unsigned int age) {
+    errcli(_station_check_index(ind_station, "station_add_aged_cargo"));
+
+    COUNT(COUNTER_STATION_ADD_CARGO);
+
+    if (cargo_type >= num_cargo_types) {
+        erroric(ERR_BAD_MATERIAL, "station_add_aged_cargo");
+    }
+
+    if (age > CARGO_MAX_AGE) {
+        age = CARGO_MAX_AGE;
+    }
 
     struct station_load_t *load;
     struct station_t *station;
+    unsigned int slot;
+    econ_t before, total, shift;
 
     if (origin == -1) {
         origin = ind_station;
     }
 
     station = &stations[ind_station];
+    slot = _station_find_load_slot(station, cargo_type, origin);
 
-    for (i = 0; i < station->num_cargo_loads; i++) {
-        if (station->cargo_loads[i].cargo_type == cargo_type && station->cargo_loads[i].origin == origin) {
-            station->cargo_loads[i].amount += amount;
-            return 0;
+    if (station->load_slots[slot] == 0) {
+        // no such load yet
+        if (station->num_cargo_loads >= MAX_CARGO_LOADS) {
+            erroric(ERR_STATION_LOADS_FULL, "station_add_cargo");
         }
+
+        load = &station->cargo_loads[station->num_cargo_loads++];
+
+        load->amount = 0;
+        load->cargo_type = cargo_type;
+        load->origin = origin;
+        load->age = age;
+
+        station->load_slots[slot] = station->num_cargo_loads;
+    }
+
+    else {
+        load = &station->cargo_loads[station->load_slots[slot] - 1];
     }
 
-    load = &station->cargo_loads[station->num_cargo_loads++];
+    total = econ_add(load->amount, amount);
 
-    load->amount = amount;
-    load->cargo_type = cargo_type;
-    load->origin = origin;
+    if (load->age != age && total > 0) {
+        // average the ages, rounding to the nearest bucket; weighting by
+        // the share of the new cargo keeps the products small, so that
+        // large fixed-point loads never saturate
+        shift = econ_mul(econ_from_int((int) age - (int) load->age), econ_div(amount, total));
+        load->age += econ_to_int(shift + (shift < 0 ? -ECON_C(0.5) : ECON_C(0.5)));
+    }
+
+    before = load->amount;
+    load->amount = econ_add(before, amount);
+    station->cargo_totals[cargo_type] = econ_add(station->cargo_totals[cargo_type], amount);
+
+    _station_mark_dirty(ind_station, cargo_type);
+
+    replay_record(REPLAY_STATION_CARGO, ind_station, cargo_type, origin, age, amount, before, load->amount);
 
     return 0;
 }
 
-error_return_t station_get_cargo_amount(station_handle_t ind_station, cargo_handle_t cargo_type, float *amount) {
-    int i;
-
+error_return_t station_get_cargo_amount(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t *amount) {
     errcli(_station_check_index(ind_station, "station_get_cargo_amount"));
 
+    if (cargo_type >= num_cargo_types) {
+        erroric(ERR_BAD_MATERIAL, "station_get_cargo_amount");
+    }
+
+    *amount = stations[ind_station].cargo_totals[cargo_type];
+
+    return 0;
+}
+
+error_return_t station_get_load_amount(station_handle_t ind_station, cargo_handle_t cargo_type, int origin, econ_t *amount) {
+    errcli(_station_check_index(ind_station, "station_get_load_amount"));
+
     const struct station_t *station = &stations[ind_station];
+    unsigned int slot;
 
-    for (i = 0; i < station->num_cargo_loads; i++) {
-        if (station->cargo_loads[i].cargo_type == cargo_type) {
-            *amount += station->cargo_loads[i].amount;
+    if (origin == -1) {
+        origin = ind_station;
+    }
+
+    slot = _station_find_load_slot(station, cargo_type, origin);
+
+    *amount = station->load_slots[slot] != 0 ? station->cargo_loads[station->load_slots[slot] - 1].amount : 0;
+
+    return 0;
+}
+
+error_return_t station_get_load_age(station_handle_t ind_station, cargo_handle_t cargo_type, int origin, unsigned int *age) {
+    errcli(_station_check_index(ind_station, "station_get_load_age"));
+
+    const struct station_t *station = &stations[ind_station];
+    unsigned int slot;
+
+    if (origin == -1) {
+        origin = ind_station;
+    }
+
+    slot = _station_find_load_slot(station, cargo_type, origin);
+
+    *age = station->load_slots[slot] != 0 ? station->cargo_loads[station->load_slots[slot] - 1].age : 0;
+
+    return 0;
+}
+
+error_return_t station_get_pickup_rate(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t *rate) {
+    errcli(_station_check_index(ind_station, "station_get_pickup_rate"));
+
+    if (cargo_type >= num_cargo_types) {
+        erroric(ERR_BAD_MATERIAL, "station_get_pickup_rate");
+    }
+
+    _station_update_pickups(&stations[ind_station]);
+
+    *rate = stations[ind_station].pickup_rate[cargo_type];
+
+    return 0;
+}
+
+error_return_t station_peek_pickup_rate(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t *rate) {
+    errcli(_station_check_index(ind_station, "station_peek_pickup_rate"));
+
+    if (cargo_type >= num_cargo_types) {
+        erroric(ERR_BAD_MATERIAL, "station_peek_pickup_rate");
+    }
+
+    const struct station_t *const station = &stations[ind_station];
+
+    if (economy_periods <= station->pickup_period) {
+        *rate = station->pickup_rate[cargo_type];
+    }
+
+    else {
+        *rate = _station_folded_pickup_rate(station, cargo_type, _station_pickup_decay(station));
+    }
+
+    return 0;
+}
+
+void station_age_cargo(void) {
+    station_handle_t ind_station;
+    size_t i;
+
+    for (ind_station = 0; ind_station < num_stations; ind_station++) {
+        struct station_t *const station = &stations[ind_station];
+
+        if (!station->active) {
+            continue;
+        }
+
+        for (i = 0; i < station->num_cargo_loads; i++) {
+            if (station->cargo_loads[i].age < CARGO_MAX_AGE) {
+                station->cargo_loads[i].age++;
+            }
+        }
+    }
+}
+
+error_return_t station_take_cargo(station_handle_t ind_station, cargo_handle_t cargo_type, int origin, econ_t amount, econ_t *taken) {
+    errcli(_station_check_index(ind_station, "station_take_cargo"));
+
+    COUNT(COUNTER_STATION_TAKE_CARGO);
+
+    struct station_t *const station = &stations[ind_station];
+    unsigned int slot;
+
+    *taken = 0;
+
+    if (origin == -1) {
+        origin = ind_station;
+    }
+
+    slot = _station_find_load_slot(station, cargo_type, origin);
+
+    if (station->load_slots[slot] == 0 || amount <= 0) {
+        // nothing to take
+        return 0;
+    }
+
+    *taken = _station_take_from_load(station, slot, amount);
+    _station_mark_dirty(ind_station, cargo_type);
+
+    return 0;
+}
+
+error_return_t station_take_cargo_type(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t amount, struct cargo_parcel_t *parcel) {
+    errcli(_station_check_index(ind_station, "station_take_cargo_type"));
+
+    COUNT(COUNTER_STATION_TAKE_CARGO);
+
+    struct station_t *const station = &stations[ind_station];
+    const econ_t taken_before = parcel->amount;
+    size_t i = 0;
+
+    while (i < station->num_cargo_loads && amount > 0) {
+        const struct station_load_t *const load = &station->cargo_loads[i];
+        const size_t num_before = station->num_cargo_loads;
+
+        if (load->cargo_type != cargo_type) {
+            i++;
+            continue;
+        }
+
+        // cargo from removed stations counts as coming from here
+        const struct station_t *const origin = station_exists(load->origin) ? &stations[load->origin] : station;
+        const float age = load->age;
+        const econ_t took = _station_take_from_load(station, _station_find_load_slot(station, cargo_type, load->origin), amount);
+
+        cargo_parcel_merge(parcel, took, age, origin->pos_x, origin->pos_y);
+        amount -= took;
+
+        // an emptied load is replaced by the last one, which must be looked at too
+        if (station->num_cargo_loads == num_before) {
+            i++;
+        }
+    }
+
+    if (parcel->amount > taken_before) {
+        _station_mark_dirty(ind_station, cargo_type);
+    }
+
+    return 0;
+}
+
+error_return_t station_unload_cargo(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t amount, econ_t *accepted) {
+    errcli(_station_check_index(ind_station, "station_unload_cargo"));
+
+    if (cargo_type >= num_cargo_types) {
+        erroric(ERR_BAD_MATERIAL, "station_unload_cargo");
+    }
+
+    *accepted = amount > 0 ? industry_deliver_cargo(ind_station, cargo_type, amount) : 0;
+
+    return 0;
+}
+
+error_return_t station_unload_batch(station_handle_t ind_station, size_t num_cargos, const cargo_handle_t *cargo_types, const econ_t *amounts, econ_t *accepted) {
+    size_t i;
+
+    errcli(_station_check_index(ind_station, "station_unload_batch"));
+
+    for (i = 0; i < num_cargos; i++) {
+        if (cargo_types[i] >= num_cargo_types) {
+            erroric(ERR_BAD_MATERIAL, "station_unload_batch");
         }
     }
 
+    industry_deliver_batch(ind_station, num_cargos, cargo_types, amounts, accepted);
+
     return 0;
 }
+
+int station_is_dirty(station_handle_t ind_station) {
+    if (ind_station >= MAX_STATIONS) {
+        return 0;
+    }
+
+    return (station_dirty[ind_station / 32] >> (ind_station % 32)) & 1;
+}
+
+station_handle_t station_next_dirty(station_handle_t ind_station) {
+    for (; ind_station < num_stations; ind_station++) {
+        if (station_dirty[ind_station / 32] == 0) {
+            // skip to the next word
+            ind_station |= 31;
+            continue;
+        }
+
+        if (station_is_dirty(ind_station)) {
+            return ind_station;
+        }
+    }
+
+    return -1;
+}
+
+int station_is_cargo_dirty(station_handle_t ind_station, cargo_handle_t cargo_type) {
+    if (!station_is_dirty(ind_station) || cargo_type >= MAX_CARGO_TYPES) {
+        return 0;
+    }
+
+    return (stations[ind_station].dirty_cargo[cargo_type / 32] >> (cargo_type % 32)) & 1;
+}
+
+void station_clear_dirty(void) {
+    station_handle_t ind_station;
+    int i;
+
+    for (ind_station = station_next_dirty(0); ind_station != (station_handle_t) -1; ind_station = station_next_dirty(ind_station + 1)) {
+        for (i = 0; i < CARGO_MASK_WORDS; i++) {
+            stations[ind_station].dirty_cargo[i] = 0;
+        }
+    }
+
+    for (i = 0; i < STATION_MASK_WORDS; i++) {
+        station_dirty[i] = 0;
+    }
+}
+
+const struct snapshot_region_t *station_snapshot_regions(size_t *num_regions) {
+    *num_regions = sizeof(station_snapshot) / sizeof(*station_snapshot);
+
+    return station_snapshot;
+}
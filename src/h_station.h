@@ -13,6 +13,8 @@
 
 #include <stddef.h>
 #include "m_error.h"
+#include "m_profile.h"
+#include "m_snapshot.h"
 #include "h_cargo.h"
 
 /**
@@ -20,16 +22,54 @@
  */
 #define MAX_CARGO_LOADS 32
 
+/**
+ * @brief The size of each station's cargo load table.
+ *
+ * Must be a power of two. At twice MAX_CARGO_LOADS, the table is never
+ * more than half full, so lookups stay short without ever growing it.
+ */
+#define STATION_LOAD_SLOTS (MAX_CARGO_LOADS * 2)
+
 /**
  * @brief The maximum number of stations in the entire world.
  */
+#ifndef MAX_STATIONS
 #define MAX_STATIONS 128
+#endif
+
+/**
+ * @brief How much the last period's pickups weigh into a station's pickup rate.
+ *
+ * The pickup rate is an exponential moving average over periods; the
+ * higher this is, the sooner it follows changes in service.
+ */
+#define STATION_PICKUP_SMOOTHING 0.25
+
+/**
+ * @brief After how many periods without any pickups a station's pickup rate drops to 0.
+ */
+#define STATION_PICKUP_MEMORY 16
+
+/**
+ * @brief The number of words in a bitmask with one bit per cargo type.
+ */
+#define CARGO_MASK_WORDS ((MAX_CARGO_TYPES + 31) / 32)
+
+/**
+ * @brief The number of words in a bitmask with one bit per station.
+ */
+#define STATION_MASK_WORDS ((MAX_STATIONS + 31) / 32)
 
 /**
  * @brief An index handle to a station.
  */
 typedef size_t station_handle_t;
 
+/**
+ * @brief The owner of a station that belongs to no company.
+ */
+#define STATION_NO_OWNER ((size_t) -1)
+
 /**
  * @brief A distinct load of cargo in a station.
  *
@@ -49,7 +89,7 @@ struct station_load_t {
     /**
      * @brief Amount of cargo in this load, in Cargo Units.
      */
-    float   amount;
+    econ_t  amount;
 
     /**
      * @brief Index of the origin station.
@@ -58,6 +98,16 @@ struct station_load_t {
      * 'load' originated.
      */
     size_t  origin;
+
+    /**
+     * @brief Age of the cargo in this load, in age buckets.
+     *
+     * Cargo added to an existing load is averaged into its age,
+     * weighted by amount.
+     *
+     * @see CARGO_AGE_BUCKET_TICS
+     */
+    unsigned char age;
 };
 
 /**
@@ -84,6 +134,14 @@ struct station_t {
      */
     float pos_y;
 
+    /**
+     * @brief The company that owns this station, or STATION_NO_OWNER.
+     *
+     * Only the owner's assets go away with it; vehicles of any company
+     * may still call at the station.
+     */
+    size_t owner;
+
     /**
      * @brief All cargo loads in this station.
      *
@@ -95,31 +153,364 @@ struct station_t {
      * @brief The number of cargo loads in this station.
      */
     size_t num_cargo_loads;
+
+    /**
+     * @brief Open-addressed table of cargo loads, by cargo type and origin.
+     *
+     * Each slot holds an index into cargo_loads plus one, or 0 if it
+     * is empty. Hashed by cargo type and origin, with linear probing.
+     */
+    unsigned char load_slots[STATION_LOAD_SLOTS];
+
+    /**
+     * @brief Total amount of cargo in this station, by cargo type.
+     *
+     * The sum of the amounts of all loads of each cargo type, kept up
+     * to date as cargo is added.
+     */
+    econ_t cargo_totals[MAX_CARGO_TYPES];
+
+    /**
+     * @brief Cargo types whose amount changed here since the dirty state was last cleared.
+     *
+     * A bitmask like 'loading'.
+     *
+     * @see station_clear_dirty
+     */
+    unsigned int dirty_cargo[CARGO_MASK_WORDS];
+
+    /**
+     * @brief How much cargo vehicles pick up here per period, by cargo type.
+     *
+     * A moving average, in Cargo Units per period, only brought up to
+     * date when the station is next looked at in a later period.
+     *
+     * @see STATION_PICKUP_SMOOTHING
+     */
+    econ_t pickup_rate[MAX_CARGO_TYPES];
+
+    /**
+     * @brief How much cargo vehicles picked up here so far this period, by cargo type.
+     */
+    econ_t picked_up[MAX_CARGO_TYPES];
+
+    /**
+     * @brief The economy period picked_up was counted in.
+     */
+    int pickup_period;
+
+    /**
+     * @brief Cargo types loaded at this station, as a bitmask.
+     *
+     * Bit (cargo_type % 32) of word (cargo_type / 32) is set if
+     * cargo of that type is loaded here; only then do reachable
+     * industries distribute their produced cargo of that type into
+     * this station.
+     */
+    unsigned int loading[CARGO_MASK_WORDS];
+
+    /**
+     * @brief The spot standing for this station in the spotmap.
+     */
+    size_t spot;
+
+    /**
+     * @brief Whether this station exists.
+     *
+     * Removed stations leave their slot behind, to be reused by the
+     * next station built; this keeps handles to other stations stable.
+     */
+    unsigned char active;
 };
 
+/**
+ * @brief The number of station slots in use, including removed ones.
+ *
+ * Only handles below this value may refer to a station.
+ */
+extern int num_stations;
+
+/**
+ * @brief Checks whether a station exists.
+ *
+ * @param ind_station The station handle to check.
+ * @return int 1 if a station exists with this handle, else 0.
+ */
+int station_exists(station_handle_t ind_station);
+
+/**
+ * @brief Builds a new, empty station at a position.
+ *
+ * @param owner The company that owns the new station, or STATION_NO_OWNER.
+ * @param x X coordinate of the position of the new station.
+ * @param y Y coordinate of the position of the new station.
+ * @return station_handle_t The handle of the new station, or -1 on error.
+ */
+station_handle_t station_build(size_t owner, float x, float y);
+
+/**
+ * @brief Removes a station from the world.
+ *
+ * Any cargo waiting in it is lost. The handle may later be reused by
+ * another station.
+ *
+ * @param ind_station The station to remove.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t station_remove(station_handle_t ind_station);
+
+/**
+ * @brief Removes every station a company owns.
+ *
+ * Goes through every station slot, so only meant for rare events,
+ * such as a company being dissolved.
+ *
+ * @param owner The company whose stations to remove.
+ * @return int The number of stations removed.
+ */
+int station_remove_owned(size_t owner);
+
+/**
+ * @brief Gets the position of a station.
+ *
+ * @param ind_station The station whose position to get.
+ * @param x A pointer to a float in the which to store the X coordinate.
+ * @param y A pointer to a float in the which to store the Y coordinate.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t station_get_position(station_handle_t ind_station, float *x, float *y);
+
+/**
+ * @brief Sets whether a cargo type is loaded at this station.
+ *
+ * @param ind_station The station to flag.
+ * @param cargo_type The cargo type to flag.
+ * @param loading 1 if cargo of this type should be loaded here, else 0.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t station_set_loading(station_handle_t ind_station, cargo_handle_t cargo_type, int loading);
+
+/**
+ * @brief Checks whether a cargo type is loaded at this station.
+ *
+ * @param ind_station The station to check.
+ * @param cargo_type The cargo type to check for.
+ * @return int 1 if the cargo type is loaded here, else 0.
+ */
+int station_is_loading(station_handle_t ind_station, cargo_handle_t cargo_type);
+
 /**
  * @brief Add an amount of a cargo type to this station.
  *
+ * Cargo is added to the load with the same cargo type and origin, if
+ * there is one; otherwise a new load is made. If the station already
+ * holds MAX_CARGO_LOADS loads, cargo that would need a new one is
+ * refused, and nothing changes.
+ *
  * @param ind_station The station to the which to add cargo.
  * @param cargo_type The type of the cargo to be added.
  * @param origin The origin of the cargo, or -1 to default to the station itself.
  * @param amount The amount of cargo to add.
  * @return error_return_t 0 if successful, an error code otherwise.
  */
-error_return_t station_add_cargo(station_handle_t ind_station, cargo_handle_t cargo_type, int origin, float amount);
+error_return_t station_add_cargo(station_handle_t ind_station, cargo_handle_t cargo_type, int origin, econ_t amount);
 
 /**
  * @brief Get the amount of cargo of a specific type in this station.
  *
  * Precisely, this function returns the sum of the amounts of all cargo
- * loads with a matching cargo type.
+ * loads with a matching cargo type. This is kept as a running total,
+ * so it costs the same regardless of how many loads there are.
+ *
+ * @param ind_station The station on the which to query for cargo.
+ * @param cargo_type The type of cargo to be queried.
+ * @param amount A pointer to an amount in the which to store the amount.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t station_get_cargo_amount(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t *amount);
+
+/**
+ * @brief Add an amount of cargo of a given age to this station.
+ *
+ * Same as station_add_cargo, for cargo that has already aged, such as
+ * cargo being transferred between vehicles. Cargo added with
+ * station_add_cargo is fresh, i.e. of age 0.
+ *
+ * @param ind_station The station to the which to add cargo.
+ * @param cargo_type The type of the cargo to be added.
+ * @param origin The origin of the cargo, or -1 to default to the station itself.
+ * @param amount The amount of cargo to add.
+ * @param age The age of the cargo, in age buckets.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t station_add_aged_cargo(station_handle_t ind_station, cargo_handle_t cargo_type, int origin, econ_t amount, unsigned int age);
+
+/**
+ * @brief Take an amount of cargo of a type and origin out of this station.
+ *
+ * Takes at most as much cargo as the load with this cargo type and
+ * origin holds. Loads that are emptied are removed.
+ *
+ * @param ind_station The station from the which to take cargo.
+ * @param cargo_type The type of the cargo to be taken.
+ * @param origin The origin of the cargo, or -1 for the station itself.
+ * @param amount The amount of cargo to take, at most.
+ * @param taken A pointer to an amount in the which to store the amount actually taken.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t station_take_cargo(station_handle_t ind_station, cargo_handle_t cargo_type, int origin, econ_t amount, econ_t *taken);
+
+/**
+ * @brief Take an amount of cargo of a type out of this station, regardless of origin.
+ *
+ * Cargo is taken from the oldest loads first. Loads that are emptied
+ * are removed. All cargo taken is merged into a parcel, along with its
+ * age and the position of its origin station.
+ *
+ * @param ind_station The station from the which to take cargo.
+ * @param cargo_type The type of the cargo to be taken.
+ * @param amount The amount of cargo to take, at most.
+ * @param parcel The parcel in the which to put the cargo taken.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t station_take_cargo_type(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t amount, struct cargo_parcel_t *parcel);
+
+/**
+ * @brief Unload cargo at this station, into the industries in reach that accept it.
+ *
+ * This is where vehicles hand over the cargo they carry. Whatever is
+ * not accepted by any industry is not unloaded, and should stay where
+ * it came from.
+ *
+ * @param ind_station The station at the which to unload cargo.
+ * @param cargo_type The type of the cargo to be unloaded.
+ * @param amount The amount of cargo to unload.
+ * @param accepted A pointer to an amount in the which to store the amount accepted.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t station_unload_cargo(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t amount, econ_t *accepted);
+
+/**
+ * @brief Unload several cargo types at this station at once, e.g. every compartment of a vehicle.
+ *
+ * Like station_unload_cargo for each of them, but cheaper, as the
+ * industries in reach are only looked up once.
+ *
+ * @param ind_station The station at the which to unload cargo.
+ * @param num_cargos The number of cargo types to unload.
+ * @param cargo_types The type of each cargo to be unloaded.
+ * @param amounts The amount of each cargo to unload.
+ * @param accepted Where to store the amount of each cargo accepted.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t station_unload_batch(station_handle_t ind_station, size_t num_cargos, const cargo_handle_t *cargo_types, const econ_t *amounts, econ_t *accepted);
+
+/**
+ * @brief Get the amount of cargo of a specific type and origin in this station.
  *
  * @param ind_station The station on the which to query for cargo.
  * @param cargo_type The type of cargo to be queried.
- * @param amount A pointer to a float in the which to store the amount.
+ * @param origin The origin of the cargo, or -1 for the station itself.
+ * @param amount A pointer to an amount in the which to store the amount; 0 if there is no such load.
  * @return error_return_t 0 if successful, an error code otherwise.
  */
-error_return_t station_get_cargo_amount(station_handle_t ind_station, cargo_handle_t cargo_type, float *amount);
+error_return_t station_get_load_amount(station_handle_t ind_station, cargo_handle_t cargo_type, int origin, econ_t *amount);
+
+/**
+ * @brief Get the age of the cargo of a specific type and origin in this station.
+ *
+ * @param ind_station The station on the which to query for cargo.
+ * @param cargo_type The type of cargo to be queried.
+ * @param origin The origin of the cargo, or -1 for the station itself.
+ * @param age A pointer in the which to store the age, in age buckets; 0 if there is no such load.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t station_get_load_age(station_handle_t ind_station, cargo_handle_t cargo_type, int origin, unsigned int *age);
+
+/**
+ * @brief Ages all cargo waiting in all stations by one age bucket.
+ *
+ * Called by the economy scheduler once every CARGO_AGE_BUCKET_TICS
+ * tics, which is the only time cargo ages at all.
+ */
+void station_age_cargo(void);
+
+/**
+ * @brief Gets how much of a cargo type vehicles recently picked up at a station.
+ *
+ * Only cargo taken out by station_take_cargo and
+ * station_take_cargo_type counts as picked up.
+ *
+ * @param ind_station The station to query.
+ * @param cargo_type The cargo type to query.
+ * @param rate A pointer to an amount in the which to store the pickup rate, in Cargo Units per period.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t station_get_pickup_rate(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t *rate);
+
+/**
+ * @brief Gets a station's pickup rate of a cargo type, without writing to the station.
+ *
+ * Gives the very same rate as station_get_pickup_rate, but leaves
+ * bringing the station's rates up to date to whatever looks at it
+ * next, so that it may be called from several threads at once.
+ *
+ * @param ind_station The station to query.
+ * @param cargo_type The cargo type to query.
+ * @param rate A pointer to an amount in the which to store the pickup rate, in Cargo Units per period.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t station_peek_pickup_rate(station_handle_t ind_station, cargo_handle_t cargo_type, econ_t *rate);
+
+
+// -- Dirty tracking
+
+/**
+ * @brief Checks whether a station changed since the dirty state was last cleared.
+ *
+ * A station changes when it is built or removed, when cargo is added
+ * to or taken from it, and when the cargo types it loads change. UI
+ * and sync code can use this to only refresh what changed.
+ *
+ * @param ind_station The station to check.
+ * @return int 1 if the station changed, else 0.
+ */
+int station_is_dirty(station_handle_t ind_station);
+
+/**
+ * @brief Finds the next station that changed since the dirty state was last cleared.
+ *
+ * The station may have been removed since; check with station_exists.
+ *
+ * @param ind_station The station handle to start looking from, inclusive.
+ * @return station_handle_t The first changed station at or after ind_station, or -1 if none.
+ */
+station_handle_t station_next_dirty(station_handle_t ind_station);
+
+/**
+ * @brief Checks whether the amount of a cargo type in a station changed since the dirty state was last cleared.
+ *
+ * @param ind_station The station to check.
+ * @param cargo_type The cargo type to check.
+ * @return int 1 if it changed, else 0.
+ */
+int station_is_cargo_dirty(station_handle_t ind_station, cargo_handle_t cargo_type);
+
+/**
+ * @brief Marks every station and cargo type as unchanged.
+ *
+ * Meant to be called once per frame, after everything interested in
+ * changes has looked at them.
+ */
+void station_clear_dirty(void);
+
+/**
+ * @brief Gets the station tables, as snapshot regions.
+ *
+ * @param num_regions Where to store the number of regions.
+ * @return const struct snapshot_region_t* The regions, in a fixed order.
+ */
+const struct snapshot_region_t *station_snapshot_regions(size_t *num_regions);
 
 
 #endif // STATIONS_H
@@ -0,0 +1,715 @@
+/**
+ * @file h_vehicle.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Vehicle logic.
+ * @version added in 0.1
+ * @date 2021-03-15
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * How vehicles follow their orders, and move cargo between stations.
+ */
+
+#include "h_vehicle.h"
+#include "h_company.h"
+#include "h_route.h"
+
+
+/**
+ * @brief All vehicles in the world.
+ */
+static struct vehicle_t vehicles[MAX_VEHICLES];
+
+int num_vehicles;
+
+/**
+ * @brief Handles of removed vehicles, whose slots are free to be reused.
+ */
+static vehicle_handle_t vehicle_free[MAX_VEHICLES];
+
+/**
+ * @brief The number of items in vehicle_free.
+ */
+static int num_vehicle_free;
+
+/**
+ * @brief Vehicles waiting to arrive or depart, as a binary min-heap.
+ *
+ * Ordered by event tic, then by handle, so that vehicles due in the
+ * same tic are always handled in the same order.
+ */
+static vehicle_handle_t vehicle_queue[MAX_VEHICLES];
+
+/**
+ * @brief The number of vehicles in vehicle_queue.
+ */
+static int vehicle_queue_length;
+
+/**
+ * @brief Hashes of the blocks of the vehicle tables, as of the last snapshot.
+ */
+static unsigned int vehicle_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(vehicles))];
+static unsigned int vehicle_free_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(vehicle_free))];
+static unsigned int vehicle_queue_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(vehicle_queue))];
+
+static const struct snapshot_region_t vehicle_snapshot[] = {
+    SNAPSHOT_REGION(vehicles, vehicle_snapshot_hashes),
+    SNAPSHOT_REGION(num_vehicles, NULL),
+    SNAPSHOT_REGION(vehicle_free, vehicle_free_snapshot_hashes),
+    SNAPSHOT_REGION(num_vehicle_free, NULL),
+    SNAPSHOT_REGION(vehicle_queue, vehicle_queue_snapshot_hashes),
+    SNAPSHOT_REGION(vehicle_queue_length, NULL)
+};
+
+/**
+ * @brief Whether vehicles are held where they are (see vehicle_hold).
+ */
+static int vehicle_held = 0;
+
+/**
+ * @brief The tic vehicles were held at.
+ */
+static int vehicle_held_tic;
+
+
+/**
+ * @brief Gets the tic vehicles are at, which stands still while they are held.
+ */
+static int _vehicle_now(void) {
+    return vehicle_held ? vehicle_held_tic : acs_timer();
+}
+
+static error_return_t _vehicle_check_index(vehicle_handle_t ind_vehicle, const char *const ctx) {
+    if (ind_vehicle >= num_vehicles || !vehicles[ind_vehicle].active) {
+        erroric(ERR_VEHICLE_BAD_INDEX, ctx);
+    }
+
+    return 0;
+}
+
+static int _vehicle_queue_before(vehicle_handle_t a, vehicle_handle_t b) {
+    if (vehicles[a].event_tic != vehicles[b].event_tic) {
+        return vehicles[a].event_tic < vehicles[b].event_tic;
+    }
+
+    return a < b;
+}
+
+static void _vehicle_queue_set(int index, vehicle_handle_t ind_vehicle) {
+    vehicle_queue[index] = ind_vehicle;
+    vehicles[ind_vehicle].queue_index = index;
+}
+
+static void _vehicle_queue_up(int index) {
+    const vehicle_handle_t ind_vehicle = vehicle_queue[index];
+
+    while (index > 0 && _vehicle_queue_before(ind_vehicle, vehicle_queue[(index - 1) / 2])) {
+        _vehicle_queue_set(index, vehicle_queue[(index - 1) / 2]);
+        index = (index - 1) / 2;
+    }
+
+    _vehicle_queue_set(index, ind_vehicle);
+}
+
+static void _vehicle_queue_down(int index) {
+    const vehicle_handle_t ind_vehicle = vehicle_queue[index];
+    int child;
+
+    for (;;) {
+        child = index * 2 + 1;
+
+        if (child >= vehicle_queue_length) {
+            break;
+        }
+
+        if (child + 1 < vehicle_queue_length && _vehicle_queue_before(vehicle_queue[child + 1], vehicle_queue[child])) {
+            child++;
+        }
+
+        if (!_vehicle_queue_before(vehicle_queue[child], ind_vehicle)) {
+            break;
+        }
+
+        _vehicle_queue_set(index, vehicle_queue[child]);
+        index = child;
+    }
+
+    _vehicle_queue_set(index, ind_vehicle);
+}
+
+/**
+ * @brief Queues a vehicle for its next event.
+ */
+static void _vehicle_queue_push(vehicle_handle_t ind_vehicle) {
+    vehicle_queue[vehicle_queue_length] = ind_vehicle;
+    _vehicle_queue_up(vehicle_queue_length++);
+}
+
+/**
+ * @brief Takes a vehicle out of the event queue, if it is there.
+ */
+static void _vehicle_queue_remove(vehicle_handle_t ind_vehicle) {
+    const int index = vehicles[ind_vehicle].queue_index;
+
+    if (index < 0) {
+        return;
+    }
+
+    vehicles[ind_vehicle].queue_index = -1;
+
+    if (index == --vehicle_queue_length) {
+        return;
+    }
+
+    // the last item takes its place, and may have to move either way
+    _vehicle_queue_set(index, vehicle_queue[vehicle_queue_length]);
+
+    if (index > 0 && _vehicle_queue_before(vehicle_queue[index], vehicle_queue[(index - 1) / 2])) {
+        _vehicle_queue_up(index);
+    }
+
+    else {
+        _vehicle_queue_down(index);
+    }
+}
+
+/**
+ * @brief Approximates the straight distance covered by an offset.
+ *
+ * Octile distance; off by 8% at the very most, and needs no sqrt.
+ */
+static float _vehicle_distance(float dx, float dy) {
+    if (dx < 0.0) {
+        dx = -dx;
+    }
+
+    if (dy < 0.0) {
+        dy = -dy;
+    }
+
+    return dx > dy ? dx + 0.41421356 * dy : dy + 0.41421356 * dx;
+}
+
+/**
+ * @brief Walks the links between the stations in a vehicle's orders, adding or removing the vehicle in each.
+ *
+ * Stops after limit links, unless limit is -1, or at the first link
+ * that cannot be added; done is set to the number of links handled.
+ */
+static error_return_t _vehicle_route_walk(const struct vehicle_t *const vehicle, int remove, int limit, int *done) {
+    const struct vehicle_order_t *from, *to;
+    size_t i, j;
+    float from_x, from_y, to_x, to_y, travel;
+
+    *done = 0;
+
+    if (vehicle->num_orders < 2) {
+        return 0;
+    }
+
+    for (i = 0; i < vehicle->num_orders; i++) {
+        from = &vehicle->orders[i];
+        to = &vehicle->orders[(i + 1) % vehicle->num_orders];
+
+        if (station_get_position(from->station, &from_x, &from_y) < 0 || station_get_position(to->station, &to_x, &to_y) < 0) {
+            continue;
+        }
+
+        travel = _vehicle_distance(to_x - from_x, to_y - from_y) / vehicle->speed;
+
+        for (j = 0; j < vehicle->num_compartments; j++) {
+            if (*done == limit) {
+                return 0;
+            }
+
+            if (remove) {
+                route_link_remove(from->station, to->station, vehicle->compartments[j].cargo_type, econ_to_float(vehicle->compartments[j].capacity), travel);
+            }
+
+            else {
+                errcli(route_link_add(from->station, to->station, vehicle->compartments[j].cargo_type, econ_to_float(vehicle->compartments[j].capacity), travel));
+            }
+
+            (*done)++;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Adds a vehicle to, or takes it out of, the links between the stations in its orders.
+ *
+ * Called with remove set before the orders or compartments of a
+ * vehicle change, and with it unset after, so that the links always
+ * match what the vehicle actually carries where. If any link cannot
+ * be added, those that were are taken back out, and the vehicle is
+ * left out of the graph altogether.
+ */
+static error_return_t _vehicle_route(struct vehicle_t *const vehicle, int remove) {
+    int added, undone;
+
+    if (remove) {
+        if (vehicle->routed) {
+            _vehicle_route_walk(vehicle, 1, -1, &undone);
+            vehicle->routed = 0;
+        }
+
+        return 0;
+    }
+
+    if (vehicle->routed) {
+        return 0;
+    }
+
+    iferr(_vehicle_route_walk(vehicle, 0, -1, &added)) {
+        _vehicle_route_walk(vehicle, 1, added, &undone);
+        return _err;
+    }
+
+    vehicle->routed = 1;
+
+    return 0;
+}
+
+/**
+ * @brief Sets off a vehicle to the station of its current order.
+ *
+ * Orders whose station no longer exists are skipped; if none of them
+ * exist, the vehicle becomes idle where it is.
+ */
+static void _vehicle_depart(vehicle_handle_t ind_vehicle, int now) {
+    struct vehicle_t *const vehicle = &vehicles[ind_vehicle];
+
+    size_t tries;
+    float x, y, travel;
+
+    for (tries = 0; tries < vehicle->num_orders; tries++) {
+        if (station_get_position(vehicle->orders[vehicle->current_order].station, &x, &y) == 0) {
+            break;
+        }
+
+        vehicle->current_order = (vehicle->current_order + 1) % vehicle->num_orders;
+    }
+
+    if (tries == vehicle->num_orders) {
+        vehicle->state = VEHICLE_STATE_IDLE;
+        return;
+    }
+
+    travel = _vehicle_distance(x - vehicle->from_x, y - vehicle->from_y) / vehicle->speed;
+
+    vehicle->to_x = x;
+    vehicle->to_y = y;
+    vehicle->state = VEHICLE_STATE_MOVING;
+    vehicle->depart_tic = now;
+    vehicle->event_tic = now + (int) travel + 1;
+
+    _vehicle_queue_push(ind_vehicle);
+}
+
+/**
+ * @brief Unloads a vehicle's cargo at a station, paying its owner for what is delivered.
+ */
+static void _vehicle_unload(struct vehicle_t *const vehicle, station_handle_t ind_station) {
+    struct vehicle_compartment_t *compartment;
+    cargo_handle_t cargo_types[MAX_VEHICLE_COMPARTMENTS];
+    econ_t amounts[MAX_VEHICLE_COMPARTMENTS], accepted[MAX_VEHICLE_COMPARTMENTS];
+    size_t i;
+    float dx, dy;
+
+    // hand every compartment over at once; empty ones are left alone
+    for (i = 0; i < vehicle->num_compartments; i++) {
+        cargo_types[i] = vehicle->compartments[i].cargo_type;
+        amounts[i] = vehicle->compartments[i].cargo.amount;
+    }
+
+    errclv(station_unload_batch(ind_station, vehicle->num_compartments, cargo_types, amounts, accepted));
+
+    for (i = 0; i < vehicle->num_compartments; i++) {
+        compartment = &vehicle->compartments[i];
+
+        if (accepted[i] <= 0) {
+            // not accepted here; keep it
+            continue;
+        }
+
+        // payment goes by manhattan distance, as in OpenTTD
+        dx = vehicle->to_x - compartment->cargo.origin_x;
+        dy = vehicle->to_y - compartment->cargo.origin_y;
+
+        company_post(vehicle->owner, LEDGER_CARGO_INCOME, cargo_delivery_payment(
+            compartment->cargo_type,
+            accepted[i],
+            (dx < 0.0 ? -dx : dx) + (dy < 0.0 ? -dy : dy),
+            compartment->cargo.age
+        ));
+
+        compartment->cargo.amount -= accepted[i];
+
+        if (compartment->cargo.amount <= 0) {
+            compartment->cargo.amount = 0;
+            compartment->cargo.age = 0.0;
+        }
+    }
+}
+
+/**
+ * @brief Fills a vehicle's compartments with cargo from a station.
+ */
+static void _vehicle_load(struct vehicle_t *const vehicle, station_handle_t ind_station) {
+    struct vehicle_compartment_t *compartment;
+    size_t i;
+
+    for (i = 0; i < vehicle->num_compartments; i++) {
+        compartment = &vehicle->compartments[i];
+
+        if (compartment->cargo.amount < compartment->capacity) {
+            station_take_cargo_type(ind_station, compartment->cargo_type, compartment->capacity - compartment->cargo.amount, &compartment->cargo);
+        }
+    }
+}
+
+/**
+ * @brief Stops a vehicle at the station of its current order, and carries the order out.
+ */
+static void _vehicle_arrive(vehicle_handle_t ind_vehicle, int now) {
+    struct vehicle_t *const vehicle = &vehicles[ind_vehicle];
+    const struct vehicle_order_t *const order = &vehicle->orders[vehicle->current_order];
+
+    vehicle->from_x = vehicle->to_x;
+    vehicle->from_y = vehicle->to_y;
+    vehicle->state = VEHICLE_STATE_STOPPED;
+    vehicle->event_tic = now + VEHICLE_STOP_TICS;
+
+    // the station may have been removed on the way
+    if (station_exists(order->station)) {
+        if (order->flags & ORDER_UNLOAD) {
+            _vehicle_unload(vehicle, order->station);
+        }
+
+        if (order->flags & ORDER_LOAD) {
+            _vehicle_load(vehicle, order->station);
+        }
+    }
+
+    _vehicle_queue_push(ind_vehicle);
+}
+
+int vehicle_exists(vehicle_handle_t ind_vehicle) {
+    return ind_vehicle < num_vehicles && vehicles[ind_vehicle].active;
+}
+
+vehicle_handle_t vehicle_build(size_t owner, float x, float y, float speed) {
+    vehicle_handle_t ind_vehicle;
+
+    if (!company_exists(owner)) {
+        errorac(ERR_COMPANY_BAD_INDEX, -1, "vehicle_build");
+    }
+
+    if (num_vehicle_free > 0) {
+        ind_vehicle = vehicle_free[--num_vehicle_free];
+    }
+
+    else if (num_vehicles < MAX_VEHICLES) {
+        ind_vehicle = num_vehicles++;
+    }
+
+    else {
+        errorac(ERR_VEHICLE_MAXED, -1, "vehicle_build");
+    }
+
+    struct vehicle_t *const vehicle = &vehicles[ind_vehicle];
+
+    vehicle->active = 1;
+    vehicle->routed = 0;
+    vehicle->state = VEHICLE_STATE_IDLE;
+    vehicle->owner = owner;
+    vehicle->speed = speed > 0.0 ? speed : 1.0;
+    vehicle->from_x = vehicle->to_x = x;
+    vehicle->from_y = vehicle->to_y = y;
+    vehicle->depart_tic = vehicle->event_tic = 0;
+    vehicle->queue_index = -1;
+    vehicle->num_orders = 0;
+    vehicle->current_order = 0;
+    vehicle->num_compartments = 0;
+
+    return ind_vehicle;
+}
+
+error_return_t vehicle_remove(vehicle_handle_t ind_vehicle) {
+    errcli(_vehicle_check_index(ind_vehicle, "vehicle_remove"));
+
+    _vehicle_queue_remove(ind_vehicle);
+    _vehicle_route(&vehicles[ind_vehicle], 1);
+
+    vehicles[ind_vehicle].active = 0;
+    vehicle_free[num_vehicle_free++] = ind_vehicle;
+
+    return 0;
+}
+
+int vehicle_remove_owned(size_t owner) {
+    vehicle_handle_t ind_vehicle;
+    int num_removed = 0;
+
+    for (ind_vehicle = 0; ind_vehicle < num_vehicles; ind_vehicle++) {
+        if (vehicles[ind_vehicle].active && vehicles[ind_vehicle].owner == owner) {
+            vehicle_remove(ind_vehicle);
+            num_removed++;
+        }
+    }
+
+    return num_removed;
+}
+
+error_return_t vehicle_add_compartment(vehicle_handle_t ind_vehicle, cargo_handle_t cargo_type, econ_t capacity) {
+    errcli(_vehicle_check_index(ind_vehicle, "vehicle_add_compartment"));
+
+    struct vehicle_t *const vehicle = &vehicles[ind_vehicle];
+    struct vehicle_compartment_t *compartment;
+
+    if (cargo_type >= num_cargo_types) {
+        erroric(ERR_BAD_MATERIAL, "vehicle_add_compartment");
+    }
+
+    if (vehicle->num_compartments >= MAX_VEHICLE_COMPARTMENTS) {
+        erroric(ERR_VEHICLE_COMPARTMENTS_FULL, "vehicle_add_compartment");
+    }
+
+    _vehicle_route(vehicle, 1);
+
+    compartment = &vehicle->compartments[vehicle->num_compartments++];
+
+    compartment->cargo_type = cargo_type;
+    compartment->capacity = capacity;
+    compartment->cargo.amount = 0;
+    compartment->cargo.age = 0.0;
+    compartment->cargo.origin_x = 0.0;
+    compartment->cargo.origin_y = 0.0;
+
+    iferr(_vehicle_route(vehicle, 0)) {
+        const error_return_t failed = _err;
+
+        // its links would not fit; keep the vehicle as it was
+        vehicle->num_compartments--;
+        _vehicle_route(vehicle, 0);
+
+        return failed;
+    }
+
+    return 0;
+}
+
+error_return_t vehicle_add_order(vehicle_handle_t ind_vehicle, station_handle_t ind_station, unsigned char flags) {
+    errcli(_vehicle_check_index(ind_vehicle, "vehicle_add_order"));
+
+    struct vehicle_t *const vehicle = &vehicles[ind_vehicle];
+
+    if (!station_exists(ind_station)) {
+        erroric(ERR_STATION_BAD_INDEX, "vehicle_add_order");
+    }
+
+    if (vehicle->num_orders >= MAX_VEHICLE_ORDERS) {
+        erroric(ERR_VEHICLE_ORDERS_FULL, "vehicle_add_order");
+    }
+
+    _vehicle_route(vehicle, 1);
+
+    vehicle->orders[vehicle->num_orders].station = ind_station;
+    vehicle->orders[vehicle->num_orders].flags = flags;
+    vehicle->num_orders++;
+
+    iferr(_vehicle_route(vehicle, 0)) {
+        const error_return_t failed = _err;
+
+        // its links would not fit; keep the vehicle as it was
+        vehicle->num_orders--;
+        _vehicle_route(vehicle, 0);
+
+        return failed;
+    }
+
+    if (vehicle->state == VEHICLE_STATE_IDLE) {
+        _vehicle_depart(ind_vehicle, _vehicle_now());
+    }
+
+    return 0;
+}
+
+void vehicle_orders_remove_station(station_handle_t ind_station) {
+    const int now = _vehicle_now();
+
+    vehicle_handle_t ind_vehicle;
+    size_t i, kept;
+    int current_dropped;
+    float x, y;
+
+    for (ind_vehicle = 0; ind_vehicle < num_vehicles; ind_vehicle++) {
+        struct vehicle_t *const vehicle = &vehicles[ind_vehicle];
+
+        if (!vehicle->active) {
+            continue;
+        }
+
+        for (i = 0; i < vehicle->num_orders && vehicle->orders[i].station != ind_station; i++);
+
+        if (i == vehicle->num_orders) {
+            continue;
+        }
+
+        // while the station still exists, so the right links are taken out
+        _vehicle_route(vehicle, 1);
+
+        current_dropped = 0;
+        kept = 0;
+
+        for (i = 0; i < vehicle->num_orders; i++) {
+            if (vehicle->orders[i].station != ind_station) {
+                vehicle->orders[kept++] = vehicle->orders[i];
+            }
+
+            else if (i < vehicle->current_order) {
+                vehicle->current_order--;
+            }
+
+            else if (i == vehicle->current_order) {
+                current_dropped = 1;
+            }
+        }
+
+        vehicle->num_orders = kept;
+
+        if (vehicle->current_order >= vehicle->num_orders) {
+            vehicle->current_order = 0;
+        }
+
+        _vehicle_route(vehicle, 0);
+
+        if (!current_dropped && vehicle->num_orders > 0) {
+            continue;
+        }
+
+        // headed for, or stopped at, the station; start over from where it is
+        vehicle_get_position(ind_vehicle, &x, &y);
+        _vehicle_queue_remove(ind_vehicle);
+
+        vehicle->from_x = vehicle->to_x = x;
+        vehicle->from_y = vehicle->to_y = y;
+        vehicle->state = VEHICLE_STATE_IDLE;
+
+        if (vehicle->num_orders > 0) {
+            _vehicle_depart(ind_vehicle, now);
+        }
+    }
+}
+
+error_return_t vehicle_get_position(vehicle_handle_t ind_vehicle, float *x, float *y) {
+    errcli(_vehicle_check_index(ind_vehicle, "vehicle_get_position"));
+
+    const struct vehicle_t *const vehicle = &vehicles[ind_vehicle];
+    float progress;
+
+    if (vehicle->state != VEHICLE_STATE_MOVING) {
+        *x = vehicle->from_x;
+        *y = vehicle->from_y;
+
+        return 0;
+    }
+
+    progress = (float) (_vehicle_now() - vehicle->depart_tic) / (vehicle->event_tic - vehicle->depart_tic);
+
+    if (progress > 1.0) {
+        progress = 1.0;
+    }
+
+    *x = vehicle->from_x + (vehicle->to_x - vehicle->from_x) * progress;
+    *y = vehicle->from_y + (vehicle->to_y - vehicle->from_y) * progress;
+
+    return 0;
+}
+
+error_return_t vehicle_get_cargo_amount(vehicle_handle_t ind_vehicle, size_t ind_compartment, econ_t *amount) {
+    errcli(_vehicle_check_index(ind_vehicle, "vehicle_get_cargo_amount"));
+
+    if (ind_compartment >= vehicles[ind_vehicle].num_compartments) {
+        erroric(ERR_BAD_MATERIAL, "vehicle_get_cargo_amount");
+    }
+
+    *amount = vehicles[ind_vehicle].compartments[ind_compartment].cargo.amount;
+
+    return 0;
+}
+
+void vehicle_tick_all(void) {
+    const int now = acs_timer();
+
+    vehicle_handle_t ind_vehicle;
+
+    if (vehicle_held) {
+        return;
+    }
+
+    while (vehicle_queue_length > 0 && vehicles[vehicle_queue[0]].event_tic <= now) {
+        ind_vehicle = vehicle_queue[0];
+
+        COUNT(COUNTER_VEHICLE_EVENT);
+        _vehicle_queue_remove(ind_vehicle);
+
+        if (vehicles[ind_vehicle].state == VEHICLE_STATE_MOVING) {
+            _vehicle_arrive(ind_vehicle, now);
+        }
+
+        else {
+            // done at this station; on to the next order
+            vehicles[ind_vehicle].current_order = (vehicles[ind_vehicle].current_order + 1) % vehicles[ind_vehicle].num_orders;
+            _vehicle_depart(ind_vehicle, now);
+        }
+    }
+}
+
+void vehicle_hold(void) {
+    if (!vehicle_held) {
+        vehicle_held = 1;
+        vehicle_held_tic = acs_timer();
+    }
+}
+
+void vehicle_release(int since) {
+    const int shift = acs_timer() - since;
+
+    int i;
+
+    vehicle_held = 0;
+
+    // every queued vehicle is pushed back alike, so the queue keeps its order
+    for (i = 0; i < vehicle_queue_length; i++) {
+        vehicles[vehicle_queue[i]].depart_tic += shift;
+        vehicles[vehicle_queue[i]].event_tic += shift;
+    }
+}
+
+void vehicle_age_cargo(void) {
+    vehicle_handle_t ind_vehicle;
+    size_t i;
+
+    for (ind_vehicle = 0; ind_vehicle < num_vehicles; ind_vehicle++) {
+        struct vehicle_t *const vehicle = &vehicles[ind_vehicle];
+
+        if (!vehicle->active) {
+            continue;
+        }
+
+        for (i = 0; i < vehicle->num_compartments; i++) {
+            if (vehicle->compartments[i].cargo.amount > 0 && vehicle->compartments[i].cargo.age < CARGO_MAX_AGE) {
+                vehicle->compartments[i].cargo.age += 1.0;
+            }
+        }
+    }
+}
+
+const struct snapshot_region_t *vehicle_snapshot_regions(size_t *num_regions) {
+    *num_regions = sizeof(vehicle_snapshot) / sizeof(*vehicle_snapshot);
+
+    return vehicle_snapshot;
+}
@@ -0,0 +1,359 @@
+/**
+ * @file h_vehicle.h
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Vehicles.
+ * @version added in 0.1
+ * @date 2021-03-15
+ *
+ * Vehicles carry cargo between stations, following a list of orders.
+ *
+ * All vehicles live in a single pool, and are advanced together by
+ * vehicle_tick_all, rather than each by its own script. Vehicles do
+ * not move tic by tic, either: when a vehicle departs, the tic it will
+ * arrive at is worked out right away, and nothing is done with it
+ * until then. Its position in between is interpolated whenever it is
+ * asked for. Each tic thus only costs as much as the vehicles that
+ * actually arrive or depart in it, no matter how many are moving.
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ */
+
+#ifndef VEHICLE_H
+#define VEHICLE_H
+
+#include <stddef.h>
+
+#include "m_acs.h"
+#include "m_error.h"
+#include "m_profile.h"
+#include "m_snapshot.h"
+#include "h_cargo.h"
+#include "h_station.h"
+
+
+/**
+ * @brief The maximum number of vehicles in the entire world.
+ *
+ * May be overridden at build time; the native host build does so, to
+ * run much larger fleets than the ACS VM could.
+ */
+#ifndef MAX_VEHICLES
+#define MAX_VEHICLES 512
+#endif
+
+/**
+ * @brief The maximum number of orders a vehicle can have.
+ */
+#define MAX_VEHICLE_ORDERS 8
+
+/**
+ * @brief The maximum number of cargo compartments in a vehicle.
+ */
+#define MAX_VEHICLE_COMPARTMENTS 4
+
+/**
+ * @brief How long a vehicle stays at a station to load and unload, in tics.
+ */
+#define VEHICLE_STOP_TICS (2 * TICRATE)
+
+/**
+ * @brief Order flag; load cargo at the order's station.
+ */
+#define ORDER_LOAD 1
+
+/**
+ * @brief Order flag; unload cargo at the order's station.
+ */
+#define ORDER_UNLOAD 2
+
+
+/**
+ * @brief An index handle to a vehicle.
+ */
+typedef size_t vehicle_handle_t;
+
+/**
+ * @brief What a vehicle is doing.
+ */
+enum vehicle_state_t {
+    /**
+     * @brief Not doing anything, for lack of orders.
+     */
+    VEHICLE_STATE_IDLE,
+
+    /**
+     * @brief On its way to the station of its current order.
+     */
+    VEHICLE_STATE_MOVING,
+
+    /**
+     * @brief Stopped at the station of its current order.
+     */
+    VEHICLE_STATE_STOPPED
+};
+
+/**
+ * @brief An order given to a vehicle.
+ *
+ * Vehicles go through their orders in a loop.
+ */
+struct vehicle_order_t {
+    /**
+     * @brief The station to go to.
+     */
+    station_handle_t station;
+
+    /**
+     * @brief What to do at the station, as ORDER_* flags.
+     */
+    unsigned char flags;
+};
+
+/**
+ * @brief A compartment of a vehicle, which carries a single cargo type.
+ */
+struct vehicle_compartment_t {
+    /**
+     * @brief The type of cargo carried in this compartment.
+     */
+    cargo_handle_t cargo_type;
+
+    /**
+     * @brief How much cargo fits in this compartment, in Cargo Units.
+     */
+    econ_t capacity;
+
+    /**
+     * @brief The cargo carried in this compartment.
+     */
+    struct cargo_parcel_t cargo;
+};
+
+/**
+ * @brief A vehicle.
+ */
+struct vehicle_t {
+    /**
+     * @brief Whether this vehicle exists.
+     */
+    unsigned char active;
+
+    /**
+     * @brief Whether this vehicle's links are all in the route graph.
+     *
+     * Either every link between the stations in its orders was added
+     * for it, or none was; only links actually added are ever removed.
+     */
+    unsigned char routed;
+
+    /**
+     * @brief What this vehicle is doing.
+     */
+    enum vehicle_state_t state;
+
+    /**
+     * @brief The company that owns this vehicle, and is paid for its deliveries.
+     */
+    size_t owner;
+
+    /**
+     * @brief How far this vehicle moves in a tic.
+     */
+    float speed;
+
+    /**
+     * @brief Where this vehicle departed from, or where it is stopped.
+     */
+    float from_x, from_y;
+
+    /**
+     * @brief Where this vehicle is headed.
+     */
+    float to_x, to_y;
+
+    /**
+     * @brief The tic this vehicle departed at.
+     */
+    int depart_tic;
+
+    /**
+     * @brief The tic of this vehicle's next arrival or departure.
+     */
+    int event_tic;
+
+    /**
+     * @brief This vehicle's place in the event queue, or -1 if not queued.
+     */
+    int queue_index;
+
+    /**
+     * @brief This vehicle's orders.
+     *
+     * @note Only items up to (num_orders - 1) should be iterated.
+     */
+    struct vehicle_order_t orders[MAX_VEHICLE_ORDERS];
+
+    /**
+     * @brief The number of orders given to this vehicle.
+     */
+    size_t num_orders;
+
+    /**
+     * @brief The order currently being carried out.
+     */
+    size_t current_order;
+
+    /**
+     * @brief This vehicle's cargo compartments.
+     *
+     * @note Only items up to (num_compartments - 1) should be iterated.
+     */
+    struct vehicle_compartment_t compartments[MAX_VEHICLE_COMPARTMENTS];
+
+    /**
+     * @brief The number of cargo compartments in this vehicle.
+     */
+    size_t num_compartments;
+};
+
+/**
+ * @brief The number of vehicle slots in use, including removed ones.
+ */
+extern int num_vehicles;
+
+/**
+ * @brief Checks whether a vehicle exists.
+ *
+ * @param ind_vehicle The vehicle handle to check.
+ * @return int 1 if a vehicle exists with this handle, else 0.
+ */
+int vehicle_exists(vehicle_handle_t ind_vehicle);
+
+/**
+ * @brief Builds a new vehicle, with no orders and no compartments.
+ *
+ * @param owner The company that owns the vehicle; it must exist.
+ * @param x X coordinate of where the vehicle is built.
+ * @param y Y coordinate of where the vehicle is built.
+ * @param speed How far the vehicle moves in a tic.
+ * @return vehicle_handle_t The handle of the new vehicle, or -1 on error.
+ */
+vehicle_handle_t vehicle_build(size_t owner, float x, float y, float speed);
+
+/**
+ * @brief Removes a vehicle from the world, along with any cargo in it.
+ *
+ * @param ind_vehicle The vehicle to remove.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t vehicle_remove(vehicle_handle_t ind_vehicle);
+
+/**
+ * @brief Removes every vehicle a company owns, along with any cargo in them.
+ *
+ * Goes through every vehicle slot, so only meant for rare events,
+ * such as a company being dissolved.
+ *
+ * @param owner The company whose vehicles to remove.
+ * @return int The number of vehicles removed.
+ */
+int vehicle_remove_owned(size_t owner);
+
+/**
+ * @brief Adds a cargo compartment to a vehicle.
+ *
+ * @param ind_vehicle The vehicle to add a compartment to.
+ * @param cargo_type The type of cargo the compartment carries.
+ * @param capacity How much cargo fits in it, in Cargo Units.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t vehicle_add_compartment(vehicle_handle_t ind_vehicle, cargo_handle_t cargo_type, econ_t capacity);
+
+/**
+ * @brief Appends an order to a vehicle's orders.
+ *
+ * An idle vehicle sets off to carry it out right away.
+ *
+ * @param ind_vehicle The vehicle to give the order to.
+ * @param ind_station The station to go to; it must exist.
+ * @param flags What to do at the station, as ORDER_* flags.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t vehicle_add_order(vehicle_handle_t ind_vehicle, station_handle_t ind_station, unsigned char flags);
+
+/**
+ * @brief Drops every order to a station from all vehicles.
+ *
+ * Called by station code, before the station is actually removed, so
+ * that no order is left to whichever station reuses its slot later.
+ * Vehicles on their way there turn to their next order from where
+ * they are, and those left without orders become idle.
+ *
+ * @param ind_station The station being removed.
+ */
+void vehicle_orders_remove_station(station_handle_t ind_station);
+
+/**
+ * @brief Gets the current position of a vehicle.
+ *
+ * @param ind_vehicle The vehicle whose position to get.
+ * @param x A pointer to a float in the which to store the X coordinate.
+ * @param y A pointer to a float in the which to store the Y coordinate.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t vehicle_get_position(vehicle_handle_t ind_vehicle, float *x, float *y);
+
+/**
+ * @brief Gets the amount of cargo in a vehicle's compartment.
+ *
+ * @param ind_vehicle The vehicle to query.
+ * @param ind_compartment The index of the compartment in the vehicle.
+ * @param amount A pointer to an amount in the which to store the amount.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t vehicle_get_cargo_amount(vehicle_handle_t ind_vehicle, size_t ind_compartment, econ_t *amount);
+
+/**
+ * @brief Advances all vehicles by a single tic.
+ *
+ * Must be called exactly once per tic. Only vehicles arriving at or
+ * departing from a station in this tic are looked at.
+ */
+void vehicle_tick_all(void);
+
+/**
+ * @brief Holds every vehicle where it is, e.g. while the world is being saved.
+ *
+ * Until vehicle_release is called, vehicle_tick_all does nothing, and
+ * vehicle_get_position finds every vehicle where it was when held.
+ */
+void vehicle_hold(void);
+
+/**
+ * @brief Lets held vehicles move on.
+ *
+ * The schedule of every vehicle is pushed back by as many tics as have
+ * passed since a given tic, so that they carry on from where they were
+ * as of that tic.
+ *
+ * @param since The tic the vehicle schedules were last up to date at, e.g. the one they were held at.
+ */
+void vehicle_release(int since);
+
+/**
+ * @brief Ages all cargo carried in all vehicles by one age bucket.
+ *
+ * @see station_age_cargo
+ */
+void vehicle_age_cargo(void);
+
+/**
+ * @brief Gets the vehicle tables, as snapshot regions.
+ *
+ * @param num_regions Where to store the number of regions.
+ * @return const struct snapshot_region_t* The regions, in a fixed order.
+ */
+const struct snapshot_region_t *vehicle_snapshot_regions(size_t *num_regions);
+
+
+#endif // VEHICLE_H
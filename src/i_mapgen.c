@@ -0,0 +1,211 @@
+/**
+ * @file i_mapgen.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Map feature generation logic.
+ * @version added in 0.1
+ * @date 2021-03-17
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * Places industries on the map's places, a slice at a time.
+ */
+
+#include "i_mapgen.h"
+#include "i_place.h"
+#include "h_industry.h"
+#include "m_acs.h"
+
+
+unsigned int mapgen_seed = MAPGEN_DEFAULT_SEED;
+
+/**
+ * @brief The places to visit.
+ *
+ * Shuffled as they are visited; those before mapgen_cursor were
+ * already visited, in the order they are in.
+ */
+static spot_handle_t mapgen_places[MAX_SPOTS];
+static size_t mapgen_num_places = 0;
+static size_t mapgen_cursor = 0;
+
+/**
+ * @brief The state of the random number generator.
+ */
+static unsigned int mapgen_random_state;
+
+/**
+ * @brief The industry type the next place is offered first.
+ */
+static size_t mapgen_next_type;
+
+/**
+ * @brief The number of industry types defined.
+ */
+static size_t mapgen_num_types;
+
+static size_t mapgen_max_industries = 0;
+static size_t mapgen_placed = 0;
+
+/**
+ * @brief How far around a place to look for industries in the way.
+ */
+static float mapgen_query_radius;
+
+
+static unsigned int _mapgen_random(void) {
+    // xorshift32
+    mapgen_random_state ^= mapgen_random_state << 13;
+    mapgen_random_state ^= mapgen_random_state >> 17;
+    mapgen_random_state ^= mapgen_random_state << 5;
+
+    return mapgen_random_state;
+}
+
+/**
+ * @brief Checks whether an industry type is allowed at a place.
+ *
+ * @param near The industries around the place.
+ */
+static int _mapgen_type_fits(size_t ind_type, float x, float y, const spot_handle_t *near, size_t num_near) {
+    const float reach = industry_types[ind_type].reach;
+
+    size_t i;
+
+    for (i = 0; i < num_near; i++) {
+        const struct spot_t *const spot = spot_get(near[i]);
+        const float dx = spot->x - x;
+        const float dy = spot->y - y;
+
+        if (industry_get_type(spot->owner) == ind_type && dx * dx + dy * dy < reach * reach) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Visits the next place, in random order, placing an industry there if any is allowed.
+ */
+static void _mapgen_visit_next(void) {
+    spot_handle_t near[MAX_INDUSTRIES];
+    const struct spot_t *place;
+    size_t num_near, i, ind_type;
+    float x, y;
+
+    // draw the next place from those not yet visited (an incremental Fisher-Yates shuffle)
+    const size_t pick = mapgen_cursor + _mapgen_random() % (mapgen_num_places - mapgen_cursor);
+    const spot_handle_t ind_place = mapgen_places[pick];
+
+    mapgen_places[pick] = mapgen_places[mapgen_cursor];
+    mapgen_places[mapgen_cursor++] = ind_place;
+
+    place = spot_get(ind_place);
+
+    if (place == NULL || place->kind != SPOT_KIND_PLACE) {
+        return;
+    }
+
+    x = place->x;
+    y = place->y;
+
+    num_near = spot_query_radius(x, y, mapgen_query_radius, SPOT_KIND_MASK(SPOT_KIND_INDUSTRY), near, MAX_INDUSTRIES);
+
+    for (i = 0; i < num_near; i++) {
+        const struct spot_t *const spot = spot_get(near[i]);
+        const float dx = spot->x - x;
+        const float dy = spot->y - y;
+
+        if (dx * dx + dy * dy < MAPGEN_MIN_SPACING * MAPGEN_MIN_SPACING) {
+            // too close to another industry for anything
+            return;
+        }
+    }
+
+    for (i = 0; i < mapgen_num_types; i++) {
+        ind_type = (mapgen_next_type + i) % mapgen_num_types;
+
+        if (!_mapgen_type_fits(ind_type, x, y, near, num_near)) {
+            continue;
+        }
+
+        if (industry_create(ind_type, x, y) == (industry_handle_t) -1) {
+            if (num_industries >= MAX_INDUSTRIES) {
+                // the world is full; stop here
+                mapgen_cursor = mapgen_num_places;
+            }
+
+            // otherwise only this place failed (e.g. its spotmap tile is full); skip it
+            return;
+        }
+
+        acs_spawn(industry_types[ind_type].spawner_type, x, y);
+
+        mapgen_placed++;
+        mapgen_next_type = (ind_type + 1) % mapgen_num_types;
+
+        return;
+    }
+}
+
+void mapgen_begin(unsigned int seed, size_t max_industries) {
+    spot_handle_t ind_spot;
+    size_t i;
+
+    mapgen_random_state = seed != 0 ? seed : MAPGEN_DEFAULT_SEED;
+    mapgen_max_industries = max_industries;
+    mapgen_placed = 0;
+    mapgen_next_type = 0;
+    mapgen_num_types = 0;
+    mapgen_query_radius = MAPGEN_MIN_SPACING;
+
+    for (i = 0; i < MAX_INDUS_TYPES && industry_types[i].supply_type != ISUPTYPE_UNKNOWN; i++) {
+        if (industry_types[i].reach > mapgen_query_radius) {
+            mapgen_query_radius = industry_types[i].reach;
+        }
+
+        mapgen_num_types++;
+    }
+
+    mapgen_num_places = 0;
+    mapgen_cursor = 0;
+
+    for (ind_spot = 0; ind_spot < place_num_spots; ind_spot++) {
+        const struct spot_t *const spot = spot_get(ind_spot);
+
+        if (spot != NULL && spot->kind == SPOT_KIND_PLACE) {
+            mapgen_places[mapgen_num_places++] = ind_spot;
+        }
+    }
+}
+
+int mapgen_is_running(void) {
+    return mapgen_cursor < mapgen_num_places && mapgen_placed < mapgen_max_industries && mapgen_num_types > 0;
+}
+
+int mapgen_step(void) {
+    int i;
+
+    for (i = 0; i < MAPGEN_SLICE_PLACES && mapgen_is_running(); i++) {
+        _mapgen_visit_next();
+    }
+
+    return mapgen_is_running();
+}
+
+size_t mapgen_num_placed(void) {
+    return mapgen_placed;
+}
+
+/**
+ * @brief Generates the map's features, once its places are registered.
+ */
+ACS_OPEN_SCRIPT(mapgen_run) {
+    acs_delay(MAPGEN_START_DELAY);
+
+    mapgen_begin(mapgen_seed, MAX_INDUSTRIES);
+
+    while (mapgen_step()) {
+        acs_delay(1);
+    }
+}
@@ -0,0 +1,104 @@
+/**
+ * @file i_mapgen.h
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Map feature generation.
+ * @version added in 0.1
+ * @date 2021-03-17
+ *
+ * Places the world's industries on the places defined by the map (see
+ * i_place.h), and spawns their spawner actors there.
+ *
+ * Places are visited in a random order, drawn from mapgen_seed, so the
+ * same map and seed always give the same industries in the same
+ * places, on every machine. Each place gets the next industry type,
+ * round-robin, that is allowed there:
+ *
+ *  - no industry at all may be closer than MAPGEN_MIN_SPACING;
+ *  - no industry of the same type may be within its type's reach, so
+ *    that industries of a type never compete for the same stations.
+ *
+ * Both are checked with a single spotmap query per place, never by
+ * comparing every pair of industries. Places that allow no industry
+ * type are left empty.
+ *
+ * Generation runs in slices of MAPGEN_SLICE_PLACES places per tic, so
+ * that maps with many places do not stall while loading.
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ */
+
+#ifndef MAPGEN_H
+#define MAPGEN_H
+
+#include <stddef.h>
+
+#include "m_error.h"
+#include "m_profile.h"
+
+
+/**
+ * @brief The seed map generation starts from, unless mapgen_seed is set otherwise.
+ */
+#define MAPGEN_DEFAULT_SEED 0x1DF3A0u
+
+/**
+ * @brief The minimum distance between any two industries.
+ */
+#define MAPGEN_MIN_SPACING 256.0
+
+/**
+ * @brief How many places are visited per tic.
+ */
+#define MAPGEN_SLICE_PLACES 16
+
+/**
+ * @brief How many tics to wait after the level starts, before generating.
+ *
+ * IndusfernoMapSpot actors register their places in the meantime.
+ */
+#define MAPGEN_START_DELAY 1
+
+
+/**
+ * @brief The seed of the next map generation.
+ *
+ * MAPGEN_DEFAULT_SEED unless set otherwise before generation starts.
+ * Must be the same on every peer of a multiplayer game.
+ */
+extern unsigned int mapgen_seed;
+
+/**
+ * @brief Starts generating the map's features.
+ *
+ * Only gathers the places; nothing is placed until mapgen_step is
+ * called. Restarts generation if it was already running, keeping
+ * whatever was placed so far.
+ *
+ * @param seed The seed to generate from.
+ * @param max_industries How many industries to place, at most.
+ */
+void mapgen_begin(unsigned int seed, size_t max_industries);
+
+/**
+ * @brief Visits the next slice of places, placing industries where allowed.
+ *
+ * @return int 1 if generation is still running, 0 once it is done.
+ */
+int mapgen_step(void);
+
+/**
+ * @brief Checks whether map generation is still running.
+ *
+ * @return int 1 if generation is running, else 0.
+ */
+int mapgen_is_running(void);
+
+/**
+ * @brief Gets how many industries the running or last generation placed.
+ *
+ * @return size_t The number of industries placed.
+ */
+size_t mapgen_num_placed(void);
+
+
+#endif // MAPGEN_H
@@ -17,37 +17,152 @@ static struct spotmap_t place_spotmap;
 static struct spot_t place_spots[MAX_SPOTS];
 size_t place_num_spots = 0;
 
+/**
+ * @brief Handles of freed spots, ready to be reused.
+ */
+static spot_handle_t place_free_spots[MAX_SPOTS];
+static size_t place_num_free_spots = 0;
+
+/**
+ * @brief The query stamp of each spot.
+ *
+ * A spot was already reported by the running query if its stamp equals
+ * spot_query_stamp; this deduplicates spots linked into several tiles,
+ * without having to clear anything between queries.
+ */
+static unsigned int spot_query_stamps[MAX_SPOTS];
+static unsigned int spot_query_stamp = 0;
 
-static int hash_coords(int x, int y) {
-    return ((x & 0xD555) << 1) | (y & 0x5555);
+/**
+ * @brief The pool of spot covers.
+ */
+static struct spot_cover_t place_covers[MAX_SPOT_COVERS];
+static size_t place_num_covers = 0;
+
+/**
+ * @brief The first of the freed spot covers plus one, chained through their next, or 0 if none.
+ */
+static unsigned short place_free_covers = 0;
+
+/**
+ * @brief Hashes of the blocks of the spot tables, as of the last snapshot.
+ */
+static unsigned int spot_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(place_spots))];
+static unsigned int spot_free_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(place_free_spots))];
+static unsigned int spotmap_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(place_spotmap))];
+static unsigned int spot_cover_snapshot_hashes[SNAPSHOT_BLOCKS(sizeof(place_covers))];
+
+static const struct snapshot_region_t spot_snapshot[] = {
+    SNAPSHOT_REGION(place_spots, spot_snapshot_hashes),
+    SNAPSHOT_REGION(place_num_spots, NULL),
+    SNAPSHOT_REGION(place_free_spots, spot_free_snapshot_hashes),
+    SNAPSHOT_REGION(place_num_free_spots, NULL),
+    SNAPSHOT_REGION(place_spotmap, spotmap_snapshot_hashes),
+    SNAPSHOT_REGION(place_covers, spot_cover_snapshot_hashes),
+    SNAPSHOT_REGION(place_num_covers, NULL),
+    SNAPSHOT_REGION(place_free_covers, NULL)
+};
+
+
+static unsigned int hash_coords(int x, int y) {
+    // mix both coordinates through all 32 bits (murmur3's finalizer)
+    unsigned int hash = (unsigned int) x * 0x9E3779B1u ^ (unsigned int) y * 0x85EBCA77u;
+
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+
+    return hash;
 }
 
+/**
+ * @brief Puts a pooled tile into the tile table.
+ */
+static void _spot_table_insert(int ind_tile) {
+    const struct spotmap_tile_t *const tile = &place_spotmap.tiles[ind_tile];
+    const unsigned int mask = place_spotmap.num_slots - 1;
 
-static struct spotmap_tile_t *spot_find_tile(int x, int y) {
-    const int hash = hash_coords(x, y);
-    struct spotmap_bucket_t *const bucket = &place_spotmap.buckets[hash % NUM_SPOT_BUCKETS_PER_MAP];
-    size_t i;
+    unsigned int slot = hash_coords(tile->x, tile->y) & mask;
+
+    while (place_spotmap.slots[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+
+    place_spotmap.slots[slot] = ind_tile + 1;
+}
+
+/**
+ * @brief Grows the tile table if it is getting too full to take another tile.
+ */
+static void _spot_table_grow(void) {
+    int i;
+
+    if (place_spotmap.num_slots == 0) {
+        place_spotmap.num_slots = MIN_SPOT_TILE_SLOTS;
+        return;
+    }
+
+    if ((place_spotmap.num_tiles + 1) * 4 <= place_spotmap.num_slots * 3 || place_spotmap.num_slots >= MAX_SPOT_TILE_SLOTS) {
+        return;
+    }
+
+    place_spotmap.num_slots *= 2;
+
+    // rehash every tile into the larger table
+    for (i = 0; i < place_spotmap.num_slots; i++) {
+        place_spotmap.slots[i] = 0;
+    }
+
+    for (i = 0; i < place_spotmap.num_tiles; i++) {
+        _spot_table_insert(i);
+    }
+}
+
+static struct spotmap_tile_t *spot_find_tile(int x, int y, int create) {
+    unsigned int mask, slot;
+
+    COUNT(COUNTER_SPOT_FIND_TILE);
+
+    if (place_spotmap.num_slots > 0) {
+        mask = place_spotmap.num_slots - 1;
+
+        for (slot = hash_coords(x, y) & mask; place_spotmap.slots[slot] != 0; slot = (slot + 1) & mask) {
+            struct spotmap_tile_t *const tile = &place_spotmap.tiles[place_spotmap.slots[slot] - 1];
 
-    for (i = 0; i < bucket->num_tiles; i++) {
-        struct spotmap_tile_t *const tile = &bucket->tiles[i];
+            COUNT(COUNTER_SPOTMAP_PROBE);
 
-        if (tile->x == x && tile->y == y) {
-            return tile;
+            if (tile->x == x && tile->y == y) {
+                return tile;
+            }
         }
     }
 
+    if (!create) {
+        return NULL;
+    }
+
+    if (place_spotmap.num_tiles >= MAX_SPOT_TILES) {
+        errorac(ERR_PLACE_MAXED_TILES, NULL, "spot_find_tile");
+    }
+
     // make new tile
-    struct spotmap_tile_t *const tile = &bucket->tiles[bucket->num_tiles++];
+    struct spotmap_tile_t *const tile = &place_spotmap.tiles[place_spotmap.num_tiles];
 
     tile->x = x;
     tile->y = y;
     tile->num_spots = 0;
+    tile->first_cover = 0;
+
+    _spot_table_grow();
+    _spot_table_insert(place_spotmap.num_tiles++);
 
     return tile;
 }
 
 static error_return_t _spot_check_index(spot_handle_t ind_spot, const char *const ctx) {
-    if (ind_spot < place_num_spots) {
+    if (ind_spot >= place_num_spots || place_spots[ind_spot].kind == SPOT_KIND_FREE) {
         erroric(ERR_PLACE_BAD_SPOT_INDEX, ctx);
     }
 
@@ -60,6 +175,10 @@ static error_return_t _spot_check_index(spot_handle_t ind_spot, const char *cons
 typedef error_return_t (*_spot_iterator_callback_t)(spot_handle_t ind_spot, float radius, struct spotmap_tile_t *const tile, int x, int y);
 
 static error_return_t _spot_link_callback(spot_handle_t ind_spot, float radius, struct spotmap_tile_t *const tile, int x, int y) {
+    if (tile->num_spots >= MAX_SPOTS_PER_TILE) {
+        erroric(ERR_PLACE_TILE_FULL, "_spot_link_callback");
+    }
+
     tile->spots[tile->num_spots++] = ind_spot;
 
     return 0;
@@ -68,7 +187,9 @@ static error_return_t _spot_link_callback(spot_handle_t ind_spot, float radius,
 static error_return_t _spot_unlink_callback(spot_handle_t ind_spot, float radius, struct spotmap_tile_t *const tile, int x, int y) {
     static int i;
 
-    tile->spots[tile->num_spots++] = ind_spot;
+    if (tile == NULL) {
+        erroric(ERR_PLACE_UNLINK_SPOT_NOT_FOUND, "_spot_unlink_callback");
+    }
 
     // find which spot in tile is our spot
     for (i = 0; i < tile->num_spots; i++) {
@@ -84,7 +205,7 @@ static error_return_t _spot_unlink_callback(spot_handle_t ind_spot, float radius
     }
 
     // move all other spots back a slot
-    while (i < tile->num_spots) {
+    while (i < tile->num_spots - 1) {
         tile->spots[i] = tile->spots[i + 1];
         i++;
     }
@@ -94,7 +215,54 @@ static error_return_t _spot_unlink_callback(spot_handle_t ind_spot, float radius
     return 0;
 }
 
-static error_return_t _spot_tile_iter(spot_handle_t ind_spot, float radius, _spot_iterator_callback_t iterator) {
+static error_return_t _spot_cover_callback(spot_handle_t ind_spot, float radius, struct spotmap_tile_t *const tile, int x, int y) {
+    unsigned short ind_cover;
+
+    if (place_free_covers != 0) {
+        ind_cover = place_free_covers;
+        place_free_covers = place_covers[ind_cover - 1].next;
+    }
+
+    else if (place_num_covers < MAX_SPOT_COVERS) {
+        ind_cover = ++place_num_covers;
+    }
+
+    else {
+        erroric(ERR_PLACE_MAXED_COVERS, "_spot_cover_callback");
+    }
+
+    place_covers[ind_cover - 1].spot = ind_spot;
+    place_covers[ind_cover - 1].next = tile->first_cover;
+    tile->first_cover = ind_cover;
+
+    return 0;
+}
+
+static error_return_t _spot_uncover_callback(spot_handle_t ind_spot, float radius, struct spotmap_tile_t *const tile, int x, int y) {
+    unsigned short *next, ind_cover;
+
+    if (tile == NULL) {
+        return 0;
+    }
+
+    for (next = &tile->first_cover; *next != 0 && place_covers[*next - 1].spot != ind_spot; next = &place_covers[*next - 1].next);
+
+    if (*next == 0) {
+        // this tile was never covered
+        return 0;
+    }
+
+    // unchain it, and onto the free chain it goes
+    ind_cover = *next;
+    *next = place_covers[ind_cover - 1].next;
+
+    place_covers[ind_cover - 1].next = place_free_covers;
+    place_free_covers = ind_cover;
+
+    return 0;
+}
+
+static error_return_t _spot_tile_iter(spot_handle_t ind_spot, float radius, int create, _spot_iterator_callback_t iterator) {
     const struct spot_t *spot = &place_spots[ind_spot];
 
     int min_x = floordiv((spot->x - radius), SPOT_TILE_WIDTH);
@@ -105,7 +273,11 @@ static error_return_t _spot_tile_iter(spot_handle_t ind_spot, float radius, _spo
 
     for (y = min_y; y <= max_y; y++) {
         for (x = min_x; x <= max_x; x++) {
-            struct spotmap_tile_t *const tile = spot_find_tile(x, y);
+            struct spotmap_tile_t *const tile = spot_find_tile(x, y, create);
+
+            if (create && tile == NULL) {
+                codei(ERR_PLACE_MAXED_TILES);
+            }
 
             errcli(iterator(ind_spot, radius, tile, x, y));
         }
@@ -117,7 +289,7 @@ static error_return_t _spot_tile_iter(spot_handle_t ind_spot, float radius, _spo
 error_return_t spot_link(spot_handle_t ind_spot, float radius) {
     errcli(_spot_check_index(ind_spot, "spot_link"));
 
-    errcli(_spot_tile_iter(ind_spot, radius, _spot_link_callback));
+    errcli(_spot_tile_iter(ind_spot, radius, 1, _spot_link_callback));
 
     return 0;
 }
@@ -125,18 +297,196 @@ error_return_t spot_link(spot_handle_t ind_spot, float radius) {
 error_return_t spot_unlink(spot_handle_t ind_spot, float radius) {
     errcli(_spot_check_index(ind_spot, "spot_unlink"));
 
-    errcli(_spot_tile_iter(ind_spot, radius, _spot_unlink_callback));
+    errcli(_spot_tile_iter(ind_spot, radius, 0, _spot_unlink_callback));
+
+    return 0;
+}
+
+error_return_t spot_cover(spot_handle_t ind_spot, float radius) {
+    error_return_t res;
+
+    errcli(_spot_check_index(ind_spot, "spot_cover"));
+
+    res = _spot_tile_iter(ind_spot, radius, 1, _spot_cover_callback);
+
+    if (res < 0) {
+        // take back the tiles covered before running out of room
+        _spot_tile_iter(ind_spot, radius, 0, _spot_uncover_callback);
+    }
+
+    return res;
+}
+
+error_return_t spot_uncover(spot_handle_t ind_spot, float radius) {
+    errcli(_spot_check_index(ind_spot, "spot_uncover"));
+
+    errcli(_spot_tile_iter(ind_spot, radius, 0, _spot_uncover_callback));
 
     return 0;
 }
 
 spot_handle_t make_spot(float x, float y) {
-    if (place_num_spots >= MAX_SPOTS) {
+    return make_owned_spot(x, y, SPOT_KIND_PLACE, 0);
+}
+
+spot_handle_t make_owned_spot(float x, float y, enum spot_kind_t kind, size_t owner) {
+    spot_handle_t ind_spot;
+
+    if (place_num_free_spots > 0) {
+        ind_spot = place_free_spots[--place_num_free_spots];
+    }
+
+    else if (place_num_spots < MAX_SPOTS) {
+        ind_spot = place_num_spots++;
+    }
+
+    else {
         errorac(ERR_PLACE_MAXED_SPOTS, -1, "make_spot");
     }
 
-    place_spots[place_num_spots].x = x;
-    place_spots[place_num_spots].y = y;
+    place_spots[ind_spot].x = x;
+    place_spots[ind_spot].y = y;
+    place_spots[ind_spot].kind = kind;
+    place_spots[ind_spot].owner = owner;
+
+    return ind_spot;
+}
+
+error_return_t free_spot(spot_handle_t ind_spot, float radius) {
+    errcli(spot_unlink(ind_spot, radius));
+
+    place_spots[ind_spot].kind = SPOT_KIND_FREE;
+    place_free_spots[place_num_free_spots++] = ind_spot;
+
+    return 0;
+}
+
+const struct spot_t *spot_get(spot_handle_t ind_spot) {
+    if (ind_spot >= place_num_spots || place_spots[ind_spot].kind == SPOT_KIND_FREE) {
+        return NULL;
+    }
+
+    return &place_spots[ind_spot];
+}
+
+/**
+ * @brief Starts a new spot query, so that no spot counts as reported yet.
+ */
+static void _spot_query_begin(void) {
+    size_t i;
+
+    if (++spot_query_stamp == 0) {
+        // wrapped around; old stamps could be mistaken for new ones
+        for (i = 0; i < MAX_SPOTS; i++) {
+            spot_query_stamps[i] = 0;
+        }
+
+        spot_query_stamp = 1;
+    }
+}
+
+/**
+ * @brief Finds the spots within a rectangle, and optionally also within a circle inside it.
+ *
+ * The distance test is done before a spot counts against max, so that
+ * spots outside the circle can never crowd out ones inside it. A
+ * negative radius_sq skips the distance test altogether.
+ */
+static size_t _spot_query_area(float min_x, float min_y, float max_x, float max_y, float x, float y, float radius_sq, unsigned int kinds, spot_handle_t *out, size_t max) {
+    const int min_tx = floordiv(min_x, SPOT_TILE_WIDTH);
+    const int max_tx = floordiv(max_x, SPOT_TILE_WIDTH);
+    const int min_ty = floordiv(min_y, SPOT_TILE_WIDTH);
+    const int max_ty = floordiv(max_y, SPOT_TILE_WIDTH);
+
+    size_t found = 0;
+    int tx, ty, i;
+
+    COUNT(COUNTER_SPOT_QUERY);
+
+    _spot_query_begin();
+
+    for (ty = min_ty; ty <= max_ty; ty++) {
+        for (tx = min_tx; tx <= max_tx; tx++) {
+            const struct spotmap_tile_t *const tile = spot_find_tile(tx, ty, 0);
+
+            if (tile == NULL) {
+                continue;
+            }
+
+            COUNT_N(COUNTER_SPOT_QUERY_SPOT, tile->num_spots);
+
+            for (i = 0; i < tile->num_spots; i++) {
+                const spot_handle_t ind_spot = tile->spots[i];
+                const struct spot_t *const spot = &place_spots[ind_spot];
+
+                if (spot_query_stamps[ind_spot] == spot_query_stamp) {
+                    // already seen in another tile
+                    continue;
+                }
+
+                spot_query_stamps[ind_spot] = spot_query_stamp;
+
+                if (!(kinds & SPOT_KIND_MASK(spot->kind))) {
+                    continue;
+                }
+
+                if (spot->x < min_x || spot->x > max_x || spot->y < min_y || spot->y > max_y) {
+                    continue;
+                }
+
+                if (radius_sq >= 0.0 && (spot->x - x) * (spot->x - x) + (spot->y - y) * (spot->y - y) > radius_sq) {
+                    continue;
+                }
+
+                if (found == max) {
+                    return found;
+                }
+
+                out[found++] = ind_spot;
+            }
+        }
+    }
+
+    return found;
+}
+
+size_t spot_query_cover(float x, float y, unsigned int kinds, spot_handle_t *out, size_t max) {
+    const struct spotmap_tile_t *const tile = spot_find_tile(floordiv(x, SPOT_TILE_WIDTH), floordiv(y, SPOT_TILE_WIDTH), 0);
+
+    size_t found = 0;
+    unsigned short ind_cover;
+
+    COUNT(COUNTER_SPOT_QUERY);
+
+    if (tile == NULL) {
+        return 0;
+    }
+
+    // a spot covers each tile only once, so there is nothing to deduplicate
+    for (ind_cover = tile->first_cover; ind_cover != 0 && found < max; ind_cover = place_covers[ind_cover - 1].next) {
+        const spot_handle_t ind_spot = place_covers[ind_cover - 1].spot;
+
+        COUNT(COUNTER_SPOT_QUERY_SPOT);
+
+        if (kinds & SPOT_KIND_MASK(place_spots[ind_spot].kind)) {
+            out[found++] = ind_spot;
+        }
+    }
+
+    return found;
+}
+
+size_t spot_query_rect(float min_x, float min_y, float max_x, float max_y, unsigned int kinds, spot_handle_t *out, size_t max) {
+    return _spot_query_area(min_x, min_y, max_x, max_y, 0.0, 0.0, -1.0, kinds, out, max);
+}
+
+size_t spot_query_radius(float x, float y, float radius, unsigned int kinds, spot_handle_t *out, size_t max) {
+    // the circle's bounding box, with the exact distance test on the way
+    return _spot_query_area(x - radius, y - radius, x + radius, y + radius, x, y, radius * radius, kinds, out, max);
+}
+
+const struct snapshot_region_t *spot_snapshot_regions(size_t *num_regions) {
+    *num_regions = sizeof(spot_snapshot) / sizeof(*spot_snapshot);
 
-    return place_num_spots++;
+    return spot_snapshot;
 }
@@ -25,8 +25,52 @@
 
 #include <stddef.h>
 #include "m_error.h"
+#include "m_profile.h"
+#include "m_snapshot.h"
 
 
+/**
+ * @brief What a spot stands for.
+ */
+enum spot_kind_t {
+    /**
+     * @brief A place where map features can spawn.
+     *
+     * These are defined by the map itself, through IndusfernoMapSpot
+     * actors.
+     */
+    SPOT_KIND_PLACE,
+
+    /**
+     * @brief The position of an industry.
+     *
+     * The spot's owner is the industry's handle.
+     */
+    SPOT_KIND_INDUSTRY,
+
+    /**
+     * @brief The position of a station.
+     *
+     * The spot's owner is the station's handle.
+     */
+    SPOT_KIND_STATION,
+
+    /**
+     * @brief A freed spot, waiting to be reused.
+     */
+    SPOT_KIND_FREE
+};
+
+/**
+ * @brief A bitmask matching a single spot kind, for spot queries.
+ */
+#define SPOT_KIND_MASK(kind) (1u << (kind))
+
+/**
+ * @brief A bitmask matching every spot kind, for spot queries.
+ */
+#define SPOT_KIND_MASK_ALL (SPOT_KIND_MASK(SPOT_KIND_PLACE) | SPOT_KIND_MASK(SPOT_KIND_INDUSTRY) | SPOT_KIND_MASK(SPOT_KIND_STATION))
+
 /**
  * @brief A map spot.
  */
@@ -40,33 +84,93 @@ struct spot_t {
      * @brief Y coordinate of the position of this spot in the world.
      */
     float y;
+
+    /**
+     * @brief What this spot stands for.
+     */
+    enum spot_kind_t kind;
+
+    /**
+     * @brief The handle of whatever this spot stands for.
+     *
+     * Only meaningful for industry and station spots.
+     */
+    size_t owner;
 };
 
 /**
  * @brief The max number of spots that can be defined within the world.
+ *
+ * Besides the places defined by the map, every industry and station
+ * also has a spot of its own.
  */
-#define MAX_SPOTS 512
+#ifndef MAX_SPOTS
+#define MAX_SPOTS 1024
+#endif
 
 /**
  * @brief The max number of spots that can be linked to a single tile.
  */
-#define MAX_SPOTS_PER_TILE 4
+#define MAX_SPOTS_PER_TILE 32
+
+/**
+ * @brief The max number of spotmap tiles in a spotmap.
+ */
+#ifndef MAX_SPOT_TILES
+#define MAX_SPOT_TILES 1024
+#endif
 
 /**
- * @brief The max number of spotmap tiles that can be in a bucket.
+ * @brief The max number of tiles covered by all spots, put together.
+ *
+ * Every industry covers each tile its reach overlaps; see spot_cover.
+ * At most 65535, as covers are indexed by unsigned shorts.
  */
-#define MAX_SPOT_TILES_PER_BUCKET 64
+#ifndef MAX_SPOT_COVERS
+#define MAX_SPOT_COVERS 2048
+#endif
+
+#if MAX_SPOT_COVERS > 65535 || MAX_SPOTS > 65536
+#error MAX_SPOT_COVERS or MAX_SPOTS too large for spot covers
+#endif
 
 /**
- * @brief The number of spotmap buckets in a spotmap.
+ * @brief The max number of slots in a spotmap's tile table.
+ *
+ * Must be a power of two, and larger than MAX_SPOT_TILES, so that the
+ * table never gets more than half full.
  */
-#define NUM_SPOT_BUCKETS_PER_MAP 40
+#define MAX_SPOT_TILE_SLOTS (MAX_SPOT_TILES * 2)
+
+/**
+ * @brief The initial number of slots in a spotmap's tile table.
+ *
+ * Must be a power of two.
+ */
+#define MIN_SPOT_TILE_SLOTS 64
 
 /**
  * @brief The width of a spot tile, along the X and Y axes.
  */
 #define SPOT_TILE_WIDTH 1024
 
+/**
+ * @brief A spot covering a spotmap tile.
+ *
+ * Covers are kept in a pool, and chained into a list for each tile.
+ */
+struct spot_cover_t {
+    /**
+     * @brief The spot covering the tile.
+     */
+    unsigned short spot;
+
+    /**
+     * @brief The index of the next cover of the same tile plus one, or 0 if this is the last.
+     */
+    unsigned short next;
+};
+
 /**
  * @brief A tile subdivision of a spotmap.
  *
@@ -97,21 +201,13 @@ struct spotmap_tile_t {
      * @brief The number of spots in this spotmap tile.
      */
     int num_spots;
-};
-
-/**
- * @brief A bucket of the spotmap.
- */
-struct spotmap_bucket_t {
-    /**
-     * @brief The spotmap tiles in this spotmap bucket.
-     */
-    struct spotmap_tile_t tiles[MAX_SPOT_TILES_PER_BUCKET];
 
     /**
-     * @brief The number of spotmap tiles in this spotmap bucket.
+     * @brief The index of the first spot cover of this tile plus one, or 0 if none.
+     *
+     * @see spot_cover
      */
-    int num_tiles;
+    unsigned short first_cover;
 };
 
 /**
@@ -121,12 +217,39 @@ struct spotmap_bucket_t {
  * proximity to a region along the X and Y axes. It is used to
  * reduce the number of computations needed to find industries
  * close to a station, for instance.
+ *
+ * Tiles are kept in a pool, and found through an open-addressed
+ * table (with linear probing) keyed by the tile coordinates. The
+ * table starts out small and doubles in size whenever it gets
+ * over three quarters full, up to MAX_SPOT_TILE_SLOTS.
  */
 struct spotmap_t {
     /**
-     * @brief The list of spotmap buckets in this spotmap.
+     * @brief All tiles in this spotmap.
+     *
+     * @note Only items up to (num_tiles - 1) should be iterated.
+     */
+    struct spotmap_tile_t tiles[MAX_SPOT_TILES];
+
+    /**
+     * @brief The number of tiles in this spotmap.
      */
-    struct spotmap_bucket_t buckets[NUM_SPOT_BUCKETS_PER_MAP];
+    int num_tiles;
+
+    /**
+     * @brief The tile table.
+     *
+     * Each slot holds the index of a tile in 'tiles', plus one; zero
+     * denotes an empty slot. Only the first num_slots slots are used.
+     */
+    int slots[MAX_SPOT_TILE_SLOTS];
+
+    /**
+     * @brief The number of slots currently in use by the tile table.
+     *
+     * Always a power of two. Zero until the first tile is made.
+     */
+    int num_slots;
 };
 
 /**
@@ -148,6 +271,35 @@ typedef size_t spot_handle_t;
  */
 spot_handle_t make_spot(float x, float y);
 
+/**
+ * @brief Define a new spot that stands for an industry or station.
+ *
+ * Freed spots are reused, if there are any.
+ *
+ * @param x X location of this spot.
+ * @param y Y location of this spot.
+ * @param kind What the spot stands for.
+ * @param owner The handle of what the spot stands for.
+ * @return size_t The opaque handle index to this spot.
+ */
+spot_handle_t make_owned_spot(float x, float y, enum spot_kind_t kind, size_t owner);
+
+/**
+ * @brief Unlinks a spot and frees it, so it may be reused.
+ *
+ * @param ind_spot The opaque handle index to the spot.
+ * @param radius The radius the spot was linked with.
+ */
+error_return_t free_spot(spot_handle_t ind_spot, float radius);
+
+/**
+ * @brief Gets a spot by its handle.
+ *
+ * @param ind_spot The opaque handle index to the spot.
+ * @return const struct spot_t* The spot, or NULL if there is no such spot.
+ */
+const struct spot_t *spot_get(spot_handle_t ind_spot);
+
 /**
  * @brief Links a spot to all tiles within a radius from it.
  *
@@ -164,5 +316,83 @@ error_return_t spot_link(spot_handle_t ind_spot, float radius);
  */
 error_return_t spot_unlink(spot_handle_t ind_spot, float radius);
 
+/**
+ * @brief Makes a spot cover all tiles within a radius from it.
+ *
+ * Unlike linking, covering does not make the spot show up in queries
+ * of the tiles, only in spot_query_cover. It stands for the area a
+ * spot has an effect on, e.g. the reach of an industry.
+ *
+ * Either every tile is covered, or none is.
+ *
+ * @param ind_spot The spot to cover with.
+ * @param radius The radius to cover, as given to spot_uncover later.
+ */
+error_return_t spot_cover(spot_handle_t ind_spot, float radius);
+
+/**
+ * @brief Takes back what spot_cover did.
+ *
+ * Tiles not covered by the spot are left alone.
+ */
+error_return_t spot_uncover(spot_handle_t ind_spot, float radius);
+
+/**
+ * @brief Finds all spots covering the tile a position lies in.
+ *
+ * Only finds the candidates: any spot covering a position is found,
+ * along with those that merely cover some other part of its tile. The
+ * caller has to check the distance against its own radius.
+ *
+ * @param x X coordinate of the position.
+ * @param y Y coordinate of the position.
+ * @param kinds Which spot kinds to find, as a bitmask (see SPOT_KIND_MASK).
+ * @param out Where to store the handles of the spots found.
+ * @param max The number of handles out has room for.
+ * @return size_t The number of spots found.
+ */
+size_t spot_query_cover(float x, float y, unsigned int kinds, spot_handle_t *out, size_t max);
+
+/**
+ * @brief Finds all spots within a circle.
+ *
+ * Only the spotmap tiles overlapping the circle are visited. Spots
+ * linked into several of those tiles are only reported once, and only
+ * if their position is actually within the circle.
+ *
+ * @param x X coordinate of the centre of the circle.
+ * @param y Y coordinate of the centre of the circle.
+ * @param radius The radius of the circle.
+ * @param kinds Which kinds of spot to report, as a bitmask of SPOT_KIND_MASK values.
+ * @param out An array in the which to store the handles of the spots found.
+ * @param max The maximum number of handles to store in out.
+ * @return size_t The number of handles stored in out.
+ */
+size_t spot_query_radius(float x, float y, float radius, unsigned int kinds, spot_handle_t *out, size_t max);
+
+/**
+ * @brief Finds all spots within an axis-aligned rectangle.
+ *
+ * Works like spot_query_radius, but with a rectangle instead.
+ *
+ * @param min_x Lowest X coordinate of the rectangle.
+ * @param min_y Lowest Y coordinate of the rectangle.
+ * @param max_x Highest X coordinate of the rectangle.
+ * @param max_y Highest Y coordinate of the rectangle.
+ * @param kinds Which kinds of spot to report, as a bitmask of SPOT_KIND_MASK values.
+ * @param out An array in the which to store the handles of the spots found.
+ * @param max The maximum number of handles to store in out.
+ * @return size_t The number of handles stored in out.
+ */
+size_t spot_query_rect(float min_x, float min_y, float max_x, float max_y, unsigned int kinds, spot_handle_t *out, size_t max);
+
+/**
+ * @brief Gets the spots and the spotmap, as snapshot regions.
+ *
+ * @param num_regions Where to store the number of regions.
+ * @return const struct snapshot_region_t* The regions, in a fixed order.
+ */
+const struct snapshot_region_t *spot_snapshot_regions(size_t *num_regions);
+
 
 #endif //PLACE_H
@@ -0,0 +1,104 @@
+/**
+ * @file m_acs.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief ACS runtime layer, as implemented on the ZDoom side.
+ * @version added in 0.1
+ * @date 2021-03-14
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * Only meaningful when compiled by gdcc. The native host build provides
+ * its own implementation of m_acs.h, in host/host_acs.c.
+ */
+
+#include "m_acs.h"
+
+#ifdef __GDCC__
+
+#include <ACS_ZDoom.h>
+
+
+/**
+ * @brief The ACS global array the persistent store is kept in.
+ */
+__addrdef __gbl_arr acs_store_array;
+
+static acs_store_array size_t acs_store_used;
+static acs_store_array unsigned int acs_store_words[ACS_STORE_MAX_WORDS];
+
+
+int acs_timer(void) {
+    return ACS_Timer();
+}
+
+void acs_delay(int tics) {
+    ACS_Delay(tics);
+}
+
+int acs_spawn(const char *type, float x, float y) {
+    __str name;
+
+    // the class name has to be made into an ACS string first
+    ACS_BeginPrint();
+
+    for (; *type != '\0'; type++) {
+        ACS_PrintChar(*type);
+    }
+
+    name = ACS_EndStrParam();
+
+    return ACS_SpawnForced(name, x, y, ACS_GetSectorFloorZ(0, x, y), 0, 0) > 0;
+}
+
+void acs_log(const char *text) {
+    ACS_BeginLog();
+
+    for (; *text != '\0'; text++) {
+        ACS_PrintChar(*text);
+    }
+
+    ACS_EndLog();
+}
+
+void acs_store_clear(void) {
+    // stale words past the end are simply overwritten later on
+    acs_store_used = 0;
+}
+
+size_t acs_store_length(void) {
+    return acs_store_used;
+}
+
+int acs_store_append(const unsigned int *words, size_t num_words) {
+    size_t i;
+
+    if (num_words > ACS_STORE_MAX_WORDS - acs_store_used) {
+        return 0;
+    }
+
+    for (i = 0; i < num_words; i++) {
+        acs_store_words[acs_store_used++] = words[i];
+    }
+
+    return 1;
+}
+
+size_t acs_store_read(size_t offset, unsigned int *words, size_t num_words) {
+    size_t i;
+
+    if (offset >= acs_store_used) {
+        return 0;
+    }
+
+    if (num_words > acs_store_used - offset) {
+        num_words = acs_store_used - offset;
+    }
+
+    for (i = 0; i < num_words; i++) {
+        words[i] = acs_store_words[offset + i];
+    }
+
+    return num_words;
+}
+
+#endif // __GDCC__
@@ -0,0 +1,141 @@
+/**
+ * @file m_acs.h
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief A thin layer over the ACS runtime.
+ * @version added in 0.1
+ * @date 2021-03-14
+ *
+ * Everything in Indusferno that needs to talk to the ZDoom ACS VM
+ * (waiting for tics, reading the level timer, and so on) goes through
+ * the functions declared here, instead of calling the ACS_* builtins
+ * directly.
+ *
+ * The gdcc builds implement them in m_acs.c, on top of ACS_ZDoom.h.
+ * The native host build (see host/) links the very same sources
+ * against a stub implementation instead, which is what allows the
+ * simulation to be run and measured outside of ZDoom.
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ */
+
+#ifndef ACS_H
+#define ACS_H
+
+#include <stddef.h>
+
+
+/**
+ * @brief The number of game tics in a second.
+ */
+#define TICRATE 35
+
+/**
+ * @brief The max number of words in the persistent store, on the ZDoom side.
+ */
+#define ACS_STORE_MAX_WORDS (1 << 22)
+
+#ifdef __GDCC__
+
+/**
+ * @brief Declares a script that starts by itself when the level opens.
+ */
+#define ACS_OPEN_SCRIPT(name) [[call("ScriptS"), script("Open")]] void name(void)
+
+/**
+ * @brief Declares a named script, callable with ACS_NamedExecute & co.
+ */
+#define ACS_NAMED_SCRIPT(name) [[call("ScriptS")]] void name(void)
+
+#else
+
+// the host build has no scripts; they are just regular functions there
+#define ACS_OPEN_SCRIPT(name) void name(void)
+#define ACS_NAMED_SCRIPT(name) void name(void)
+
+#endif // __GDCC__
+
+
+/**
+ * @brief Gets the number of tics elapsed since the level started.
+ *
+ * @return int The current level time, in tics.
+ */
+int acs_timer(void);
+
+/**
+ * @brief Suspends the running script for a number of tics.
+ *
+ * @param tics How many tics to wait for.
+ */
+void acs_delay(int tics);
+
+/**
+ * @brief Spawns an actor on the floor, at a position in the map.
+ *
+ * @param type The actor class name to spawn.
+ * @param x X coordinate of where to spawn the actor.
+ * @param y Y coordinate of where to spawn the actor.
+ * @return int 1 if the actor was spawned, 0 otherwise.
+ */
+int acs_spawn(const char *type, float x, float y);
+
+/**
+ * @brief Prints a line of text to the console log.
+ *
+ * Unlike messages printed to players, the console log can be written
+ * to a file (e.g. with ZDoom's -logfile or +logfile), for tools to
+ * pick things up from. The native host prints to stdout instead.
+ *
+ * @param text The line to print, without a trailing newline.
+ */
+void acs_log(const char *text);
+
+/**
+ * @brief Empties the persistent store.
+ *
+ * The persistent store is a sequence of words that outlives the level
+ * it was written in. On the ZDoom side, it is kept in an ACS global
+ * array, which also goes along through hubs and into savegames; on
+ * the native host, it is kept in the file named by host_store_path.
+ */
+void acs_store_clear(void);
+
+/**
+ * @brief Gets the number of words in the persistent store.
+ *
+ * @return size_t The number of words stored.
+ */
+size_t acs_store_length(void);
+
+/**
+ * @brief Appends words at the end of the persistent store.
+ *
+ * @param words The words to append.
+ * @param num_words The number of words to append.
+ * @return int 1 if all words were stored, 0 if there is no room for them.
+ */
+int acs_store_append(const unsigned int *words, size_t num_words);
+
+/**
+ * @brief Reads words from the persistent store.
+ *
+ * @param offset The index of the first word to read.
+ * @param words Where to store the words read.
+ * @param num_words The number of words to read.
+ * @return size_t The number of words read, fewer than asked for past the end of the store.
+ */
+size_t acs_store_read(size_t offset, unsigned int *words, size_t num_words);
+
+#ifndef __GDCC__
+
+/**
+ * @brief The file the persistent store is kept in, on the native host.
+ *
+ * "infindus.snap" unless set otherwise before the store is first used.
+ */
+extern const char *host_store_path;
+
+#endif // __GDCC__
+
+
+#endif // ACS_H
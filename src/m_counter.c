@@ -0,0 +1,133 @@
+/**
+ * @file m_counter.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Hot path counters, and dumping them.
+ * @version added in 0.1
+ * @date 2021-03-17
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * Only meaningful in debug builds; see m_counter.h.
+ */
+
+#include <stdio.h>
+
+#include "m_counter.h"
+#include "m_acs.h"
+#include "m_error.h"
+
+#ifdef DEBUG
+
+
+unsigned int counter_counts[NUM_COUNTERS];
+
+unsigned int counter_errors[NUM_ERROR_CODES];
+
+/**
+ * @brief The counts as of the start of the current period.
+ */
+static unsigned int counter_period_start[NUM_COUNTERS];
+
+/**
+ * @brief The counts of the last whole period.
+ */
+static unsigned int counter_last_period[NUM_COUNTERS];
+
+static int counter_periods = 0;
+
+static const char *const counter_names[NUM_COUNTERS] = {
+    "economy_tick",
+    "industry_end_period",
+    "industry_check_production",
+    "industry_accept_cargo",
+    "station_add_cargo",
+    "station_take_cargo",
+    "station load scans",
+    "station load probes",
+    "spot_find_tile",
+    "spotmap bucket probes",
+    "spot queries",
+    "spot query spots",
+    "route_next_hop",
+    "vehicle events",
+    "errors"
+};
+
+/**
+ * @brief The estimated ACS VM instructions one count of each counter costs.
+ *
+ * Only counts the body of the function or loop itself, not whatever
+ * it calls that is counted on its own.
+ */
+static const unsigned int counter_costs[NUM_COUNTERS] = {
+    40,     // economy_tick
+    150,    // industry_end_period
+    60,     // industry_check_production
+    40,     // industry_accept_cargo
+    60,     // station_add_cargo
+    50,     // station_take_cargo
+    15,     // station load scans
+    12,     // station load probes
+    15,     // spot_find_tile
+    10,     // spotmap bucket probes
+    40,     // spot queries
+    15,     // spot query spots
+    30,     // route_next_hop
+    120,    // vehicle events
+    10      // errors
+};
+
+/**
+ * @brief A line being printed.
+ */
+static char counter_line[128];
+
+
+void counter_end_period(void) {
+    int i;
+
+    for (i = 0; i < NUM_COUNTERS; i++) {
+        counter_last_period[i] = counter_counts[i] - counter_period_start[i];
+        counter_period_start[i] = counter_counts[i];
+    }
+
+    counter_periods++;
+}
+
+void counter_print(void) {
+    const unsigned int tics = counter_last_period[COUNTER_ECONOMY_TICK];
+
+    unsigned int estimate, total_estimate = 0;
+    int i;
+
+    snprintf(counter_line, sizeof(counter_line), "counters over %d periods: total, last period, ~instructions last period", counter_periods);
+    acs_log(counter_line);
+
+    for (i = 0; i < NUM_COUNTERS; i++) {
+        estimate = counter_last_period[i] * counter_costs[i];
+        total_estimate += estimate;
+
+        snprintf(counter_line, sizeof(counter_line), "  %-26s %10u %10u %12u", counter_names[i], counter_counts[i], counter_last_period[i], estimate);
+        acs_log(counter_line);
+    }
+
+    snprintf(counter_line, sizeof(counter_line), "  ~%u instructions last period, ~%u per tic", total_estimate, tics > 0 ? total_estimate / tics : 0);
+    acs_log(counter_line);
+
+    for (i = 0; i < NUM_ERROR_CODES; i++) {
+        if (counter_errors[i] > 0) {
+            snprintf(counter_line, sizeof(counter_line), "  %10u  %s", counter_errors[i], error_string(i));
+            acs_log(counter_line);
+        }
+    }
+}
+
+/**
+ * @brief Dumps every counter to the console log.
+ */
+ACS_NAMED_SCRIPT(counter_dump) {
+    counter_print();
+}
+
+
+#endif // DEBUG
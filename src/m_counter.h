@@ -0,0 +1,131 @@
+/**
+ * @file m_counter.h
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Hot path counters for debug builds.
+ * @version added in 0.1
+ * @date 2021-03-17
+ *
+ * Counts how often hot functions are called, how many times their
+ * inner loops go around, and how often each error is signaled, along
+ * with an estimate of how many ACS VM instructions all that takes per
+ * economy period. Each counter has a rough, hand-made estimate of the
+ * instructions one count of it costs (see m_counter.c); they are meant
+ * to tell hot spots apart, not to add up to an exact budget.
+ *
+ * Counters only exist in debug builds (those that define DEBUG). In
+ * any other build, COUNT, COUNT_N and counter_end_period compile to
+ * nothing at all. They are not thread-safe either, which is fine, as
+ * only the ACS builds are debug builds.
+ *
+ * The counter_dump script prints every counter to the console log.
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ */
+
+#ifndef COUNTER_H
+#define COUNTER_H
+
+
+/**
+ * @brief A counter.
+ */
+enum counter_t {
+    COUNTER_ECONOMY_TICK,
+    COUNTER_INDUSTRY_END_PERIOD,
+    COUNTER_INDUSTRY_CHECK_PRODUCTION,
+    COUNTER_INDUSTRY_ACCEPT_CARGO,
+    COUNTER_STATION_ADD_CARGO,
+    COUNTER_STATION_TAKE_CARGO,
+
+    /**
+     * @brief Lookups of a cargo load in a station's load table.
+     */
+    COUNTER_STATION_LOAD_SCAN,
+
+    /**
+     * @brief Slots probed by station load table lookups.
+     */
+    COUNTER_STATION_LOAD_PROBE,
+
+    COUNTER_SPOT_FIND_TILE,
+
+    /**
+     * @brief Buckets probed by spot_find_tile.
+     */
+    COUNTER_SPOTMAP_PROBE,
+
+    COUNTER_SPOT_QUERY,
+
+    /**
+     * @brief Spots looked at by spot queries, in the tiles they cover.
+     */
+    COUNTER_SPOT_QUERY_SPOT,
+
+    COUNTER_ROUTE_NEXT_HOP,
+
+    /**
+     * @brief Vehicles taken off the event queue, to arrive or depart.
+     */
+    COUNTER_VEHICLE_EVENT,
+
+    /**
+     * @brief Errors signaled, whether logged or not.
+     */
+    COUNTER_ERROR,
+
+    NUM_COUNTERS
+};
+
+#ifdef DEBUG
+
+/**
+ * @brief The count of each counter, since the level started.
+ */
+extern unsigned int counter_counts[NUM_COUNTERS];
+
+/**
+ * @brief The count of each error code signaled, since the level started.
+ */
+extern unsigned int counter_errors[];
+
+/**
+ * @brief Counts one more of a counter.
+ */
+#define COUNT(counter) ((void) counter_counts[(counter)]++)
+
+/**
+ * @brief Counts a number more of a counter, e.g. the iterations of a loop.
+ */
+#define COUNT_N(counter, n) ((void) (counter_counts[(counter)] += (n)))
+
+/**
+ * @brief Counts an error signaled.
+ */
+#define COUNT_ERROR(error_code) ((void) (counter_counts[COUNTER_ERROR]++, counter_errors[(error_code)]++))
+
+/**
+ * @brief Marks the end of an economy period.
+ *
+ * The counts of the period that just ended are kept apart, so that
+ * they can be dumped along with the totals.
+ */
+void counter_end_period(void);
+
+/**
+ * @brief Prints every counter to the console log.
+ *
+ * This is what the counter_dump script does.
+ */
+void counter_print(void);
+
+#else
+
+#define COUNT(counter) ((void) 0)
+#define COUNT_N(counter, n) ((void) 0)
+#define COUNT_ERROR(error_code) ((void) 0)
+#define counter_end_period() ((void) 0)
+
+#endif // DEBUG
+
+
+#endif // COUNTER_H
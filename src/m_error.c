@@ -20,31 +20,68 @@ error_return_t _err;
 
 
 static const char *const error_strings[] = {
+    "No error",
     "No industry exists with index passed",
     "Industry type is unknown",
     "Industry supply type is unknown",
     "Industry does not have accepted-cargo type passed",
+    "Too many industries defined",
+    "Too many stations within reach of industry",
     "No company exists with index passed",
+    "Company with handle passed was dissolved",
+    "Too many companies founded",
     "Company already has chairman",
     "Company already doesn't have chairman",
+    "No player exists with number passed",
+    "Player already chairs another company",
+    "Company cannot have more chairmen",
+    "Company chairmen and the company of players disagree",
     "Company does not have sufficient money to pay back",
     "Company cannot loan more; debt alreadcy maxed out",
+    "No ledger category exists with index passed",
+    "Ledger does not go that many periods back",
     "No station exists with index passed",
+    "Too many stations built",
+    "Too many distinct cargo loads in station",
+    "No vehicle exists with index passed",
+    "Too many vehicles built",
+    "Too many orders given to vehicle",
+    "Too many cargo compartments in vehicle",
+    "Too many links between stations",
     "No spot exists with index passed",
     "Spot index not found in tile for unlinking; probably incorrect" \
         "radius value passed",
     "Too many spots defined",
-    "Invalid cargo type index passed"
+    "Too many spots linked to the same spotmap tile",
+    "Too many spotmap tiles; spots are too spread out",
+    "Too many spotmap tiles covered by spots",
+    "Invalid cargo type index passed",
+    "Too many or too large regions to snapshot",
+    "Snapshot store is full",
+    "No snapshot stored to restore",
+    "Stored snapshot is of a different build or version",
+    "Stored snapshot is truncated or corrupt",
+    "A snapshot is already being written or restored",
+    "No snapshot is being written or restored",
+    "Could not start worker threads"
 };
 
 
+const char *error_string(enum error_code_t error_code) {
+    return error_strings[error_code];
+}
+
 void _error(enum error_code_t error_code) {
+    COUNT_ERROR(error_code);
+
 #ifdef DEBUG
     printf("\\cx[WARNING] %s\\c-", error_strings[error_code]);
 #endif
 }
 
 void _error_c(enum error_code_t error_code, const char *context) {
+    COUNT_ERROR(error_code);
+
 #ifdef DEBUG
     printf("\\cx[WARNING] In %s: %s\\c-", context, error_strings[error_code]);
 #endif
@@ -23,6 +23,8 @@
 #ifndef ERROR_H
 #define ERROR_H
 
+#include "m_counter.h"
+
 /**
  * @brief A list of error codes.
  *
@@ -47,20 +49,55 @@
  * @see errclv
  */
 enum error_code_t {
+    /**
+     * @brief Never returned; it only keeps every actual error code non-zero, so that its negative never reads as success.
+     */
+    ERR_NONE,
+
     ERR_INDUSTRY_BAD_INDEX,
     ERR_INDUSTRY_BAD_TYPE,
     ERR_INDUSTRY_BAD_SUP_TYPE,
     ERR_INDUSTRY_BAD_ACCEPT,
+    ERR_INDUSTRY_MAXED,
+    ERR_INDUSTRY_CATCHMENT_FULL,
     ERR_COMPANY_BAD_INDEX,
+    ERR_COMPANY_DISSOLVED,
+    ERR_COMPANY_MAXED,
     ERR_COMPANY_ALREADY_HAS_CHAIRMAN,
     ERR_COMPANY_ALREADY_HAS_NOT_CHAIRMAN,
+    ERR_COMPANY_BAD_PLAYER,
+    ERR_COMPANY_PLAYER_HAS_COMPANY,
+    ERR_COMPANY_CHAIRMEN_FULL,
+    ERR_COMPANY_CHAIRMEN_MISMATCH,
     ERR_COMPANY_LOAN_PAYBACK_EXCEED_BALANCE,
     ERR_COMPANY_LOAN_MAXED_OUT,
+    ERR_COMPANY_BAD_LEDGER_CATEGORY,
+    ERR_COMPANY_BAD_LEDGER_PERIOD,
     ERR_STATION_BAD_INDEX,
+    ERR_STATION_MAXED,
+    ERR_STATION_LOADS_FULL,
+    ERR_VEHICLE_BAD_INDEX,
+    ERR_VEHICLE_MAXED,
+    ERR_VEHICLE_ORDERS_FULL,
+    ERR_VEHICLE_COMPARTMENTS_FULL,
+    ERR_ROUTE_LINKS_FULL,
     ERR_PLACE_BAD_SPOT_INDEX,
     ERR_PLACE_UNLINK_SPOT_NOT_FOUND,
     ERR_PLACE_MAXED_SPOTS,
-    ERR_BAD_MATERIAL
+    ERR_PLACE_TILE_FULL,
+    ERR_PLACE_MAXED_TILES,
+    ERR_PLACE_MAXED_COVERS,
+    ERR_BAD_MATERIAL,
+    ERR_SNAPSHOT_BAD_REGIONS,
+    ERR_SNAPSHOT_STORE_FULL,
+    ERR_SNAPSHOT_NONE,
+    ERR_SNAPSHOT_BAD_LAYOUT,
+    ERR_SNAPSHOT_CORRUPT,
+    ERR_SNAPSHOT_BUSY,
+    ERR_SNAPSHOT_IDLE,
+    ERR_WORKERS_START,
+
+    NUM_ERROR_CODES
 };
 
 /**
@@ -105,7 +142,7 @@ typedef signed int error_return_t;
 /**
  * @brief Returns an error code as a signal. without ever logging it.
  */
-#define codei(error_code) { return -error_code; }
+#define codei(error_code) { COUNT_ERROR(error_code); return -error_code; }
 
 /**
  * @brief Checks if a function returns an error, and if so returns.
@@ -184,6 +221,14 @@ void _error(enum error_code_t error_code);
  */
 void _error_c(enum error_code_t error_code, const char *context);
 
+/**
+ * @brief Gets the message of an error.
+ *
+ * @param error_code The positive code of the error.
+ * @return const char* The message printed for the error.
+ */
+const char *error_string(enum error_code_t error_code);
+
 /**
  * @brief The context of an error.
  *
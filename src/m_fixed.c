@@ -0,0 +1,114 @@
+/**
+ * @file m_fixed.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Fixed-point economy arithmetic.
+ * @version added in 0.1
+ * @date 2021-03-16
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * Multiplication and division of fixed-point amounts, without ever
+ * needing integers wider than 32 bits, which the ACS VM does not have.
+ * Only meaningful if the fixed mode is selected (see m_fixed.h).
+ */
+
+#include "m_fixed.h"
+
+#ifdef ECONOMY_fixed
+
+
+#define ECON_FRAC_MASK ((unsigned int) ECON_ONE - 1)
+
+/**
+ * @brief Gives an unsigned magnitude its sign back, saturating it to ECON_MAX.
+ */
+static econ_t _econ_signed(unsigned int magnitude, int negative) {
+    if (magnitude > (unsigned int) ECON_MAX) {
+        magnitude = ECON_MAX;
+    }
+
+    return negative ? -(econ_t) magnitude : (econ_t) magnitude;
+}
+
+econ_t econ_add(econ_t a, econ_t b) {
+    if (b > 0 ? a > ECON_MAX - b : a < -ECON_MAX - b) {
+        return b > 0 ? ECON_MAX : -ECON_MAX;
+    }
+
+    return a + b;
+}
+
+econ_t econ_mul(econ_t a, econ_t b) {
+    const int negative = (a < 0) != (b < 0);
+    const unsigned int ua = a < 0 ? -(unsigned int) a : (unsigned int) a;
+    const unsigned int ub = b < 0 ? -(unsigned int) b : (unsigned int) b;
+
+    // split each operand at the binary point; no partial product of
+    // a whole half and a fractional half can exceed 31 bits
+    const unsigned int a_int = ua >> ECON_FRAC_BITS, a_frac = ua & ECON_FRAC_MASK;
+    const unsigned int b_int = ub >> ECON_FRAC_BITS, b_frac = ub & ECON_FRAC_MASK;
+
+    unsigned int product;
+
+    if (a_int != 0 && b_int > ((unsigned int) ECON_MAX >> ECON_FRAC_BITS) / a_int) {
+        return _econ_signed(ECON_MAX, negative);
+    }
+
+    product = (a_int * b_int) << ECON_FRAC_BITS;
+    product += a_int * b_frac;
+
+    if (product > (unsigned int) ECON_MAX) {
+        return _econ_signed(ECON_MAX, negative);
+    }
+
+    product += a_frac * b_int;
+
+    if (product > (unsigned int) ECON_MAX) {
+        return _econ_signed(ECON_MAX, negative);
+    }
+
+    product += (a_frac * b_frac) >> ECON_FRAC_BITS;
+
+    return _econ_signed(product, negative);
+}
+
+econ_t econ_div(econ_t a, econ_t b) {
+    const int negative = (a < 0) != (b < 0);
+    const unsigned int ua = a < 0 ? -(unsigned int) a : (unsigned int) a;
+    const unsigned int ub = b < 0 ? -(unsigned int) b : (unsigned int) b;
+
+    unsigned int whole, rest;
+    int i;
+
+    if (ub == 0) {
+        return ua == 0 ? 0 : _econ_signed(ECON_MAX, negative);
+    }
+
+    whole = ua / ub;
+    rest = ua % ub;
+
+    if (whole > ((unsigned int) ECON_MAX >> ECON_FRAC_BITS)) {
+        return _econ_signed(ECON_MAX, negative);
+    }
+
+    if (ub <= (unsigned int) ECON_MAX >> ECON_FRAC_BITS) {
+        // the remainder can be shifted into place all at once
+        return _econ_signed((whole << ECON_FRAC_BITS) + (rest << ECON_FRAC_BITS) / ub, negative);
+    }
+
+    // long division, one fractional bit at a time; rest < ub <= 2^31,
+    // so doubling it never overflows
+    for (i = 0; i < ECON_FRAC_BITS; i++) {
+        rest <<= 1;
+        whole <<= 1;
+
+        if (rest >= ub) {
+            rest -= ub;
+            whole |= 1;
+        }
+    }
+
+    return _econ_signed(whole, negative);
+}
+
+#endif // ECONOMY_fixed
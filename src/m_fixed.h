@@ -0,0 +1,130 @@
+/**
+ * @file m_fixed.h
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief The numeric type of all economy amounts.
+ * @version added in 0.1
+ * @date 2021-03-16
+ *
+ * Material, production, cargo amounts, pickup rates and balances are
+ * all of type econ_t, which is picked at build time:
+ *
+ *  - float (the default): plain floating point, as in any C program;
+ *  - fixed: a 32-bit signed integer with ECON_FRAC_BITS fractional
+ *    bits. Every operation on it is a native integer operation of the
+ *    ACS VM, where gdcc would otherwise emulate floats in software,
+ *    and it rounds exactly the same way on every machine, so peers in
+ *    a multiplayer game can never drift apart.
+ *
+ * The fixed mode is selected by defining ECONOMY_fixed; build.ninja
+ * does so from its 'numeric' variable.
+ *
+ * Code meant to build in both modes adds, subtracts and compares
+ * amounts as usual, and may multiply or divide them by plain integers,
+ * but goes through econ_mul and econ_div to multiply or divide two
+ * amounts together, and writes constants with ECON_C. Amounts that
+ * may grow without bound are accumulated with econ_add. Conversions
+ * from and to float are only meant for the edges of the economy, e.g.
+ * distances, which are always floats.
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ */
+
+#ifndef FIXED_H
+#define FIXED_H
+
+
+#ifdef ECONOMY_fixed
+
+#include <limits.h>
+
+/**
+ * @brief The number of fractional bits of a fixed-point amount.
+ *
+ * ACS's own fixed type has 16, but that only leaves room for amounts
+ * below 32768, which cargo piling up in a busy station outgrows in a
+ * few periods. 8 bits still resolve 1/256 of a Cargo Unit, and allow
+ * for amounts of up to 8388608.
+ */
+#ifndef ECON_FRAC_BITS
+#define ECON_FRAC_BITS 8
+#endif
+
+/**
+ * @brief An economy amount.
+ */
+typedef int econ_t;
+
+/**
+ * @brief The amount 1.
+ */
+#define ECON_ONE (1 << ECON_FRAC_BITS)
+
+/**
+ * @brief The largest amount; econ_add, econ_mul and econ_div saturate to it.
+ *
+ * The smallest one is its negative, so that every amount can always
+ * be negated.
+ */
+#define ECON_MAX INT_MAX
+
+/**
+ * @brief An amount constant, from a number literal.
+ *
+ * Rounded to the nearest representable amount, at compile time.
+ */
+#define ECON_C(x) ((econ_t) ((x) * (double) ECON_ONE + ((x) < 0 ? -0.5 : 0.5)))
+
+#define econ_from_int(i) ((econ_t) (i) * ECON_ONE)
+#define econ_to_int(x) ((int) ((x) / ECON_ONE))
+#define econ_from_float(f) ((econ_t) ((f) * (float) ECON_ONE))
+#define econ_to_float(x) ((float) (x) / ECON_ONE)
+
+/**
+ * @brief Adds two amounts, saturating to ±ECON_MAX.
+ *
+ * For amounts that keep accumulating, such as cargo waiting in a
+ * station, or a company's balance.
+ */
+econ_t econ_add(econ_t a, econ_t b);
+
+/**
+ * @brief Multiplies two amounts.
+ *
+ * Never overflows, not even in intermediate results, as it only ever
+ * multiplies halves of its operands together. Saturates to ±ECON_MAX
+ * if the product is out of range, and rounds toward zero otherwise.
+ */
+econ_t econ_mul(econ_t a, econ_t b);
+
+/**
+ * @brief Divides an amount by another.
+ *
+ * Never overflows, not even in intermediate results. Saturates to
+ * ±ECON_MAX if the quotient is out of range, or if b is 0 (unless a
+ * is 0 as well, which gives 0), and rounds toward zero otherwise.
+ */
+econ_t econ_div(econ_t a, econ_t b);
+
+#else
+
+#include <float.h>
+
+typedef float econ_t;
+
+#define ECON_ONE 1.0f
+#define ECON_MAX FLT_MAX
+#define ECON_C(x) ((econ_t) (x))
+
+#define econ_from_int(i) ((econ_t) (i))
+#define econ_to_int(x) ((int) (x))
+#define econ_from_float(f) ((econ_t) (f))
+#define econ_to_float(x) ((float) (x))
+
+#define econ_add(a, b) ((a) + (b))
+#define econ_mul(a, b) ((a) * (b))
+#define econ_div(a, b) ((a) / (b))
+
+#endif // ECONOMY_fixed
+
+
+#endif // FIXED_H
@@ -0,0 +1,124 @@
+/**
+ * @file m_profile.h
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Capacity profiles.
+ * @version added in 0.1
+ * @date 2021-03-16
+ *
+ * All world state lives in static arrays, whose sizes are fixed at
+ * build time by the MAX_* macros of each module. A capacity profile
+ * sets all of them at once, for a given size of map:
+ *
+ *  - small: for small maps, with a fraction of the default capacity;
+ *  - default: the capacities each module defines by itself;
+ *  - huge: for huge maps, with several times the default capacity.
+ *
+ * A profile is selected by defining PROFILE_small or PROFILE_huge; the
+ * default profile is used otherwise. build.ninja does so from its
+ * 'profile' variable. Any MAX_* macro may still be overridden on its
+ * own, which takes precedence over the profile.
+ *
+ * Each profile also has a memory budget, in bytes, which may also be
+ * overridden by defining PROFILE_MEMORY_BUDGET. The memory report made
+ * at build time (see host/host_memreport.c) fails the build if the
+ * static tables of a profile add up to more than that.
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+
+#if defined(PROFILE_small)
+
+#define PROFILE_NAME "small"
+
+#ifndef PROFILE_MEMORY_BUDGET
+#define PROFILE_MEMORY_BUDGET 393216
+#endif
+
+#ifndef MAX_INDUSTRIES
+#define MAX_INDUSTRIES 48
+#endif
+
+#ifndef MAX_STATIONS
+#define MAX_STATIONS 48
+#endif
+
+#ifndef MAX_COMPANIES
+#define MAX_COMPANIES 16
+#endif
+
+#ifndef MAX_VEHICLES
+#define MAX_VEHICLES 192
+#endif
+
+#ifndef MAX_ROUTE_LINKS
+#define MAX_ROUTE_LINKS 384
+#endif
+
+#ifndef MAX_SPOTS
+#define MAX_SPOTS 256
+#endif
+
+#ifndef MAX_SPOT_TILES
+#define MAX_SPOT_TILES 256
+#endif
+
+#ifndef MAX_SPOT_COVERS
+#define MAX_SPOT_COVERS 512
+#endif
+
+#elif defined(PROFILE_huge)
+
+#define PROFILE_NAME "huge"
+
+#ifndef PROFILE_MEMORY_BUDGET
+#define PROFILE_MEMORY_BUDGET 4194304
+#endif
+
+#ifndef MAX_INDUSTRIES
+#define MAX_INDUSTRIES 512
+#endif
+
+#ifndef MAX_STATIONS
+#define MAX_STATIONS 512
+#endif
+
+#ifndef MAX_COMPANIES
+#define MAX_COMPANIES 64
+#endif
+
+#ifndef MAX_VEHICLES
+#define MAX_VEHICLES 2048
+#endif
+
+#ifndef MAX_ROUTE_LINKS
+#define MAX_ROUTE_LINKS 4096
+#endif
+
+#ifndef MAX_SPOTS
+#define MAX_SPOTS 4096
+#endif
+
+#ifndef MAX_SPOT_TILES
+#define MAX_SPOT_TILES 4096
+#endif
+
+#ifndef MAX_SPOT_COVERS
+#define MAX_SPOT_COVERS 8192
+#endif
+
+#else
+
+#define PROFILE_NAME "default"
+
+#ifndef PROFILE_MEMORY_BUDGET
+#define PROFILE_MEMORY_BUDGET 1048576
+#endif
+
+#endif
+
+
+#endif // PROFILE_H
@@ -0,0 +1,159 @@
+/**
+ * @file m_replay.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Economy event log.
+ * @version added in 0.1
+ * @date 2021-03-17
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * Keeps the ring buffer of recorded events, and dumps it to the
+ * console log along with the persistent store.
+ */
+
+#include <string.h>
+
+#include "m_replay.h"
+#include "m_acs.h"
+
+
+/**
+ * @brief The ring buffer of events, indexed by event number.
+ */
+static struct replay_event_t replay_log[REPLAY_LOG_EVENTS];
+
+/**
+ * @brief The number of events ever recorded.
+ */
+static unsigned int replay_head = 0;
+
+/**
+ * @brief The line of a dump being printed.
+ *
+ * Room for a tag, and a space and 8 digits for each word.
+ */
+static char replay_line[16 + 9 * (REPLAY_DUMP_LINE_WORDS > REPLAY_EVENT_WORDS ? REPLAY_DUMP_LINE_WORDS : REPLAY_EVENT_WORDS)];
+
+
+void replay_record(enum replay_kind_t kind, int subject, int arg0, int arg1, int arg2, econ_t amount, econ_t before, econ_t after) {
+#ifdef INDUSTRY_THREADS
+    // worker threads may record events too (see h_industry.h)
+    struct replay_event_t *const event = &replay_log[__atomic_fetch_add(&replay_head, 1, __ATOMIC_RELAXED) % REPLAY_LOG_EVENTS];
+#else
+    struct replay_event_t *const event = &replay_log[replay_head++ % REPLAY_LOG_EVENTS];
+#endif
+
+    event->kind = kind;
+    event->subject = subject;
+    event->args[0] = arg0;
+    event->args[1] = arg1;
+    event->args[2] = arg2;
+    event->amount = amount;
+    event->before = before;
+    event->after = after;
+}
+
+unsigned int replay_count(void) {
+    return replay_head;
+}
+
+const struct replay_event_t *replay_get(unsigned int number) {
+    if (number >= replay_head || replay_head - number > REPLAY_LOG_EVENTS) {
+        return NULL;
+    }
+
+    return &replay_log[number % REPLAY_LOG_EVENTS];
+}
+
+void replay_encode(const struct replay_event_t *event, unsigned int *words) {
+    words[0] = (unsigned int) event->kind;
+    words[1] = (unsigned int) event->subject;
+    words[2] = (unsigned int) event->args[0];
+    words[3] = (unsigned int) event->args[1];
+    words[4] = (unsigned int) event->args[2];
+
+    // amounts are dumped bit for bit, in either numeric mode
+    memcpy(&words[5], &event->amount, sizeof(unsigned int));
+    memcpy(&words[6], &event->before, sizeof(unsigned int));
+    memcpy(&words[7], &event->after, sizeof(unsigned int));
+}
+
+void replay_decode(const unsigned int *words, struct replay_event_t *event) {
+    event->kind = (enum replay_kind_t) words[0];
+    event->subject = (int) words[1];
+    event->args[0] = (int) words[2];
+    event->args[1] = (int) words[3];
+    event->args[2] = (int) words[4];
+
+    memcpy(&event->amount, &words[5], sizeof(unsigned int));
+    memcpy(&event->before, &words[6], sizeof(unsigned int));
+    memcpy(&event->after, &words[7], sizeof(unsigned int));
+}
+
+/**
+ * @brief Prints a line of the dump, as a tag followed by words in hexadecimal.
+ */
+static void _replay_print_words(const char *tag, const unsigned int *words, size_t num_words) {
+    static const char digits[] = "0123456789ABCDEF";
+
+    char *out = replay_line;
+    size_t i;
+    int shift;
+
+    for (; *tag != '\0'; tag++) {
+        *out++ = *tag;
+    }
+
+    for (i = 0; i < num_words; i++) {
+        *out++ = ' ';
+
+        for (shift = 28; shift >= 0; shift -= 4) {
+            *out++ = digits[(words[i] >> shift) & 0xF];
+        }
+    }
+
+    *out = '\0';
+
+    acs_log(replay_line);
+}
+
+void replay_print(void) {
+    const size_t store_length = acs_store_length();
+    const unsigned int first = replay_head > REPLAY_LOG_EVENTS ? replay_head - REPLAY_LOG_EVENTS : 0;
+
+    unsigned int words[REPLAY_DUMP_LINE_WORDS > REPLAY_EVENT_WORDS ? REPLAY_DUMP_LINE_WORDS : REPLAY_EVENT_WORDS];
+    unsigned int number;
+    size_t offset, num_words;
+
+    words[0] = REPLAY_VERSION;
+    words[1] = (unsigned int) ECON_ONE;
+    words[2] = replay_head;
+    words[3] = replay_head - first;
+    words[4] = (unsigned int) store_length;
+
+    _replay_print_words("IFREPLAY", words, 5);
+
+    for (offset = 0; offset < store_length; offset += num_words) {
+        num_words = acs_store_read(offset, words, REPLAY_DUMP_LINE_WORDS);
+
+        if (num_words == 0) {
+            break;
+        }
+
+        _replay_print_words("IFSTORE", words, num_words);
+    }
+
+    for (number = first; number != replay_head; number++) {
+        replay_encode(&replay_log[number % REPLAY_LOG_EVENTS], words);
+        _replay_print_words("IFEVENT", words, REPLAY_EVENT_WORDS);
+    }
+
+    acs_log("IFREPLAY END");
+}
+
+/**
+ * @brief Dumps the event log, for the native replay tool to replay (see m_replay.h).
+ */
+ACS_NAMED_SCRIPT(replay_dump) {
+    replay_print();
+}
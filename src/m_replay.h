@@ -0,0 +1,198 @@
+/**
+ * @file m_replay.h
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief A log of economy events, for replaying them later on.
+ * @version added in 0.1
+ * @date 2021-03-17
+ *
+ * Every call that moves money or cargo around (company_post, which
+ * company_add_to_balance goes through, company_loan, station_add_cargo
+ * and industry_accept_cargo) records
+ * an event into a ring buffer of REPLAY_LOG_EVENTS fixed-size events,
+ * along with what the value it changed was before and after the call.
+ * So does every snapshot written, as a mark in the log. Recording an event is just
+ * a handful of stores, so it is never turned off.
+ *
+ * The replay_dump script prints the log to the console log, along with
+ * the persistent store (see m_acs.h), as lines of hexadecimal words:
+ *
+ *  - "IFREPLAY", the replay format version, ECON_ONE, the number of
+ *    events ever recorded, the number of events that follow, and the
+ *    number of store words that follow;
+ *  - "IFSTORE", then up to REPLAY_DUMP_LINE_WORDS words of the store;
+ *  - "IFEVENT", then the REPLAY_EVENT_WORDS words of an event, oldest
+ *    first;
+ *  - "IFREPLAY END".
+ *
+ * The native replay tool (host/host_replay.c) reads such a dump out of
+ * any log file, restores the world from its store, and calls the very
+ * same functions again for every event after the mark of the last
+ * snapshot, checking that each changes its value by just as much as
+ * it did in the game. Values may still drift apart from the ones in
+ * the log, since not everything that changes them is recorded (e.g.
+ * production, or vehicles loading cargo); the tool reports drift apart
+ * from calls that actually came out differently. As with snapshots, a
+ * dump can only be replayed by the same build that wrote it.
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "m_fixed.h"
+#include "m_profile.h"
+
+
+/**
+ * @brief The version of the dump format.
+ *
+ * Must be bumped whenever the events or the dump change layout.
+ */
+#define REPLAY_VERSION 1
+
+/**
+ * @brief The number of events the log keeps; older ones are overwritten.
+ *
+ * Must be a power of two.
+ */
+#ifndef REPLAY_LOG_EVENTS
+#if defined(PROFILE_small)
+#define REPLAY_LOG_EVENTS 256
+#elif defined(PROFILE_huge)
+#define REPLAY_LOG_EVENTS 4096
+#else
+#define REPLAY_LOG_EVENTS 1024
+#endif
+#endif
+
+#if (REPLAY_LOG_EVENTS & (REPLAY_LOG_EVENTS - 1)) != 0
+#error REPLAY_LOG_EVENTS must be a power of two
+#endif
+
+/**
+ * @brief The number of words an event is dumped as.
+ */
+#define REPLAY_EVENT_WORDS 8
+
+/**
+ * @brief The max number of store words in a line of a dump.
+ */
+#define REPLAY_DUMP_LINE_WORDS 8
+
+/**
+ * @brief The kind of an event.
+ */
+enum replay_kind_t {
+    /**
+     * @brief A snapshot was written; subject is its sequence number.
+     */
+    REPLAY_SNAPSHOT,
+
+    /**
+     * @brief company_post; the first argument is the ledger category, and the value is the balance.
+     */
+    REPLAY_COMPANY_BALANCE,
+
+    /**
+     * @brief company_loan; the value is the debt.
+     */
+    REPLAY_COMPANY_LOAN,
+
+    /**
+     * @brief station_add_cargo or station_add_aged_cargo.
+     *
+     * The arguments are the cargo type, the origin and the age; the
+     * value is the amount of the station's cargo load.
+     */
+    REPLAY_STATION_CARGO,
+
+    /**
+     * @brief industry_accept_cargo.
+     *
+     * The first argument is the accept slot; the value is the amount
+     * of material in it.
+     */
+    REPLAY_INDUSTRY_ACCEPT,
+
+    NUM_REPLAY_KINDS
+};
+
+/**
+ * @brief An event in the log.
+ */
+struct replay_event_t {
+    enum replay_kind_t kind;
+
+    /**
+     * @brief The company, station or industry the event is about.
+     */
+    int subject;
+
+    /**
+     * @brief Any other arguments of the call, depending on the kind.
+     */
+    int args[3];
+
+    /**
+     * @brief The amount passed to the call.
+     */
+    econ_t amount;
+
+    /**
+     * @brief The value changed by the call, before and after it.
+     */
+    econ_t before, after;
+};
+
+
+/**
+ * @brief Records an event into the log.
+ *
+ * Only calls that succeed are recorded. On the native host, events
+ * may be recorded from worker threads, as long as those only touch
+ * distinct subjects at once; events about the same subject are then
+ * still in order.
+ */
+void replay_record(enum replay_kind_t kind, int subject, int arg0, int arg1, int arg2, econ_t amount, econ_t before, econ_t after);
+
+/**
+ * @brief Gets the number of events ever recorded.
+ *
+ * @return unsigned int The number of events, which is also the number of the next one.
+ */
+unsigned int replay_count(void);
+
+/**
+ * @brief Gets an event from the log, by its number.
+ *
+ * @param number The number of the event, counting from 0.
+ * @return const struct replay_event_t* The event, or NULL if it was overwritten or not recorded yet.
+ */
+const struct replay_event_t *replay_get(unsigned int number);
+
+/**
+ * @brief Encodes an event as the words it is dumped as.
+ *
+ * @param event The event to encode.
+ * @param words Where to store its REPLAY_EVENT_WORDS words.
+ */
+void replay_encode(const struct replay_event_t *event, unsigned int *words);
+
+/**
+ * @brief Decodes an event from the words it was dumped as.
+ *
+ * @param words The REPLAY_EVENT_WORDS words of the event.
+ * @param event Where to store the event.
+ */
+void replay_decode(const unsigned int *words, struct replay_event_t *event);
+
+/**
+ * @brief Prints the log and the persistent store to the console log.
+ *
+ * This is what the replay_dump script does.
+ */
+void replay_print(void);
+
+
+#endif // REPLAY_H
@@ -0,0 +1,659 @@
+/**
+ * @file m_snapshot.c
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Snapshot writing and restoring.
+ * @version added in 0.1
+ * @date 2021-03-17
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ *
+ * Encodes regions of memory into block snapshots in the persistent
+ * store, and decodes them back.
+ */
+
+#include <string.h>
+
+#include "m_snapshot.h"
+#include "m_acs.h"
+#include "m_fixed.h"
+
+
+/**
+ * @brief The number of words in a snapshot header.
+ */
+#define SNAPSHOT_HEADER_WORDS 5
+
+/**
+ * @brief The value every hash starts out from (FNV-1a's offset basis).
+ */
+#define SNAPSHOT_HASH_BASIS 2166136261u
+
+/**
+ * @brief The sequence number of the last snapshot written or restored whole.
+ *
+ * 0 if there is none, in which case the block hashes of the regions
+ * cannot be trusted, and the next snapshot must be full.
+ */
+static unsigned int snapshot_last_sequence = 0;
+
+/**
+ * @brief The layout of the regions of the last snapshot.
+ */
+static unsigned int snapshot_last_layout = 0;
+
+/**
+ * @brief The checksum of the snapshot being written or read, so far.
+ */
+static unsigned int snapshot_checksum;
+
+/**
+ * @brief A block being written or read.
+ *
+ * The first word is the block's index word; its contents follow.
+ */
+static unsigned int snapshot_block[SNAPSHOT_BLOCK_WORDS + 1];
+
+/**
+ * @brief What a snapshot pass is doing.
+ */
+enum snapshot_phase_t {
+    SNAPSHOT_PHASE_IDLE,
+
+    /**
+     * @brief Writing blocks, from snapshot_ind_region and snapshot_ind_block on.
+     */
+    SNAPSHOT_PHASE_WRITE,
+
+    /**
+     * @brief Finding how many snapshots in the store are whole.
+     */
+    SNAPSHOT_PHASE_CHECK,
+
+    /**
+     * @brief Zeroing blocks, before the full snapshot is restored over them.
+     */
+    SNAPSHOT_PHASE_ZERO,
+
+    /**
+     * @brief Copying the blocks of the whole snapshots into the regions.
+     */
+    SNAPSHOT_PHASE_APPLY,
+
+    /**
+     * @brief Hashing every block of the restored regions.
+     */
+    SNAPSHOT_PHASE_REHASH
+};
+
+/**
+ * @brief What the running pass is doing.
+ */
+static enum snapshot_phase_t snapshot_phase = SNAPSHOT_PHASE_IDLE;
+
+/**
+ * @brief The regions the running pass covers.
+ */
+static struct snapshot_region_t snapshot_regions[MAX_SNAPSHOT_REGIONS];
+
+/**
+ * @brief The number of items in snapshot_regions.
+ */
+static size_t snapshot_num_regions;
+
+/**
+ * @brief The layout of snapshot_regions.
+ */
+static unsigned int snapshot_layout;
+
+/**
+ * @brief The kind of the snapshot being written.
+ */
+static enum snapshot_kind_t snapshot_kind;
+
+/**
+ * @brief The sequence number of the snapshot being written or read.
+ */
+static unsigned int snapshot_current;
+
+/**
+ * @brief How many snapshots in the store were found whole.
+ */
+static unsigned int snapshot_whole;
+
+/**
+ * @brief The block the running pass is on, as its region and its index in it.
+ */
+static size_t snapshot_ind_region, snapshot_ind_block;
+
+/**
+ * @brief The offset in the store of the next word to read.
+ */
+static size_t snapshot_offset;
+
+/**
+ * @brief The offset in the store right after the last whole snapshot.
+ */
+static size_t snapshot_end;
+
+/**
+ * @brief Whether the header of the snapshot being read was read already.
+ */
+static int snapshot_in_snapshot;
+
+/**
+ * @brief The number of words written so far by the running pass.
+ */
+static int snapshot_written;
+
+
+static unsigned int _snapshot_mix(unsigned int hash, unsigned int word) {
+    // FNV-1a, a word at a time
+    return (hash ^ word) * 16777619u;
+}
+
+/**
+ * @brief Hashes the sizes of a set of regions, along with the numeric mode.
+ */
+static unsigned int _snapshot_layout(const struct snapshot_region_t *regions, size_t num_regions) {
+    unsigned int layout = _snapshot_mix(SNAPSHOT_HASH_BASIS, (unsigned int) num_regions);
+    size_t i;
+
+    for (i = 0; i < num_regions; i++) {
+        layout = _snapshot_mix(layout, (unsigned int) regions[i].size);
+    }
+
+    // amounts take as much room in either numeric mode, but are not interchangeable
+    return _snapshot_mix(layout, (unsigned int) ECON_ONE);
+}
+
+static size_t _snapshot_block_size(const struct snapshot_region_t *region, size_t ind_block) {
+    const size_t rest = region->size - ind_block * SNAPSHOT_BLOCK_SIZE;
+
+    return rest < SNAPSHOT_BLOCK_SIZE ? rest : SNAPSHOT_BLOCK_SIZE;
+}
+
+static size_t _snapshot_block_words(const struct snapshot_region_t *region, size_t ind_block) {
+    return (_snapshot_block_size(region, ind_block) + sizeof(unsigned int) - 1) / sizeof(unsigned int);
+}
+
+/**
+ * @brief Copies a block of a region into snapshot_block.
+ *
+ * @return size_t The number of words in the block.
+ */
+static size_t _snapshot_load_block(const struct snapshot_region_t *region, size_t ind_block) {
+    const size_t num_words = _snapshot_block_words(region, ind_block);
+
+    // the last word may only be partly covered by the region
+    snapshot_block[num_words] = 0;
+    memcpy(&snapshot_block[1], (const char *) region->data + ind_block * SNAPSHOT_BLOCK_SIZE, _snapshot_block_size(region, ind_block));
+
+    return num_words;
+}
+
+static unsigned int _snapshot_hash_block(size_t num_words) {
+    unsigned int hash = SNAPSHOT_HASH_BASIS;
+    size_t i;
+
+    for (i = 1; i <= num_words; i++) {
+        hash = _snapshot_mix(hash, snapshot_block[i]);
+    }
+
+    return hash;
+}
+
+static int _snapshot_block_is_zero(size_t num_words) {
+    size_t i;
+
+    for (i = 1; i <= num_words; i++) {
+        if (snapshot_block[i] != 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Appends words to the store, as part of the snapshot being written.
+ */
+static error_return_t _snapshot_put(const unsigned int *words, size_t num_words) {
+    size_t i;
+
+    for (i = 0; i < num_words; i++) {
+        snapshot_checksum = _snapshot_mix(snapshot_checksum, words[i]);
+    }
+
+    if (!acs_store_append(words, num_words)) {
+        erroric(ERR_SNAPSHOT_STORE_FULL, "snapshot_write");
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Reads words from the store, as part of the snapshot being read.
+ */
+static error_return_t _snapshot_get(unsigned int *words, size_t num_words) {
+    size_t i;
+
+    if (acs_store_read(snapshot_offset, words, num_words) < num_words) {
+        codei(ERR_SNAPSHOT_CORRUPT);
+    }
+
+    for (i = 0; i < num_words; i++) {
+        snapshot_checksum = _snapshot_mix(snapshot_checksum, words[i]);
+    }
+
+    snapshot_offset += num_words;
+
+    return 0;
+}
+
+/**
+ * @brief Moves the cursor of the running pass on to the next block.
+ *
+ * @return int 0 if there is none left, else 1.
+ */
+static int _snapshot_next_block(void) {
+    if (++snapshot_ind_block >= SNAPSHOT_BLOCKS(snapshot_regions[snapshot_ind_region].size)) {
+        snapshot_ind_block = 0;
+
+        do {
+            snapshot_ind_region++;
+        } while (snapshot_ind_region < snapshot_num_regions && snapshot_regions[snapshot_ind_region].size == 0);
+    }
+
+    return snapshot_ind_region < snapshot_num_regions;
+}
+
+/**
+ * @brief Points the cursor of the running pass at the first block.
+ *
+ * @return int 0 if there are no blocks at all, else 1.
+ */
+static int _snapshot_first_block(void) {
+    snapshot_ind_region = 0;
+    snapshot_ind_block = 0;
+
+    while (snapshot_ind_region < snapshot_num_regions && snapshot_regions[snapshot_ind_region].size == 0) {
+        snapshot_ind_region++;
+    }
+
+    return snapshot_ind_region < snapshot_num_regions;
+}
+
+/**
+ * @brief Copies the regions of a new pass, after checking them.
+ */
+static error_return_t _snapshot_begin(const struct snapshot_region_t *regions, size_t num_regions, const char *const ctx) {
+    size_t ind_region;
+
+    if (snapshot_phase != SNAPSHOT_PHASE_IDLE) {
+        erroric(ERR_SNAPSHOT_BUSY, ctx);
+    }
+
+    if (num_regions > MAX_SNAPSHOT_REGIONS) {
+        erroric(ERR_SNAPSHOT_BAD_REGIONS, ctx);
+    }
+
+    for (ind_region = 0; ind_region < num_regions; ind_region++) {
+        if (SNAPSHOT_BLOCKS(regions[ind_region].size) > 0xFFFF) {
+            erroric(ERR_SNAPSHOT_BAD_REGIONS, ctx);
+        }
+
+        snapshot_regions[ind_region] = regions[ind_region];
+    }
+
+    snapshot_num_regions = num_regions;
+    snapshot_layout = _snapshot_layout(regions, num_regions);
+
+    return 0;
+}
+
+error_return_t snapshot_write_begin(const struct snapshot_region_t *regions, size_t num_regions, enum snapshot_kind_t kind) {
+    unsigned int header[SNAPSHOT_HEADER_WORDS];
+
+    errcli(_snapshot_begin(regions, num_regions, "snapshot_write_begin"));
+
+    if (snapshot_last_sequence == 0 || snapshot_layout != snapshot_last_layout) {
+        kind = SNAPSHOT_FULL;
+    }
+
+    if (kind == SNAPSHOT_FULL) {
+        acs_store_clear();
+        snapshot_current = 1;
+    }
+
+    else {
+        snapshot_current = snapshot_last_sequence + 1;
+    }
+
+    // until this snapshot is whole, the hashes are ahead of the store
+    snapshot_last_sequence = 0;
+    snapshot_checksum = SNAPSHOT_HASH_BASIS;
+    snapshot_kind = kind;
+    snapshot_written = SNAPSHOT_HEADER_WORDS + 2;
+
+    header[0] = SNAPSHOT_MAGIC;
+    header[1] = SNAPSHOT_VERSION;
+    header[2] = snapshot_layout;
+    header[3] = kind;
+    header[4] = snapshot_current;
+
+    errcli(_snapshot_put(header, SNAPSHOT_HEADER_WORDS));
+
+    snapshot_phase = SNAPSHOT_PHASE_WRITE;
+    _snapshot_first_block();
+
+    return 0;
+}
+
+error_return_t snapshot_restore_begin(const struct snapshot_region_t *regions, size_t num_regions) {
+    errcli(_snapshot_begin(regions, num_regions, "snapshot_restore_begin"));
+
+    snapshot_current = 1;
+    snapshot_whole = 0;
+    snapshot_offset = 0;
+    snapshot_end = 0;
+    snapshot_in_snapshot = 0;
+    snapshot_phase = SNAPSHOT_PHASE_CHECK;
+
+    return 0;
+}
+
+/**
+ * @brief Writes the block under the cursor, unless it can be left out.
+ */
+static error_return_t _snapshot_write_block(void) {
+    const struct snapshot_region_t *const region = &snapshot_regions[snapshot_ind_region];
+    const size_t num_words = _snapshot_load_block(region, snapshot_ind_block);
+
+    unsigned int hash;
+
+    if (region->hashes != NULL) {
+        hash = _snapshot_hash_block(num_words);
+
+        if (snapshot_kind == SNAPSHOT_DELTA && hash == region->hashes[snapshot_ind_block]) {
+            return 0;
+        }
+
+        region->hashes[snapshot_ind_block] = hash;
+    }
+
+    // restoring a full snapshot zeroes everything first
+    if (snapshot_kind == SNAPSHOT_FULL && _snapshot_block_is_zero(num_words)) {
+        return 0;
+    }
+
+    snapshot_block[0] = (unsigned int) (snapshot_ind_region << 16 | snapshot_ind_block);
+
+    errcli(_snapshot_put(snapshot_block, num_words + 1));
+    snapshot_written += num_words + 1;
+
+    return 0;
+}
+
+/**
+ * @brief Writes the trailer of the snapshot being written, which makes it whole.
+ */
+static error_return_t _snapshot_write_end(void) {
+    unsigned int trailer[2];
+
+    trailer[0] = SNAPSHOT_END;
+    errcli(_snapshot_put(trailer, 1));
+
+    trailer[1] = snapshot_checksum;
+    errcli(_snapshot_put(&trailer[1], 1));
+
+    snapshot_last_sequence = snapshot_current;
+    snapshot_last_layout = snapshot_layout;
+
+    return snapshot_written;
+}
+
+/**
+ * @brief Reads the next part of the snapshot at snapshot_offset: its header, a block, or its trailer.
+ *
+ * @param restore Whether to copy blocks into the regions.
+ * @return error_return_t 1 if that was the trailer, else 0, or an error.
+ */
+static error_return_t _snapshot_read_part(int restore) {
+    const struct snapshot_region_t *region;
+    unsigned int header[SNAPSHOT_HEADER_WORDS];
+    unsigned int checksum;
+    size_t ind_region, ind_block, num_words;
+
+    if (!snapshot_in_snapshot) {
+        snapshot_checksum = SNAPSHOT_HASH_BASIS;
+
+        errcli(_snapshot_get(header, SNAPSHOT_HEADER_WORDS));
+
+        if (header[0] != SNAPSHOT_MAGIC || header[1] != SNAPSHOT_VERSION || header[2] != snapshot_layout) {
+            codei(ERR_SNAPSHOT_BAD_LAYOUT);
+        }
+
+        if (header[3] != (snapshot_current == 1 ? SNAPSHOT_FULL : SNAPSHOT_DELTA) || header[4] != snapshot_current) {
+            codei(ERR_SNAPSHOT_CORRUPT);
+        }
+
+        snapshot_in_snapshot = 1;
+
+        return 0;
+    }
+
+    errcli(_snapshot_get(snapshot_block, 1));
+
+    if (snapshot_block[0] == SNAPSHOT_END) {
+        checksum = snapshot_checksum;
+
+        errcli(_snapshot_get(header, 1));
+
+        if (header[0] != checksum) {
+            codei(ERR_SNAPSHOT_CORRUPT);
+        }
+
+        snapshot_in_snapshot = 0;
+        snapshot_current++;
+
+        return 1;
+    }
+
+    ind_region = snapshot_block[0] >> 16;
+    ind_block = snapshot_block[0] & 0xFFFF;
+
+    if (ind_region >= snapshot_num_regions || ind_block >= SNAPSHOT_BLOCKS(snapshot_regions[ind_region].size)) {
+        codei(ERR_SNAPSHOT_CORRUPT);
+    }
+
+    region = &snapshot_regions[ind_region];
+    num_words = _snapshot_block_words(region, ind_block);
+
+    errcli(_snapshot_get(&snapshot_block[1], num_words));
+
+    if (restore) {
+        memcpy((char *) region->data + ind_block * SNAPSHOT_BLOCK_SIZE, &snapshot_block[1], _snapshot_block_size(region, ind_block));
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Checks the next part of the store, before anything is restored.
+ */
+static error_return_t _snapshot_check_part(void) {
+    error_return_t res;
+
+    if (snapshot_offset < acs_store_length()) {
+        res = _snapshot_read_part(0);
+
+        if (res == 0) {
+            return 0;
+        }
+
+        if (res > 0) {
+            snapshot_whole++;
+            snapshot_end = snapshot_offset;
+
+            return 0;
+        }
+
+        if (snapshot_whole == 0) {
+            erroric(-res, "snapshot_restore");
+        }
+    }
+
+    // the end of the store, or a partly written snapshot, which is left out along with anything after it
+    if (snapshot_whole == 0) {
+        erroric(ERR_SNAPSHOT_NONE, "snapshot_restore");
+    }
+
+    // the whole snapshots are read again from the start, once the regions are zeroed
+    snapshot_offset = 0;
+    snapshot_current = 1;
+    snapshot_in_snapshot = 0;
+    snapshot_phase = _snapshot_first_block() ? SNAPSHOT_PHASE_ZERO : SNAPSHOT_PHASE_APPLY;
+
+    return 0;
+}
+
+/**
+ * @brief Zeroes the block under the cursor, as restoring a full snapshot starts out from.
+ */
+static void _snapshot_zero_block(void) {
+    const struct snapshot_region_t *const region = &snapshot_regions[snapshot_ind_region];
+
+    memset((char *) region->data + snapshot_ind_block * SNAPSHOT_BLOCK_SIZE, 0, _snapshot_block_size(region, snapshot_ind_block));
+}
+
+static void _snapshot_rehash_block(void) {
+    const struct snapshot_region_t *const region = &snapshot_regions[snapshot_ind_region];
+
+    if (region->hashes != NULL) {
+        region->hashes[snapshot_ind_block] = _snapshot_hash_block(_snapshot_load_block(region, snapshot_ind_block));
+    }
+}
+
+/**
+ * @brief Ends a restore, once every block is hashed.
+ *
+ * @return error_return_t The number of snapshots restored.
+ */
+static error_return_t _snapshot_restore_end(void) {
+    // deltas may only be appended after the last whole snapshot
+    snapshot_last_sequence = snapshot_end == acs_store_length() ? snapshot_whole : 0;
+    snapshot_last_layout = snapshot_layout;
+
+    return (error_return_t) snapshot_whole;
+}
+
+/**
+ * @brief Works on a single block, or a single part of a stored snapshot.
+ *
+ * @return error_return_t 0 while the pass goes on, else what it comes to.
+ */
+static error_return_t _snapshot_step_one(void) {
+    error_return_t res;
+
+    switch (snapshot_phase) {
+        case SNAPSHOT_PHASE_WRITE:
+            if (snapshot_ind_region >= snapshot_num_regions) {
+                return _snapshot_write_end();
+            }
+
+            errcli(_snapshot_write_block());
+            _snapshot_next_block();
+
+            return 0;
+
+        case SNAPSHOT_PHASE_CHECK:
+            return _snapshot_check_part();
+
+        case SNAPSHOT_PHASE_ZERO:
+            _snapshot_zero_block();
+
+            if (!_snapshot_next_block()) {
+                snapshot_phase = SNAPSHOT_PHASE_APPLY;
+            }
+
+            return 0;
+
+        case SNAPSHOT_PHASE_APPLY:
+            // every snapshot read here was checked, so this cannot fail
+            res = _snapshot_read_part(1);
+            errcli(res);
+
+            if (res > 0 && snapshot_current > snapshot_whole) {
+                snapshot_phase = SNAPSHOT_PHASE_REHASH;
+
+                if (!_snapshot_first_block()) {
+                    return _snapshot_restore_end();
+                }
+            }
+
+            return 0;
+
+        case SNAPSHOT_PHASE_REHASH:
+            _snapshot_rehash_block();
+
+            if (!_snapshot_next_block()) {
+                return _snapshot_restore_end();
+            }
+
+            return 0;
+
+        default:
+            codei(ERR_SNAPSHOT_IDLE);
+    }
+}
+
+error_return_t snapshot_step(size_t max_blocks) {
+    error_return_t res = 0;
+    size_t i;
+
+    if (snapshot_phase == SNAPSHOT_PHASE_IDLE) {
+        codei(ERR_SNAPSHOT_IDLE);
+    }
+
+    for (i = 0; i < max_blocks && res == 0; i++) {
+        res = _snapshot_step_one();
+    }
+
+    if (res != 0) {
+        snapshot_phase = SNAPSHOT_PHASE_IDLE;
+    }
+
+    return res;
+}
+
+int snapshot_running(void) {
+    return snapshot_phase != SNAPSHOT_PHASE_IDLE;
+}
+
+error_return_t snapshot_write(const struct snapshot_region_t *regions, size_t num_regions, enum snapshot_kind_t kind) {
+    error_return_t res;
+
+    errcli(snapshot_write_begin(regions, num_regions, kind));
+
+    do {
+        res = snapshot_step(SNAPSHOT_STEP_ALL);
+    } while (res == 0);
+
+    return res;
+}
+
+error_return_t snapshot_restore(const struct snapshot_region_t *regions, size_t num_regions) {
+    error_return_t res;
+
+    errcli(snapshot_restore_begin(regions, num_regions));
+
+    do {
+        res = snapshot_step(SNAPSHOT_STEP_ALL);
+    } while (res == 0);
+
+    return res;
+}
+
+unsigned int snapshot_sequence(void) {
+    return snapshot_last_sequence;
+}
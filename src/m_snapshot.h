@@ -0,0 +1,230 @@
+/**
+ * @file m_snapshot.h
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief Versioned binary snapshots of static tables.
+ * @version added in 0.1
+ * @date 2021-03-17
+ *
+ * A snapshot is a copy of a set of regions of memory, usually the
+ * static tables of the world (see economy_save), written as a stream
+ * of 32-bit words into the persistent store of the ACS layer (see
+ * m_acs.h): an ACS global array on the ZDoom side, which outlives the
+ * level and is kept in savegames, and a plain file on the native host.
+ *
+ * Every region is split into blocks of SNAPSHOT_BLOCK_WORDS words,
+ * and only some blocks are written:
+ *
+ *  - a full snapshot empties the store, and writes every block that
+ *    is not all zeroes; restoring it zeroes every region first, so
+ *    that tables only take as much room as is actually in use;
+ *  - a delta snapshot is appended to the store, and only writes the
+ *    blocks that changed since the last snapshot was written or
+ *    restored, which the regions keep a hash of.
+ *
+ * Restoring reads back the full snapshot at the start of the store,
+ * then every delta after it, in order. A snapshot that was only
+ * partly written, e.g. because the store ran out of room, is left out,
+ * along with anything after it.
+ *
+ * The stream is laid out as follows:
+ *
+ *  - a header: SNAPSHOT_MAGIC, SNAPSHOT_VERSION, the layout of the
+ *    regions (a hash of their sizes, and of the numeric mode of the
+ *    economy), the snapshot kind, and its sequence number, which is
+ *    1 for a full snapshot and counts up from there for its deltas;
+ *  - each block written, as its region index in the upper 16 bits of
+ *    a word and its block index in the lower 16, then its words;
+ *  - SNAPSHOT_END, then a checksum of every word before it.
+ *
+ * A snapshot can only be restored into regions of the very same
+ * layout, which is only ever the case for the same build of the code.
+ *
+ * Hashing and copying every block of the world takes far more than a
+ * tic's worth of ACS VM instructions, so snapshots are written and
+ * restored in passes, a few blocks at a time: a pass is begun with
+ * snapshot_write_begin or snapshot_restore_begin, then carried on by
+ * calling snapshot_step once per tic, until it is done. Only one pass
+ * runs at a time. Each block is copied as it is when the pass gets to
+ * it, so the regions should be left alone while a pass is running;
+ * while a full snapshot is being written, the store holds no whole
+ * snapshot at all. Offline callers, which have no per-tic budget to
+ * keep to, may just call snapshot_write or snapshot_restore instead.
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+
+#include "m_error.h"
+
+
+/**
+ * @brief The first word of every snapshot ("IFSN").
+ */
+#define SNAPSHOT_MAGIC 0x4E534649u
+
+/**
+ * @brief The version of the snapshot format.
+ *
+ * Must be bumped whenever the stream layout changes.
+ */
+#define SNAPSHOT_VERSION 1
+
+/**
+ * @brief The word marking the end of a snapshot's blocks.
+ */
+#define SNAPSHOT_END 0xFFFFFFFFu
+
+/**
+ * @brief The number of words in a snapshot block.
+ */
+#define SNAPSHOT_BLOCK_WORDS 64
+
+/**
+ * @brief The size of a snapshot block, in the units of sizeof.
+ */
+#define SNAPSHOT_BLOCK_SIZE (SNAPSHOT_BLOCK_WORDS * sizeof(unsigned int))
+
+/**
+ * @brief The number of blocks a region of a given size is split into.
+ */
+#define SNAPSHOT_BLOCKS(size) (((size) + SNAPSHOT_BLOCK_SIZE - 1) / SNAPSHOT_BLOCK_SIZE)
+
+/**
+ * @brief The max number of regions a snapshot may cover.
+ */
+#define MAX_SNAPSHOT_REGIONS 48
+
+/**
+ * @brief A number of blocks to step a snapshot pass by, which finishes it at once.
+ */
+#define SNAPSHOT_STEP_ALL ((size_t) -1)
+
+/**
+ * @brief The kind of a snapshot.
+ */
+enum snapshot_kind_t {
+    /**
+     * @brief Holds every region whole.
+     */
+    SNAPSHOT_FULL,
+
+    /**
+     * @brief Only holds the blocks changed since the previous snapshot.
+     */
+    SNAPSHOT_DELTA
+};
+
+/**
+ * @brief A region of memory covered by snapshots.
+ */
+struct snapshot_region_t {
+    /**
+     * @brief The start of the region.
+     */
+    void *data;
+
+    /**
+     * @brief The size of the region, in the units of sizeof.
+     */
+    size_t size;
+
+    /**
+     * @brief The hash of each block of the region, as of the last snapshot.
+     *
+     * Must have room for SNAPSHOT_BLOCKS(size) items. May be NULL for
+     * small regions, such as counters, which are then written whole
+     * into every delta snapshot.
+     */
+    unsigned int *hashes;
+};
+
+/**
+ * @brief Describes a table, or any other object, as a snapshot region.
+ */
+#define SNAPSHOT_REGION(object, hashes) { (void *) &(object), sizeof(object), (hashes) }
+
+
+/**
+ * @brief Begins writing a snapshot of a set of regions into the persistent store.
+ *
+ * A delta snapshot is only written if the previous snapshot was of
+ * the same regions, and was written or restored whole; a full one is
+ * written in its place otherwise. Only the header is written here;
+ * the blocks are written by snapshot_step.
+ *
+ * @param regions The regions to snapshot; copied, so they need not outlive the call.
+ * @param num_regions The number of regions, up to MAX_SNAPSHOT_REGIONS.
+ * @param kind Whether to write a full or a delta snapshot.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t snapshot_write_begin(const struct snapshot_region_t *regions, size_t num_regions, enum snapshot_kind_t kind);
+
+/**
+ * @brief Begins restoring a set of regions from the snapshots in the persistent store.
+ *
+ * The store is checked before anything is restored; if it holds no
+ * whole snapshot of the same layout, the pass fails before any region
+ * is touched.
+ *
+ * @param regions The regions to restore, the same as they were snapshot.
+ * @param num_regions The number of regions.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t snapshot_restore_begin(const struct snapshot_region_t *regions, size_t num_regions);
+
+/**
+ * @brief Carries on with the running snapshot pass, for up to a number of blocks.
+ *
+ * Each block checked, zeroed, written, restored or hashed counts as
+ * one, and so does each header or trailer read.
+ *
+ * @param max_blocks How many blocks to work on at most, or SNAPSHOT_STEP_ALL.
+ * @return error_return_t 0 while the pass goes on; once it is done, the number of words written or of snapshots restored, which is never 0; or an error, which also ends the pass.
+ */
+error_return_t snapshot_step(size_t max_blocks);
+
+/**
+ * @brief Checks whether a snapshot pass is running.
+ *
+ * @return int 1 if a snapshot is being written or restored, else 0.
+ */
+int snapshot_running(void);
+
+/**
+ * @brief Writes a snapshot of a set of regions into the persistent store, in one go.
+ *
+ * @see snapshot_write_begin
+ *
+ * @param regions The regions to snapshot.
+ * @param num_regions The number of regions, up to MAX_SNAPSHOT_REGIONS.
+ * @param kind Whether to write a full or a delta snapshot.
+ * @return error_return_t The number of words written, or an error.
+ */
+error_return_t snapshot_write(const struct snapshot_region_t *regions, size_t num_regions, enum snapshot_kind_t kind);
+
+/**
+ * @brief Restores a set of regions from the snapshots in the persistent store, in one go.
+ *
+ * @see snapshot_restore_begin
+ *
+ * @param regions The regions to restore, the same as they were snapshot.
+ * @param num_regions The number of regions.
+ * @return error_return_t The number of snapshots restored, or an error.
+ */
+error_return_t snapshot_restore(const struct snapshot_region_t *regions, size_t num_regions);
+
+/**
+ * @brief Gets the sequence number of the last snapshot written or restored.
+ *
+ * While a snapshot is being written, there is none.
+ *
+ * @return unsigned int The sequence number, or 0 if there is none.
+ */
+unsigned int snapshot_sequence(void);
+
+
+#endif // SNAPSHOT_H
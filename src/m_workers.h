@@ -0,0 +1,68 @@
+/**
+ * @file m_workers.h
+ * @author Gustavo Rehermann (rehermann6046@gmail.com)
+ * @brief A pool of worker threads.
+ * @version added in 0.1
+ * @date 2021-03-17
+ *
+ * The ACS VM runs a single script at a time, so only the native host
+ * build has worker threads, in host/host_workers.c; code that uses
+ * them is only compiled into builds that ask for it, such as those
+ * that define INDUSTRY_THREADS (see h_industry.h).
+ *
+ * A job is split into parts, which idle workers take up one at a time,
+ * the calling thread included. Parts must never write to the same
+ * memory as one another, so that no locking is ever needed; whatever
+ * the number of workers, each part then does the very same work, and
+ * the results never depend on how many threads there are.
+ *
+ * @copyright Copyright (c)Gustavo Ramos Rehermann 2021. The MIT License.
+ */
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include "m_error.h"
+
+
+/**
+ * @brief The max number of threads in the pool, including the calling thread.
+ */
+#define MAX_WORKERS 64
+
+/**
+ * @brief A job run by workers.
+ *
+ * @param part The part of the job to do.
+ * @param num_parts The number of parts the job is split into.
+ */
+typedef void (*worker_job_t)(int part, int num_parts);
+
+/**
+ * @brief Starts the worker threads.
+ *
+ * May only be called once. Until then, jobs run on the calling thread
+ * alone.
+ *
+ * @param count The number of threads to run jobs on, including the calling thread.
+ * @return error_return_t 0 if successful, an error code otherwise.
+ */
+error_return_t workers_start(int count);
+
+/**
+ * @brief Gets the number of threads jobs run on, including the calling thread.
+ *
+ * @return int The number of threads; 1 until workers_start is called.
+ */
+int workers_count(void);
+
+/**
+ * @brief Runs every part of a job, returning once all of them are done.
+ *
+ * @param job The job to run.
+ * @param num_parts The number of parts to split the job into.
+ */
+void workers_run(worker_job_t job, int num_parts);
+
+
+#endif // WORKERS_H
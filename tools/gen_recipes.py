@@ -0,0 +1,412 @@
+#!/usr/bin/env python3
+"""Generates the industry type table from data/industries.recipe.
+
+Reads the industry recipes, checks them against the cargo types defined
+in h_cargo.c and the limits in h_industry.h, and writes a C source file
+that h_industry.c includes. The output defines:
+
+ * industry_types, the table of all industry types;
+ * for every industry type, a production function and a supply
+   function, with its accepted and supplied cargo types, weights and
+   rates written out as constants;
+ * industry_recipes, which points each industry type at those.
+
+Any mistake in the recipes (an unknown cargo label, too many cargo
+types, a missing property) fails the build, naming the offending line.
+
+usage: gen_recipes.py --cargo src/h_cargo.c --limits src/h_industry.h -o OUT RECIPES
+"""
+
+import argparse
+import re
+import shlex
+import sys
+
+
+SUPPLY_TYPES = {
+    'boost': 'ISUPTYPE_BOOST',
+    'assemble': 'ISUPTYPE_ASSEMBLE',
+    'convert': 'ISUPTYPE_CONVERT',
+}
+
+# property name -> (default, converter); None means required
+SCALAR_PROPS = {
+    'supply_type': (None, str),
+    'spawner': (None, str),
+    'base_production': ('0', float),
+    'boost_rate': ('1', float),
+    'boost_threshold': ('0', float),
+    'reach': (None, float),
+}
+
+MAX_LABEL = 64
+
+
+class RecipeError(Exception):
+    pass
+
+
+def strip_c_comments(source):
+    source = re.sub(r'/\*.*?\*/', ' ', source, flags=re.S)
+    return re.sub(r'//[^\n]*', ' ', source)
+
+
+def read_cargo_labels(path):
+    """Reads the label of every cargo type, in order, from h_cargo.c."""
+
+    source = strip_c_comments(open(path).read())
+    match = re.search(r'cargo_types\s*\[\s*\]\s*=\s*\{(.*)\};', source, re.S)
+
+    if not match:
+        raise RecipeError('{}: cargo_types not found'.format(path))
+
+    labels = []
+    depth = 0
+    entry = ''
+
+    for char in match.group(1):
+        if char == '{':
+            depth += 1
+
+            if depth == 1:
+                entry = ''
+                continue
+
+        elif char == '}':
+            depth -= 1
+
+            if depth == 0:
+                label = re.search(r'"((?:[^"\\]|\\.)*)"', entry)
+
+                if not label:
+                    raise RecipeError('{}: cargo type #{} has no label'.format(path, len(labels)))
+
+                labels.append(label.group(1))
+                continue
+
+        entry += char
+
+    return labels
+
+
+def read_limit(path, name):
+    match = re.search(r'#define\s+{}\s+(\d+)'.format(name), open(path).read())
+
+    if not match:
+        raise RecipeError('{}: {} not found'.format(path, name))
+
+    return int(match.group(1))
+
+
+def parse_recipes(path, cargo_labels, max_mats):
+    """Parses a recipe file into a list of industry type dicts."""
+
+    industries = []
+    current = None
+
+    def finish(indus):
+        for prop, (default, conv) in SCALAR_PROPS.items():
+            if prop not in indus:
+                if default is None:
+                    raise RecipeError('{}:{}: industry "{}" has no {}'.format(path, indus['line'], indus['label'], prop))
+
+                indus[prop] = conv(default)
+
+        if indus['supply_type'] not in SUPPLY_TYPES:
+            raise RecipeError('{}:{}: industry "{}" has unknown supply_type "{}"'.format(
+                path, indus['line'], indus['label'], indus['supply_type']))
+
+        if not indus['accepts'] and indus['supply_type'] != 'boost':
+            raise RecipeError('{}:{}: industry "{}" accepts nothing, so it can never produce'.format(
+                path, indus['line'], indus['label']))
+
+        if indus['supply_type'] != 'assemble' and indus['boost_rate'] <= 0.0:
+            raise RecipeError('{}:{}: industry "{}" would never produce when boosted; boost_rate must be positive'.format(
+                path, indus['line'], indus['label']))
+
+        if indus['reach'] <= 0.0:
+            raise RecipeError('{}:{}: industry "{}" has no reach'.format(path, indus['line'], indus['label']))
+
+        industries.append(indus)
+
+    for lineno, line in enumerate(open(path), 1):
+        try:
+            words = shlex.split(line, comments=True)
+
+        except ValueError as err:
+            raise RecipeError('{}:{}: {}'.format(path, lineno, err))
+
+        if not words:
+            continue
+
+        where = '{}:{}'.format(path, lineno)
+        key, args = words[0], words[1:]
+
+        if key == 'industry':
+            if len(args) != 1:
+                raise RecipeError('{}: expected: industry "Label"'.format(where))
+
+            if len(args[0]) >= MAX_LABEL:
+                raise RecipeError('{}: label too long'.format(where))
+
+            if any(indus['label'] == args[0] for indus in industries):
+                raise RecipeError('{}: industry "{}" declared twice'.format(where, args[0]))
+
+            if current:
+                finish(current)
+
+            current = {'label': args[0], 'line': lineno, 'accepts': [], 'supplies': []}
+            continue
+
+        if current is None:
+            raise RecipeError('{}: "{}" outside of an industry'.format(where, key))
+
+        if key in ('accept', 'supply'):
+            if len(args) != 2:
+                raise RecipeError('{}: expected: {} "Cargo Label" weight'.format(where, key))
+
+            if args[0] not in cargo_labels:
+                raise RecipeError('{}: unknown cargo "{}"; cargo types are: {}'.format(
+                    where, args[0], ', '.join(cargo_labels)))
+
+            mats = current['accepts' if key == 'accept' else 'supplies']
+
+            if any(cargo == cargo_labels.index(args[0]) for cargo, _ in mats):
+                raise RecipeError('{}: cargo "{}" listed twice'.format(where, args[0]))
+
+            if len(mats) >= max_mats:
+                raise RecipeError('{}: more than MAX_INDUS_MATS ({}) cargo types'.format(where, max_mats))
+
+            try:
+                weight = float(args[1])
+
+            except ValueError:
+                raise RecipeError('{}: bad weight "{}"'.format(where, args[1]))
+
+            if weight <= 0.0:
+                raise RecipeError('{}: weight must be positive'.format(where))
+
+            mats.append((cargo_labels.index(args[0]), weight))
+            continue
+
+        if key not in SCALAR_PROPS:
+            raise RecipeError('{}: unknown property "{}"'.format(where, key))
+
+        if key in current:
+            raise RecipeError('{}: {} given twice'.format(where, key))
+
+        if len(args) != 1:
+            raise RecipeError('{}: expected: {} value'.format(where, key))
+
+        try:
+            current[key] = SCALAR_PROPS[key][1](args[0])
+
+        except ValueError:
+            raise RecipeError('{}: bad value "{}"'.format(where, args[0]))
+
+    if current:
+        finish(current)
+
+    return industries
+
+
+def c_float(value):
+    return repr(float(value)) + 'f'
+
+
+def c_econ(value):
+    """An economy amount constant, in whichever numeric mode (see m_fixed.h)."""
+
+    return 'ECON_C({})'.format(repr(float(value)))
+
+
+def c_string(value):
+    return '"' + value.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+
+def c_ident(label):
+    return re.sub(r'[^a-z0-9]+', '_', label.lower()).strip('_')
+
+
+def accept_slots(accepts):
+    """The accept slot of each cargo type plus one, up to the last accepted."""
+
+    slots = [0] * (max((cargo for cargo, _ in accepts), default=-1) + 1)
+
+    for slot, (cargo, _) in enumerate(accepts):
+        slots[cargo] = slot + 1
+
+    return ', '.join(str(slot) for slot in slots) or '0'
+
+
+def emit_type(out, indus, cargo_labels):
+    def mats(items):
+        cargos = ', '.join('{} /* {} */'.format(cargo, cargo_labels[cargo]) for cargo, _ in items) or '0'
+        weights = ', '.join(c_econ(weight) for _, weight in items) or '0'
+
+        return '{}, {{ {} }},\n        {{ {} }}'.format(len(items), cargos, weights)
+
+    out.append('    {{ // {}'.format(indus['label']))
+    out.append('        {}, // supply_type'.format(SUPPLY_TYPES[indus['supply_type']]))
+    out.append('        {}, // label'.format(c_string(indus['label'])))
+    out.append('        {}, // spawner_type'.format(c_string(indus['spawner'])))
+    out.append('')
+    out.append('        {}, // base_production'.format(c_econ(indus['base_production'])))
+    out.append('        {}, // boost_rate'.format(c_econ(indus['boost_rate'])))
+    out.append('        {}, // boost_threshold'.format(c_econ(indus['boost_threshold'])))
+    out.append('        {}, // reach'.format(c_float(indus['reach'])))
+    out.append('')
+    out.append('        // accept')
+    out.append('        {},'.format(mats(indus['accepts'])))
+    out.append('')
+    out.append('        // supply')
+    out.append('        {},'.format(mats(indus['supplies'])))
+    out.append('')
+    out.append('        // accept slots, by cargo type')
+    out.append('        {{ {} }}'.format(accept_slots(indus['accepts'])))
+    out.append('    },')
+    out.append('')
+
+
+def emit_produce(out, indus, ident):
+    accepts = range(len(indus['accepts']))
+    material = 'INDUS_MATERIAL(ind_industry, {})'.format
+
+    out.append('static econ_t _industry_produce_{}(industry_handle_t ind_industry) {{'.format(ident))
+
+    if indus['supply_type'] == 'boost':
+        out.append('    const econ_t production = {};'.format(c_econ(indus['base_production'])))
+        out.append('')
+        out.append('    if (INDUS_MATERIAL_TOT(ind_industry) >= {}) {{'.format(c_econ(indus['boost_threshold'])))
+        out.append('        return econ_mul(production, {});'.format(c_econ(indus['boost_rate'])))
+        out.append('    }')
+        out.append('')
+        out.append('    return production;')
+
+    elif indus['supply_type'] == 'convert':
+        out.append('    const int boosted = {};'.format(' && '.join('{} != 0'.format(material(i)) for i in accepts)))
+        out.append('    econ_t production = 0;')
+        out.append('')
+
+        for i in accepts:
+            out.append('    production += {};'.format(material(i)))
+
+        for i in accepts:
+            out.append('    {} = 0;'.format(material(i)))
+
+        out.append('')
+        out.append('    if (boosted) {')
+        out.append('        return econ_mul(production, {});'.format(c_econ(indus['boost_rate'])))
+        out.append('    }')
+        out.append('')
+        out.append('    return production;')
+
+    else:
+        out.append('    econ_t spent = {};'.format(material(0)))
+        out.append('')
+        out.append('    if ({}) {{'.format(' || '.join('{} == 0'.format(material(i)) for i in accepts)))
+        out.append('        return -ECON_ONE;')
+        out.append('    }')
+        out.append('')
+
+        for i in accepts[1:]:
+            out.append('    if (spent > {}) {{'.format(material(i)))
+            out.append('        spent = {};'.format(material(i)))
+            out.append('    }')
+            out.append('')
+
+        for i in accepts:
+            out.append('    {} -= spent;'.format(material(i)))
+
+        out.append('')
+        out.append('    return spent * {};'.format(len(indus['accepts'])))
+
+    out.append('}')
+    out.append('')
+
+
+def emit_supply(out, indus, ident, cargo_labels):
+    out.append('static void _industry_supply_{}(industry_handle_t ind_industry, econ_t amount) {{'.format(ident))
+
+    if not indus['supplies']:
+        out.append('    (void) ind_industry;')
+        out.append('    (void) amount;')
+
+    for i, (cargo, weight) in enumerate(indus['supplies']):
+        out.append('    _industry_supply(ind_industry, {}, {} /* {} */, econ_mul(amount, {}));'.format(
+            i, cargo, cargo_labels[cargo], c_econ(weight)))
+
+    out.append('}')
+    out.append('')
+
+
+def generate(industries, cargo_labels, source):
+    out = [
+        '/*',
+        ' * Generated by tools/gen_recipes.py from {}. Do not edit.'.format(source),
+        ' *',
+        ' * Included by h_industry.c, which provides INDUS_*, _industry_supply',
+        ' * and struct industry_recipe_t.',
+        ' */',
+        '',
+        'const struct industry_type_t industry_types[MAX_INDUS_TYPES] = {',
+    ]
+
+    for indus in industries:
+        emit_type(out, indus, cargo_labels)
+
+    out[-1] = '};'
+    out.append('')
+
+    idents = []
+
+    for indus in industries:
+        ident = c_ident(indus['label'])
+        idents.append(ident)
+
+        out.append('// -- {}'.format(indus['label']))
+        out.append('')
+        emit_produce(out, indus, ident)
+        emit_supply(out, indus, ident, cargo_labels)
+
+    out.append('static const struct industry_recipe_t industry_recipes[MAX_INDUS_TYPES] = {')
+
+    for ident in idents:
+        out.append('    {{ _industry_produce_{0}, _industry_supply_{0} }},'.format(ident))
+
+    out.append('};')
+    out.append('')
+
+    return '\n'.join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generates the industry type table from recipes.')
+    parser.add_argument('recipes')
+    parser.add_argument('--cargo', required=True, help='h_cargo.c, to read cargo labels from')
+    parser.add_argument('--limits', required=True, help='h_industry.h, to read MAX_INDUS_* from')
+    parser.add_argument('-o', '--output', required=True)
+    args = parser.parse_args()
+
+    try:
+        cargo_labels = read_cargo_labels(args.cargo)
+        max_mats = read_limit(args.limits, 'MAX_INDUS_MATS')
+        max_types = read_limit(args.limits, 'MAX_INDUS_TYPES')
+
+        industries = parse_recipes(args.recipes, cargo_labels, max_mats)
+
+        if len(industries) > max_types:
+            raise RecipeError('{}: more than MAX_INDUS_TYPES ({}) industry types'.format(args.recipes, max_types))
+
+        if len(set(c_ident(indus['label']) for indus in industries)) != len(industries):
+            raise RecipeError('{}: industry labels must differ in more than punctuation'.format(args.recipes))
+
+    except RecipeError as err:
+        sys.exit('gen_recipes: ' + str(err))
+
+    with open(args.output, 'w') as out:
+        out.write(generate(industries, cargo_labels, args.recipes))
+
+
+if __name__ == '__main__':
+    main()